@@ -0,0 +1,223 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "arena_report.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+#include "tensorflow/lite/micro/recording_micro_allocator.h"
+#include "tensorflow/lite/micro/recording_micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_utils.h"
+
+namespace {
+
+// Far more than any model of this size needs, so allocation can't fail.
+constexpr size_t kReportArenaSize = 64 * 1024;
+
+// Size in bytes of a tensor of `type`, or 0 for types this report doesn't
+// expect.
+int TensorTypeSize(tflite::TensorType type) {
+  switch (type) {
+    case tflite::TensorType_INT8:
+    case tflite::TensorType_UINT8:
+      return 1;
+    case tflite::TensorType_INT16:
+      return 2;
+    case tflite::TensorType_INT32:
+    case tflite::TensorType_FLOAT32:
+      return 4;
+    case tflite::TensorType_INT64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+bool IsConstant(const tflite::Model* model, const tflite::Tensor* tensor) {
+  const tflite::Buffer* buffer = model->buffers()->Get(tensor->buffer());
+  return buffer != nullptr && buffer->data() != nullptr &&
+         buffer->data()->size() > 0;
+}
+
+int TensorBytes(const tflite::Tensor* tensor) {
+  int bytes = TensorTypeSize(tensor->type());
+  if (tensor->shape() != nullptr) {
+    for (uint32_t i = 0; i < tensor->shape()->size(); ++i) {
+      bytes *= tensor->shape()->Get(i);
+    }
+  }
+  return bytes;
+}
+
+bool Contains(const flatbuffers::Vector<int32_t>* indices, int32_t index) {
+  for (uint32_t i = 0; i < indices->size(); ++i) {
+    if (indices->Get(i) == index) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Bytes of the non-constant tensors that have to be in the arena while op
+// `op_index` runs: everything already produced, or fed in from outside, that
+// this op or a later one still reads, plus the model outputs.
+int LiveTensorBytes(const tflite::Model* model,
+                    const tflite::SubGraph* subgraph, int op_index) {
+  const auto* operators = subgraph->operators();
+  int bytes = 0;
+  for (uint32_t t = 0; t < subgraph->tensors()->size(); ++t) {
+    const tflite::Tensor* tensor = subgraph->tensors()->Get(t);
+    if (IsConstant(model, tensor)) {
+      continue;
+    }
+    const int32_t index = static_cast<int32_t>(t);
+    int first_op = Contains(subgraph->inputs(), index) ? 0 : -1;
+    int last_op = Contains(subgraph->outputs(), index)
+                      ? static_cast<int>(operators->size()) - 1
+                      : -1;
+    for (uint32_t o = 0; o < operators->size(); ++o) {
+      const tflite::Operator* op = operators->Get(o);
+      if (first_op < 0 && Contains(op->outputs(), index)) {
+        first_op = o;
+      }
+      if (Contains(op->inputs(), index) || Contains(op->outputs(), index)) {
+        if (static_cast<int>(o) > last_op) {
+          last_op = o;
+        }
+      }
+    }
+    if (first_op >= 0 && first_op <= op_index && op_index <= last_op) {
+      bytes += TensorBytes(tensor);
+    }
+  }
+  return bytes;
+}
+
+void ReportRecordedAllocation(tflite::ErrorReporter* error_reporter,
+                              const tflite::RecordingMicroAllocator& allocator,
+                              tflite::RecordedAllocationType type,
+                              const char* name, size_t* total_bytes) {
+  const tflite::RecordedAllocation allocation =
+      allocator.GetRecordedAllocation(type);
+  TF_LITE_REPORT_ERROR(error_reporter, "  %s: %d bytes in %d allocations",
+                       name, static_cast<int>(allocation.used_bytes),
+                       static_cast<int>(allocation.count));
+  *total_bytes += allocation.used_bytes;
+}
+
+}  // namespace
+
+TfLiteStatus ReportArenaUsage(tflite::ErrorReporter* error_reporter,
+                              const tflite::Model* model,
+                              const tflite::MicroOpResolver& op_resolver,
+                              size_t expected_bytes) {
+  // Only this diagnostic build pays for the big arena, and only while it
+  // runs.
+  uint8_t* arena = static_cast<uint8_t*>(malloc(kReportArenaSize));
+  if (arena == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Couldn't allocate %d bytes to measure the arena",
+                         static_cast<int>(kReportArenaSize));
+    return kTfLiteError;
+  }
+  TfLiteStatus status = kTfLiteOk;
+  {
+    tflite::RecordingMicroInterpreter interpreter(
+        model, op_resolver, arena, kReportArenaSize, error_reporter);
+    status = interpreter.AllocateTensors();
+    if (status != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+    } else {
+      const size_t used_bytes = interpreter.arena_used_bytes();
+      const tflite::RecordingMicroAllocator& allocator =
+          interpreter.GetMicroAllocator();
+
+      TF_LITE_REPORT_ERROR(error_reporter, "Persistent arena allocations:");
+      size_t persistent_bytes = 0;
+      ReportRecordedAllocation(
+          error_reporter, allocator,
+          tflite::RecordedAllocationType::kTfLiteEvalTensorData,
+          "Eval tensors", &persistent_bytes);
+      ReportRecordedAllocation(
+          error_reporter, allocator,
+          tflite::RecordedAllocationType::kPersistentTfLiteTensorData,
+          "TfLiteTensors", &persistent_bytes);
+      ReportRecordedAllocation(
+          error_reporter, allocator,
+          tflite::RecordedAllocationType::
+              kPersistentTfLiteTensorQuantizationData,
+          "Tensor quantization", &persistent_bytes);
+      ReportRecordedAllocation(
+          error_reporter, allocator,
+          tflite::RecordedAllocationType::kPersistentBufferData,
+          "Persistent buffers", &persistent_bytes);
+      ReportRecordedAllocation(
+          error_reporter, allocator,
+          tflite::RecordedAllocationType::kTfLiteTensorVariableBufferData,
+          "Variable tensors", &persistent_bytes);
+      ReportRecordedAllocation(
+          error_reporter, allocator,
+          tflite::RecordedAllocationType::kNodeAndRegistrationArray,
+          "Nodes and registrations", &persistent_bytes);
+      ReportRecordedAllocation(error_reporter, allocator,
+                               tflite::RecordedAllocationType::kOpData,
+                               "Op data", &persistent_bytes);
+
+      TF_LITE_REPORT_ERROR(error_reporter, "Tensor memory live at each op:");
+      const tflite::SubGraph* subgraph = model->subgraphs()->Get(0);
+      int peak_tensor_bytes = 0;
+      for (uint32_t o = 0; o < subgraph->operators()->size(); ++o) {
+        const tflite::Operator* op = subgraph->operators()->Get(o);
+        const int bytes = LiveTensorBytes(model, subgraph, o);
+        TF_LITE_REPORT_ERROR(
+            error_reporter, "  %d %s: %d bytes", static_cast<int>(o),
+            tflite::EnumNameBuiltinOperator(tflite::GetBuiltinCode(
+                model->operator_codes()->Get(op->opcode_index()))),
+            bytes);
+        if (bytes > peak_tensor_bytes) {
+          peak_tensor_bytes = bytes;
+        }
+      }
+
+      // What's left over is scratch buffers, alignment padding and the
+      // allocator's own bookkeeping.
+      const int other_bytes = static_cast<int>(used_bytes) -
+                              static_cast<int>(persistent_bytes) -
+                              peak_tensor_bytes;
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Arena high-water mark: %d bytes, %d persistent, "
+                           "%d for tensors at the peak, %d scratch and "
+                           "overhead",
+                           static_cast<int>(used_bytes),
+                           static_cast<int>(persistent_bytes),
+                           peak_tensor_bytes, other_bytes);
+      if (expected_bytes == 0) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "No arena size is recorded yet, set "
+                             "kTensorArenaUsedBytes = %d in main.cpp",
+                             static_cast<int>(used_bytes));
+      } else if (used_bytes != expected_bytes) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "The arena is sized for %d bytes, set "
+                             "kTensorArenaUsedBytes = %d in main.cpp",
+                             static_cast<int>(expected_bytes),
+                             static_cast<int>(used_bytes));
+      }
+    }
+  }
+  free(arena);
+  return status;
+}
@@ -0,0 +1,38 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_ARENA_REPORT_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_ARENA_REPORT_H_
+
+#include <cstddef>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+// Runs AllocateTensors() for `model` in a recording interpreter with a
+// generous arena taken from the heap, and reports exactly how much of it was
+// used: the high-water mark, the persistent allocations by kind, and the
+// tensor memory live at each op. Compares the high-water mark against
+// `expected_bytes`, the measurement the production arena is sized from, and
+// prints the value to put there if it changed or, when `expected_bytes` is 0,
+// hasn't been recorded yet.
+TfLiteStatus ReportArenaUsage(tflite::ErrorReporter* error_reporter,
+                              const tflite::Model* model,
+                              const tflite::MicroOpResolver& op_resolver,
+                              size_t expected_bytes);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_ARENA_REPORT_H_
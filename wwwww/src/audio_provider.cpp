@@ -15,6 +15,7 @@ limitations under the License.
 
 #include "audio_provider.h"
 
+#include <atomic>
 #include <cstdlib>
 #include <cstring>
 
@@ -30,34 +31,59 @@ limitations under the License.
 #include "esp_system.h"
 #include "esp_timer.h"
 #include "freertos/task.h"
-#include "ringbuf.h"
 #include "micro_model_settings.h"
+#include "ring_stats.h"
 
 using namespace std;
 
 static const char* TAG = "TF_LITE_AUDIO_PROVIDER";
-/* ringbuffer to hold the incoming audio data */
-ringbuf_t* g_audio_capture_buffer;
 volatile int32_t g_latest_audio_timestamp = 0;
-/* model requires 20ms new data from g_audio_capture_buffer and 10ms old data
- * each time , storing old data in the histrory buffer , {
- * history_samples_to_keep = 10 * 16 } */
+/* model requires one stride of new data from g_audio_capture_buffer and the
+ * rest of the window as old data each time, the old data is kept in the ring
+ * buffer as overlap */
 constexpr int32_t history_samples_to_keep =
-    ((kFeatureSliceDurationMs - kFeatureSliceStrideMs) *
-     (kAudioSampleFrequency / 1000));
-/* new samples to get each time from ringbuffer, { new_samples_to_get =  20 * 16
- * } */
-constexpr int32_t new_samples_to_get =
-    (kFeatureSliceStrideMs * (kAudioSampleFrequency / 1000));
+    ModelPipelineConfig::kHistorySamples;
+/* new samples to get each time from ringbuffer */
+constexpr int32_t new_samples_to_get = ModelPipelineConfig::kStrideSamples;
 
 namespace {
-int16_t g_audio_output_buffer[kMaxAudioSampleSize];
+/* ringbuffer to hold the incoming audio data, shared by every reader */
+AudioCaptureBuffer g_audio_capture_buffer;
+/* the model's own cursor into g_audio_capture_buffer */
+AudioCaptureBuffer::Reader g_model_reader;
+/* a task sleeping until the capture task has written up to `wake_at`, it is
+ * woken with a direct-to-task notification as soon as that happens */
+struct AudioWaiter {
+  std::atomic<bool> claimed;
+  std::atomic<TaskHandle_t> task;
+  std::atomic<uint32_t> wake_at;
+  /* esp_timer time, in microseconds truncated to 32 bits, of the write that
+   * crossed `wake_at`, set by the capture task right before it notifies */
+  std::atomic<uint32_t> written_us;
+  /* how long the tasks using this slot slept, how often they were switched
+   * back in, and how long after the write that woke them, only recorded while
+   * claimed */
+  WaitHistogram waits;
+  RelaxedCounter wakeups;
+  WaitHistogram wake_latencies;
+};
+constexpr int kMaxAudioWaiters = 4;
+AudioWaiter g_audio_waiters[kMaxAudioWaiters];
+/* period of the capture stats printed by GetAudioStrides */
+constexpr int32_t kAudioStatsIntervalMs = 10000;
+int32_t g_last_audio_stats_time = 0;
+/* wakeups and audio time as of the previous LogAudioCaptureStats call */
+uint32_t g_logged_wakeups = 0;
+int32_t g_logged_wakeups_time = 0;
 bool g_is_audio_initialized = false;
-int16_t g_history_buffer[history_samples_to_keep];
+/* samples peeked by the previous call, released on the next one so that the
+ * window handed out stays valid until then */
+uint32_t g_samples_peeked = 0;
 }  // namespace
 
-const int32_t kAudioCaptureBufferSize = 80000;
-const int32_t i2s_bytes_to_read = 3200;
+/* read one stride of 32-bit samples at a time from i2s, so a reader
+ * waiting for the next slice is woken once per slice */
+const int32_t i2s_bytes_to_read = new_samples_to_get * sizeof(int32_t);
 
 static void i2s_init(void) {
   // Start listening for audio: MONO @ 16KHz
@@ -97,6 +123,82 @@ static void i2s_init(void) {
   }
 }
 
+/* notify every waiter whose threshold has been reached, called by the capture
+ * task after each write, which finished at `written_us` */
+static void WakeAudioWaiters(uint32_t write_index, int64_t written_us) {
+  for (int i = 0; i < kMaxAudioWaiters; ++i) {
+    AudioWaiter& waiter = g_audio_waiters[i];
+    TaskHandle_t task = waiter.task.load(std::memory_order_acquire);
+    if (task == nullptr ||
+        static_cast<int32_t>(write_index - waiter.wake_at.load(
+                                               std::memory_order_relaxed)) <
+            0) {
+      continue;
+    }
+    /* whoever clears the slot owns the wakeup, the waiter may have timed out
+     * and cleared it already */
+    waiter.written_us.store(static_cast<uint32_t>(written_us),
+                            std::memory_order_relaxed);
+    if (waiter.task.compare_exchange_strong(task, nullptr)) {
+      xTaskNotifyGive(task);
+    }
+  }
+}
+
+/* sleep until the capture task has written up to `wake_at`, returns false if
+ * ticks_to_wait passes first */
+static bool WaitForWriteIndex(uint32_t wake_at, TickType_t ticks_to_wait) {
+  if (static_cast<int32_t>(g_audio_capture_buffer.write_index() - wake_at) >=
+      0) {
+    return true;
+  }
+  TaskHandle_t self = xTaskGetCurrentTaskHandle();
+  AudioWaiter* slot = nullptr;
+  for (int i = 0; i < kMaxAudioWaiters && slot == nullptr; ++i) {
+    bool expected = false;
+    if (g_audio_waiters[i].claimed.compare_exchange_strong(expected, true)) {
+      slot = &g_audio_waiters[i];
+    }
+  }
+  if (slot == nullptr) {
+    ESP_LOGW(TAG, "Too many tasks waiting for audio");
+    vTaskDelay(1);
+  } else {
+    /* the capture task only looks at the slot once `task` is published */
+    slot->wake_at.store(wake_at, std::memory_order_relaxed);
+    slot->task.store(self, std::memory_order_release);
+    const int64_t start_us = esp_timer_get_time();
+    const TickType_t start = xTaskGetTickCount();
+    TickType_t waited = 0;
+    /* the write may have landed while the slot was being claimed, and a
+     * notification left over from an earlier timeout can wake us early, so
+     * check the condition again after every wakeup */
+    while (static_cast<int32_t>(g_audio_capture_buffer.write_index() -
+                                wake_at) < 0 &&
+           waited < ticks_to_wait) {
+      const uint32_t notifications =
+          ulTaskNotifyTake(pdTRUE, ticks_to_wait - waited);
+      waited = xTaskGetTickCount() - start;
+      /* every return is a context switch back into this task, but only a
+       * notification for the write it waits for has a latency to speak of */
+      slot->wakeups.Add(1);
+      if (notifications != 0 &&
+          static_cast<int32_t>(g_audio_capture_buffer.write_index() -
+                               wake_at) >= 0) {
+        slot->wake_latencies.Record(
+            static_cast<uint32_t>(esp_timer_get_time()) -
+            slot->written_us.load(std::memory_order_relaxed));
+      }
+    }
+    TaskHandle_t expected = self;
+    slot->task.compare_exchange_strong(expected, nullptr);
+    slot->waits.Record(esp_timer_get_time() - start_us);
+    slot->claimed.store(false, std::memory_order_release);
+  }
+  return static_cast<int32_t>(g_audio_capture_buffer.write_index() -
+                              wake_at) >= 0;
+}
+
 static void CaptureSamples(void* arg) {
   size_t bytes_read = i2s_bytes_to_read;
   // 根據 32-bit 調整 buffer 型別
@@ -106,7 +208,7 @@ static void CaptureSamples(void* arg) {
 
   i2s_init();
   while (1) {
-    /* read 100ms data at once from i2s */
+    /* read 20ms data at once from i2s */
     i2s_read(I2S_NUM_0, (void*)i2s_read_buffer, i2s_bytes_to_read, &bytes_read,
              portMAX_DELAY);
     if (bytes_read <= 0) {
@@ -121,18 +223,16 @@ static void CaptureSamples(void* arg) {
         // 右移 14 位是基於 INMP441 的特性，保留 18-bit 有效數據
         i2s_write_buffer[i] = (int16_t)(i2s_read_buffer[i] >> 14);
       }
-      /* write bytes read by i2s into ring buffer */
-      int bytes_written = rb_write(g_audio_capture_buffer,
-                                   (uint8_t*)i2s_write_buffer, bytes_read / 2, 10);
+      /* write samples read by i2s into ring buffer, this never blocks and
+       * overwrites the oldest audio, a reader that is that far behind counts
+       * the samples it missed itself */
+      g_audio_capture_buffer.Write(i2s_write_buffer, samples_read);
+      const int64_t written_us = esp_timer_get_time();
       /* update the timestamp (in ms) to let the model know that new data has
        * arrived */
       g_latest_audio_timestamp +=
-          ((1000 * (bytes_written / 2)) / kAudioSampleFrequency);
-      if (bytes_written <= 0) {
-        ESP_LOGE(TAG, "Could Not Write in Ring Buffer: %d ", bytes_written);
-      } else if (bytes_written < bytes_read) {
-        ESP_LOGW(TAG, "Partial Write");
-      }
+          ModelPipelineConfig::MsForSamples(samples_read);
+      WakeAudioWaiters(g_audio_capture_buffer.write_index(), written_us);
     }
   }
   vTaskDelete(NULL);
@@ -140,10 +240,27 @@ static void CaptureSamples(void* arg) {
   free(i2s_write_buffer);
 }
 
+/* release the window handed out by the previous GetAudioStrides call, keeping
+ * its last history_samples_to_keep samples in the ring buffer as the history
+ * of the next one */
+static void ReleasePeekedWindow(void) {
+  if (g_samples_peeked > 0) {
+    g_model_reader.Consume(g_samples_peeked, history_samples_to_keep);
+    g_samples_peeked = 0;
+  }
+}
+
+/* how long to wait for `samples` of audio: the time it takes to capture them,
+ * plus a stride of slack for the I2S read that delivers the last of them */
+static int32_t AudioWaitTimeoutMs(uint32_t samples) {
+  return ModelPipelineConfig::MsForSamples(samples) +
+         ModelPipelineConfig::kStrideMs;
+}
+
 TfLiteStatus InitAudioRecording(tflite::ErrorReporter* error_reporter) {
-  g_audio_capture_buffer = rb_init("tf_ringbuffer", kAudioCaptureBufferSize);
-  if (!g_audio_capture_buffer) {
-    ESP_LOGE(TAG, "Error creating ring buffer");
+  g_model_reader = g_audio_capture_buffer.Attach();
+  if (!g_model_reader.attached()) {
+    TF_LITE_REPORT_ERROR(error_reporter, "No reader left for the model");
     return kTfLiteError;
   }
   /* create CaptureSamples Task which will get the i2s_data from mic and fill it
@@ -155,9 +272,8 @@ TfLiteStatus InitAudioRecording(tflite::ErrorReporter* error_reporter) {
   return kTfLiteOk;
 }
 
-TfLiteStatus GetAudioSamples(tflite::ErrorReporter* error_reporter,
-                             int start_ms, int duration_ms,
-                             int* audio_samples_size, int16_t** audio_samples) {
+static TfLiteStatus EnsureAudioRecording(
+    tflite::ErrorReporter* error_reporter) {
   if (!g_is_audio_initialized) {
     TfLiteStatus init_status = InitAudioRecording(error_reporter);
     if (init_status != kTfLiteOk) {
@@ -165,34 +281,142 @@ TfLiteStatus GetAudioSamples(tflite::ErrorReporter* error_reporter,
     }
     g_is_audio_initialized = true;
   }
-  /* copy 160 samples (320 bytes) into output_buff from history */
-  memcpy((void*)(g_audio_output_buffer), (void*)(g_history_buffer),
-         history_samples_to_keep * sizeof(int16_t));
-
-  /* copy 320 samples (640 bytes) from rb at ( int16_t*(g_audio_output_buffer) +
-   * 160 ), first 160 samples (320 bytes) will be from history */
-  int32_t bytes_read =
-      rb_read(g_audio_capture_buffer,
-              ((uint8_t*)(g_audio_output_buffer + history_samples_to_keep)),
-              new_samples_to_get * sizeof(int16_t), 10);
-  if (bytes_read < 0) {
-    ESP_LOGE(TAG, " Model Could not read data from Ring Buffer");
-  } else if (bytes_read < new_samples_to_get * sizeof(int16_t)) {
-    ESP_LOGD(TAG, "RB FILLED RIGHT NOW IS %d",
-             rb_filled(g_audio_capture_buffer));
-    ESP_LOGD(TAG, " Partial Read of Data by Model ");
-    ESP_LOGV(TAG, " Could only read %d bytes when required %d bytes ",
-             bytes_read, new_samples_to_get * sizeof(int16_t));
-  }
-
-  /* copy 320 bytes from output_buff into history */
-  memcpy((void*)(g_history_buffer),
-         (void*)(g_audio_output_buffer + new_samples_to_get),
-         history_samples_to_keep * sizeof(int16_t));
-
-  *audio_samples_size = kMaxAudioSampleSize;
-  *audio_samples = g_audio_output_buffer;
   return kTfLiteOk;
 }
 
+TfLiteStatus AttachAudioReader(tflite::ErrorReporter* error_reporter,
+                               AudioCaptureBuffer::Reader* reader) {
+  TfLiteStatus init_status = EnsureAudioRecording(error_reporter);
+  if (init_status != kTfLiteOk) {
+    return init_status;
+  }
+  *reader = g_audio_capture_buffer.Attach();
+  if (!reader->attached()) {
+    TF_LITE_REPORT_ERROR(error_reporter, "No audio reader left to attach");
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+void DetachAudioReader(AudioCaptureBuffer::Reader* reader) {
+  g_audio_capture_buffer.Detach(reader);
+}
+
+bool WaitForAudioSamples(const AudioCaptureBuffer::Reader& reader,
+                         uint32_t samples, int32_t timeout_ms) {
+  const uint32_t ready = reader.size();
+  if (ready >= samples) {
+    return true;
+  }
+  if (!g_is_audio_initialized) {
+    return false;
+  }
+  return WaitForWriteIndex(
+      g_audio_capture_buffer.write_index() + (samples - ready),
+      pdMS_TO_TICKS(timeout_ms));
+}
+
+bool WaitForAudioTimestamp(int32_t time_ms, int32_t timeout_ms) {
+  const int32_t ms_to_go = time_ms - g_latest_audio_timestamp;
+  if (ms_to_go <= 0) {
+    return true;
+  }
+  if (!g_is_audio_initialized) {
+    return false;
+  }
+  const uint32_t samples_to_go = ModelPipelineConfig::SamplesForMs(ms_to_go);
+  return WaitForWriteIndex(g_audio_capture_buffer.write_index() + samples_to_go,
+                           pdMS_TO_TICKS(timeout_ms));
+}
+
+TfLiteStatus GetAudioStrides(tflite::ErrorReporter* error_reporter,
+                             int stride_count, AudioCaptureBuffer::Span* span) {
+  TfLiteStatus init_status = EnsureAudioRecording(error_reporter);
+  if (init_status != kTfLiteOk) {
+    return init_status;
+  }
+  ReleasePeekedWindow();
+
+  /* look at stride_count strides in place, the first history_samples_to_keep
+   * samples are the history kept by the previous call, and hand them out as
+   * they lie in the ring buffer even when they wrap */
+  const uint32_t samples_wanted =
+      history_samples_to_keep + stride_count * new_samples_to_get;
+  WaitForAudioSamples(g_model_reader, samples_wanted,
+                      AudioWaitTimeoutMs(samples_wanted));
+  if (g_latest_audio_timestamp - g_last_audio_stats_time >=
+      kAudioStatsIntervalMs) {
+    LogAudioCaptureStats();
+    g_last_audio_stats_time = g_latest_audio_timestamp;
+  }
+  *span = g_model_reader.Peek(samples_wanted);
+  if (span->size() < samples_wanted) {
+    ESP_LOGD(TAG, " Could only read %d samples when required %d samples ",
+             span->size(), samples_wanted);
+  }
+  g_samples_peeked = span->size();
+  return kTfLiteOk;
+}
+
+int32_t TakeLostAudioSamples() {
+  if (!g_is_audio_initialized) {
+    return 0;
+  }
+  return g_model_reader.TakeLost();
+}
+
+void DiscardStaleAudio(int duration_ms) {
+  if (!g_is_audio_initialized) {
+    return;
+  }
+  ReleasePeekedWindow();
+  /* keep the newest duration_ms of audio plus the history of its first
+   * window, and drop everything older */
+  const uint32_t samples_to_keep =
+      ModelPipelineConfig::SamplesForMs(duration_ms) + history_samples_to_keep;
+  g_model_reader.SkipToLatest(samples_to_keep);
+}
+
+void LogAudioCaptureStats() {
+  const RingStats& stats = g_model_reader.stats();
+  ESP_LOGI(TAG,
+           "written: %u, read: %u, lost: %u, peak fill: %u of %u samples "
+           "(%u bytes)",
+           g_audio_capture_buffer.write_index(), stats.elements_read.value(),
+           stats.elements_lost.value(), stats.peak_fill.value(),
+           kAudioCaptureBufferSamples,
+           stats.peak_fill.value() * sizeof(int16_t));
+  /* task wakeups from waiting for audio, in total and per second of audio
+   * since the previous call */
+  uint32_t wakeups = 0;
+  for (int i = 0; i < kMaxAudioWaiters; ++i) {
+    wakeups += g_audio_waiters[i].wakeups.value();
+  }
+  const int32_t now = g_latest_audio_timestamp;
+  if (now > g_logged_wakeups_time) {
+    ESP_LOGI(TAG, "wakeups: %u, %u per second", wakeups,
+             (wakeups - g_logged_wakeups) * 1000 /
+                 static_cast<uint32_t>(now - g_logged_wakeups_time));
+  }
+  g_logged_wakeups = wakeups;
+  g_logged_wakeups_time = now;
+  /* one line per non-empty bucket, summed over all waiter slots */
+  for (int bucket = 0; bucket < WaitHistogram::kBucketCount; ++bucket) {
+    uint32_t waits = 0;
+    uint32_t latencies = 0;
+    for (int i = 0; i < kMaxAudioWaiters; ++i) {
+      waits += g_audio_waiters[i].waits.bucket(bucket);
+      latencies += g_audio_waiters[i].wake_latencies.bucket(bucket);
+    }
+    if (waits > 0) {
+      ESP_LOGI(TAG, "waits < %uus: %u", WaitHistogram::bucket_limit_us(bucket),
+               waits);
+    }
+    if (latencies > 0) {
+      ESP_LOGI(TAG, "woken < %uus after the write: %u",
+               WaitHistogram::bucket_limit_us(bucket), latencies);
+    }
+  }
+}
+
 int32_t LatestAudioTimestamp() { return g_latest_audio_timestamp; }
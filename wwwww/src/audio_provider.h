@@ -16,22 +16,83 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_AUDIO_PROVIDER_H_
 #define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_AUDIO_PROVIDER_H_
 
+#include "broadcast_buffer.h"
+#include "micro_model_settings.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
-// This is an abstraction around an audio source like a microphone, and is
-// expected to return 16-bit PCM sample data for a given point in time. The
-// sample data itself should be used as quickly as possible by the caller, since
-// to allow memory optimizations there are no guarantees that the samples won't
-// be overwritten by new data in the future. In practice, implementations should
-// ensure that there's a reasonable time allowed for clients to access the data
-// before any reuse.
-// The reference implementation can have no platform-specific dependencies, so
-// it just returns an array filled with zeros. For real applications, you should
-// ensure there's a specialized implementation that accesses hardware APIs.
-TfLiteStatus GetAudioSamples(tflite::ErrorReporter* error_reporter,
-                             int start_ms, int duration_ms,
-                             int* audio_samples_size, int16_t** audio_samples);
+// Number of samples the capture ring holds, which is how far behind the newest
+// audio any reader can fall before it starts losing samples. This has to be a
+// power of two, 32768 samples is 2048ms of 16KHz audio.
+constexpr uint32_t kAudioCaptureBufferSamples = 32768;
+typedef BroadcastBuffer<int16_t, kAudioCaptureBufferSamples> AudioCaptureBuffer;
+// A reader that fell behind has to be able to rebuild a whole spectrogram from
+// what's still in the ring.
+static_assert(
+    kAudioCaptureBufferSamples >=
+        static_cast<uint32_t>(ModelPipelineConfig::kSpectrogramSamples),
+    "The capture ring can't hold the audio of a whole spectrogram");
+
+// This is an abstraction around an audio source like a microphone. It returns
+// the 16-bit PCM audio for the next `stride_count` feature slices in one go:
+// the history the previous call kept, followed by `stride_count` strides of new
+// samples. Nothing is copied, the span points into the capture ring buffer and
+// is split in two where it wraps. It stays valid until the next call, unless
+// the model falls so far behind that the capture task laps it, which shows up
+// in TakeLostAudioSamples(). Every 10 seconds it also logs the capture stats,
+// see LogAudioCaptureStats().
+TfLiteStatus GetAudioStrides(tflite::ErrorReporter* error_reporter,
+                             int stride_count, AudioCaptureBuffer::Span* span);
+
+// Gives `reader` its own cursor into the captured audio, starting from the
+// newest samples, so consumers other than the model (a recorder, a voice
+// activity detector, a level meter) can read the same stream without taking
+// samples away from GetAudioStrides or from each other. Starts the capture if
+// it isn't running yet. A reader that falls too far behind, or holds on to a
+// region from Peek() for too long, loses samples of its own without holding up
+// the capture or the other readers, see BroadcastBuffer::Reader::TakeLost().
+// Fails if all the capture ring's reader slots are taken.
+TfLiteStatus AttachAudioReader(tflite::ErrorReporter* error_reporter,
+                               AudioCaptureBuffer::Reader* reader);
+
+// Gives the slot of a reader from AttachAudioReader back, once its task is done
+// reading.
+void DetachAudioReader(AudioCaptureBuffer::Reader* reader);
+
+// Puts the calling task to sleep until `reader` has at least `samples` unread
+// samples, or until `timeout_ms` passes. The timeout is in milliseconds, not
+// FreeRTOS ticks, and has to cover the time it takes to capture the samples
+// that are missing. The capture task wakes the caller directly as soon as the
+// threshold is crossed. Returns whether the samples are there.
+bool WaitForAudioSamples(const AudioCaptureBuffer::Reader& reader,
+                         uint32_t samples, int32_t timeout_ms);
+
+// Puts the calling task to sleep until LatestAudioTimestamp() reaches
+// `time_ms`, or until `timeout_ms` milliseconds pass. Returns whether it was
+// reached.
+bool WaitForAudioTimestamp(int32_t time_ms, int32_t timeout_ms);
+
+// Returns how many samples the capture side overwrote before GetAudioStrides
+// read them, or while the window holding them was out, since the previous
+// call, and resets the count. A non-zero result means the samples returned by
+// GetAudioStrides no longer follow on from the earlier ones, so any state built
+// from them is out of date.
+int32_t TakeLostAudioSamples();
+
+// Drops all buffered audio except the most recent `duration_ms`, so that the
+// next GetAudioStrides calls return the freshest audio instead of working
+// through a backlog.
+void DiscardStaleAudio(int duration_ms);
+
+// Logs how the capture ring is used: samples written, what the model's reader
+// read and lost, the highest fill level it saw, and a histogram of the time
+// spent waiting for audio. Also how often tasks waiting for audio were switched
+// back in, per second since the previous call, and a histogram of how long
+// after the write they waited for that took. Everything is sampled without a
+// lock.
+// GetAudioStrides also calls this every 10 seconds, which shows up when the
+// log level includes ESP_LOGI.
+void LogAudioCaptureStats();
 
 // Returns the time that audio data was last captured in milliseconds. There's
 // no contract about what time zero represents, the accuracy, or the granularity
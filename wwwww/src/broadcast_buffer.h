@@ -0,0 +1,240 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_BROADCAST_BUFFER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_BROADCAST_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "ring_buffer.h"
+
+// Single-writer, multi-reader ring of `N` elements of type `T`. The writer
+// never waits for anyone: it overwrites the oldest data. Every reader keeps its
+// own cursor, so reads aren't destructive and any number of consumers can tap
+// the same stream without copying it. A reader that falls more than `N`
+// elements behind is moved forward to the oldest data still in the ring, and
+// the elements it skipped are added to its own lag counter. The other readers
+// don't notice, they still get every element.
+// That goes for a region a reader is looking at in place, between Peek() and
+// Consume(), too. If its reader holds on to it for almost a whole ring, the
+// writer overwrites it like any other old data, and Consume() adds what was
+// overwritten to the reader's lag counter. So if TakeLost() is zero after
+// Consume(), the region was intact the whole time it was out.
+// Like RingBuffer, the capacity must be a power of two and nothing here blocks
+// or allocates, so it works on the device and on the host.
+template <typename T, uint32_t N>
+class BroadcastBuffer {
+ public:
+  static_assert(N > 0 && (N & (N - 1)) == 0,
+                "BroadcastBuffer capacity must be a power of two");
+  static_assert(N <= (1u << 31), "BroadcastBuffer capacity is too large");
+
+  typedef RingSpan<T> Span;
+
+  // Readers that can be attached at the same time.
+  static constexpr int kMaxReaders = 4;
+
+  // A cursor into the stream. Each reader must only be used from one task, but
+  // different readers can be used from different tasks. Attached readers share
+  // their slot with their copies, so only one copy may be used.
+  class Reader {
+   public:
+    Reader() : buffer_(nullptr), slot_(-1), read_index_(0), lost_(0) {}
+
+    bool attached() const { return buffer_ != nullptr; }
+
+    // Number of elements that are ready to be read.
+    uint32_t size() const {
+      const uint32_t filled = buffer_->write_index() - read_index_;
+      return filled > N ? N : filled;
+    }
+
+    // Exposes up to `count` of this reader's oldest unread elements without
+    // copying them. They stay in place until they're released with Consume(),
+    // unless the writer laps this reader first.
+    Span Peek(uint32_t count) {
+      const uint32_t filled = SkipOverwritten();
+      if (count > filled) {
+        count = filled;
+      }
+      return buffer_->SpanAt(read_index_, count);
+    }
+
+    // Releases the first `count - keep` elements of a region obtained with
+    // Peek(), so the last `keep` elements start the next one. Returns the
+    // number of elements released, without those the writer overwrote while
+    // the region was out, which count as lost.
+    uint32_t Consume(uint32_t count, uint32_t keep = 0) {
+      if (keep > count) {
+        return 0;
+      }
+      const uint32_t end = read_index_ + (count - keep);
+      // Orders the reads of the region before the look at how far the
+      // writer got, see Write().
+      std::atomic_thread_fence(std::memory_order_acquire);
+      const uint32_t filled = SkipOverwritten();
+      uint32_t release = 0;
+      if (static_cast<int32_t>(end - read_index_) > 0) {
+        release = end - read_index_;
+      }
+      if (release > filled) {
+        release = filled;
+      }
+      stats_.elements_read.Add(release);
+      read_index_ += release;
+      return release;
+    }
+
+    // Copies up to `count` elements out and consumes them.
+    uint32_t Read(T* data, uint32_t count) {
+      const Span span = Peek(count);
+      memcpy(data, span.first, span.first_size * sizeof(T));
+      memcpy(data + span.first_size, span.second,
+             span.second_size * sizeof(T));
+      return Consume(span.size());
+    }
+
+    // Returns the number of elements the writer overwrote before this reader
+    // got to them, or while it was looking at them, since the previous call,
+    // and resets the count.
+    uint32_t TakeLost() {
+      SkipOverwritten();
+      const uint32_t lost = lost_;
+      lost_ = 0;
+      return lost;
+    }
+
+    // Usage counters of this reader, safe to read from any task.
+    const RingStats& stats() const { return stats_; }
+
+    // Drops everything older than the newest `keep` elements.
+    void SkipToLatest(uint32_t keep) {
+      const uint32_t filled = SkipOverwritten();
+      if (filled > keep) {
+        read_index_ += filled - keep;
+      }
+    }
+
+   private:
+    friend class BroadcastBuffer;
+    Reader(BroadcastBuffer* buffer, int slot, uint32_t read_index)
+        : buffer_(buffer), slot_(slot), read_index_(read_index), lost_(0) {}
+
+    // Moves the cursor past anything the writer has overwritten or is about
+    // to, counts it as lost, and returns the number of readable elements.
+    uint32_t SkipOverwritten() {
+      const uint32_t limit =
+          buffer_->write_limit_.load(std::memory_order_relaxed);
+      if (limit - read_index_ > N) {
+        const uint32_t skipped = (limit - N) - read_index_;
+        lost_ += skipped;
+        stats_.elements_lost.Add(skipped);
+        read_index_ = limit - N;
+      }
+      // A write of more than `N` elements that's under way can leave the
+      // cursor ahead of the data for a moment.
+      const int32_t filled =
+          static_cast<int32_t>(buffer_->write_index() - read_index_);
+      if (filled <= 0) {
+        return 0;
+      }
+      stats_.peak_fill.Max(filled);
+      return filled;
+    }
+
+    BroadcastBuffer* buffer_;
+    int slot_;
+    uint32_t read_index_;
+    uint32_t lost_;
+    RingStats stats_;
+  };
+
+  BroadcastBuffer() : write_index_(0), write_limit_(0) {
+    for (int i = 0; i < kMaxReaders; ++i) {
+      claimed_[i].store(false, std::memory_order_relaxed);
+    }
+  }
+
+  static constexpr uint32_t capacity() { return N; }
+
+  // Returns a new reader that starts at the newest data, so it only sees what
+  // is written from now on, or one that isn't attached() if kMaxReaders are
+  // attached already.
+  Reader Attach() {
+    for (int i = 0; i < kMaxReaders; ++i) {
+      bool expected = false;
+      if (claimed_[i].compare_exchange_strong(expected, true)) {
+        return Reader(this, i, write_index());
+      }
+    }
+    return Reader();
+  }
+
+  // Gives the slot of `reader` back for another Attach() and leaves `reader`
+  // detached. Its copies mustn't be used any more either.
+  void Detach(Reader* reader) {
+    if (reader->buffer_ == this) {
+      claimed_[reader->slot_].store(false, std::memory_order_release);
+      *reader = Reader();
+    }
+  }
+
+  // Copies `count` elements in, overwriting the oldest data. Only one task may
+  // write.
+  void Write(const T* data, uint32_t count) {
+    const uint32_t write = write_index_.load(std::memory_order_relaxed);
+    // Announce the write before touching the storage, so a reader that was
+    // looking at the elements it overwrites finds out in Consume().
+    write_limit_.store(write + count, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    // Only the last N elements can survive anyway.
+    const uint32_t skip = count > N ? count - N : 0;
+    const uint32_t start = (write + skip) & (N - 1);
+    const uint32_t size = count - skip;
+    const uint32_t first_size = (size > N - start) ? N - start : size;
+    memcpy(&buffer_[start], data + skip, first_size * sizeof(T));
+    memcpy(buffer_, data + skip + first_size,
+           (size - first_size) * sizeof(T));
+    write_index_.store(write + count, std::memory_order_release);
+  }
+
+  // Total number of elements written so far, wrapping at 2^32. This doubles as
+  // the write throughput counter.
+  uint32_t write_index() const {
+    return write_index_.load(std::memory_order_acquire);
+  }
+
+ private:
+  Span SpanAt(uint32_t position, uint32_t count) {
+    const uint32_t start = position & (N - 1);
+    Span span;
+    span.first = &buffer_[start];
+    span.first_size = (count > N - start) ? N - start : count;
+    span.second = buffer_;
+    span.second_size = count - span.first_size;
+    return span;
+  }
+
+  T buffer_[N];
+  std::atomic<uint32_t> write_index_;
+  // End of the write under way, or of the last one.
+  std::atomic<uint32_t> write_limit_;
+  // Whether each reader slot is taken.
+  std::atomic<bool> claimed_[kMaxReaders];
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_BROADCAST_BUFFER_H_
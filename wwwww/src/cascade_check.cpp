@@ -0,0 +1,278 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "cascade_check.h"
+
+#include <cmath>
+#include <cstring>
+
+#include "esp_timer.h"
+#include "micro_features_generator.h"
+#include "micro_model_settings.h"
+#include "no_micro_features_data.h"
+#include "recognize_commands.h"
+#include "speech_gate.h"
+#include "yes_micro_features_data.h"
+
+namespace {
+
+// The stream repeats a stretch of background noise, the "yes" sample, a
+// longer stretch of noise and the "no" sample, about six seconds in all.
+constexpr int kFirstSilenceSlices = 80;
+constexpr int kSecondSilenceSlices = 120;
+constexpr int kNoiseSlices = kFirstSilenceSlices + kSecondSilenceSlices;
+constexpr int kStreamPeriodSlices = kNoiseSlices + 2 * kFeatureSliceCount;
+
+// The frontend runs on this much noise before its slices are kept, so its
+// noise estimates have settled like on a device that's been listening.
+constexpr int kWarmUpSlices = 100;
+constexpr int kWindowSamples = ModelPipelineConfig::kWindowSamples;
+constexpr int kStrideSamples = ModelPipelineConfig::kStrideSamples;
+constexpr float kPi = 3.14159265f;
+
+// The recognizer's default detection threshold, on the int8 scale of the
+// scores.
+constexpr int8_t kWordScore = 200 - 128;
+
+// Static, they're too big for the stack.
+MicroFrontendWorkspace g_noise_workspace;
+MicroFrontend g_noise_frontend;
+int8_t g_noise_slices[kNoiseSlices * kFeatureSliceSize];
+
+// Sample `index` of the background noise, counted from the start of the
+// warm-up: a quiet room at about -50dBFS with some mains hum, a fan that
+// comes on at about -36dBFS halfway through the second stretch, and a knock
+// in each half of it.
+int16_t NoiseSample(int index) {
+  const int slice = index / kStrideSamples - kWarmUpSlices;
+  uint32_t hash = static_cast<uint32_t>(index) * 2654435761u;
+  hash ^= hash >> 16;
+  hash *= 0x45d9f3bu;
+  hash ^= hash >> 16;
+  const float white = (static_cast<int32_t>(hash >> 16) - 32768) / 32768.0f;
+  const float t = static_cast<float>(index) / kAudioSampleFrequency;
+  float value = 0.003f * white + 0.002f * sinf(2.0f * kPi * 50.0f * t);
+  if (slice >= kFirstSilenceSlices + kSecondSilenceSlices / 2) {
+    value += 0.015f * white;
+  }
+  // Knocks, loud at first and gone after about 40ms.
+  const int knock_slices[] = {kFirstSilenceSlices + 20,
+                              kFirstSilenceSlices + 90};
+  for (int knock_slice : knock_slices) {
+    const int since_knock = index - (kWarmUpSlices + knock_slice) *
+                                        kStrideSamples;
+    if (since_knock >= 0 && since_knock < 2 * kStrideSamples) {
+      value += 0.2f * white * expf(-since_knock / (0.2f * kStrideSamples));
+    }
+  }
+  return static_cast<int16_t>(value * 32767.0f);
+}
+
+// Fills g_noise_slices by running a frontend set up like the device's over
+// the background noise, so the gate and the model see what silence really
+// looks like after noise reduction.
+TfLiteStatus GenerateNoiseSlices(tflite::ErrorReporter* error_reporter) {
+  if (g_noise_frontend.InitializeForModel(error_reporter,
+                                          &g_noise_workspace) != kTfLiteOk) {
+    return kTfLiteError;
+  }
+  int16_t window[kWindowSamples];
+  int8_t warm_up_slice[kFeatureSliceSize];
+  for (int n = 0; n < kWarmUpSlices + kNoiseSlices; ++n) {
+    for (int i = 0; i < kWindowSamples; ++i) {
+      window[i] = NoiseSample(n * kStrideSamples + i);
+    }
+    int8_t* slice =
+        (n < kWarmUpSlices)
+            ? warm_up_slice
+            : g_noise_slices + (n - kWarmUpSlices) * kFeatureSliceSize;
+    size_t num_samples_read;
+    if (g_noise_frontend.GenerateFeatures(error_reporter, window,
+                                          kWindowSamples, kFeatureSliceSize,
+                                          slice, &num_samples_read) !=
+        kTfLiteOk) {
+      return kTfLiteError;
+    }
+  }
+  return kTfLiteOk;
+}
+
+// Copies slice `position` of the stream into `slice`.
+void StreamSlice(int position, int8_t* slice) {
+  int offset = position % kStreamPeriodSlices;
+  if (offset < 0) {
+    offset += kStreamPeriodSlices;
+  }
+  const int8_t* source = nullptr;
+  if (offset < kFirstSilenceSlices) {
+    source = g_noise_slices + offset * kFeatureSliceSize;
+  } else if (offset < kFirstSilenceSlices + kFeatureSliceCount) {
+    source = reinterpret_cast<const int8_t*>(
+                 g_yes_micro_f2e59fea_nohash_1_data) +
+             (offset - kFirstSilenceSlices) * kFeatureSliceSize;
+  } else if (offset < kStreamPeriodSlices - kFeatureSliceCount) {
+    source = g_noise_slices +
+             (offset - kFeatureSliceCount) * kFeatureSliceSize;
+  } else {
+    source = reinterpret_cast<const int8_t*>(
+                 g_no_micro_f9643d42_nohash_4_data) +
+             (offset - (kStreamPeriodSlices - kFeatureSliceCount)) *
+                 kFeatureSliceSize;
+  }
+  memcpy(slice, source, kFeatureSliceSize);
+}
+
+// Index of the command `label` names, or -1 for silence and unknown.
+int CommandIndex(const char* label) {
+  for (int i = 0; i < kCategoryCount; ++i) {
+    if (i != kSilenceIndex && i != kUnknownIndex &&
+        strcmp(label, kCategoryLabels[i]) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Hands `output` to `recognizer` and counts what it recognized anew in
+// `commands`, per category.
+TfLiteStatus Recognize(RecognizeCommands* recognizer,
+                       const TfLiteTensor* output, int32_t time_ms,
+                       int* commands) {
+  const char* found_command = nullptr;
+  uint8_t score = 0;
+  bool is_new_command = false;
+  if (recognizer->ProcessLatestResults(output, time_ms, &found_command,
+                                       &score, &is_new_command) !=
+      kTfLiteOk) {
+    return kTfLiteError;
+  }
+  const int index = CommandIndex(found_command);
+  if (is_new_command && index >= 0) {
+    ++commands[index];
+  }
+  return kTfLiteOk;
+}
+
+}  // namespace
+
+TfLiteStatus CompareCascadeInference(tflite::ErrorReporter* error_reporter,
+                                     tflite::MicroInterpreter* interpreter,
+                                     int window_count) {
+  if (GenerateNoiseSlices(error_reporter) != kTfLiteOk) {
+    return kTfLiteError;
+  }
+  int8_t* input = interpreter->input(0)->data.int8;
+  const TfLiteTensor* output = interpreter->output(0);
+  SpeechGate gate;
+  RecognizeCommands single_recognizer(error_reporter);
+  RecognizeCommands cascade_recognizer(error_reporter);
+
+  int64_t single_us = 0;
+  int64_t cascade_us = 0;
+  int64_t gate_us = 0;
+  int cascade_invokes = 0;
+  int word_windows = 0;
+  int gated_word_windows = 0;
+  int single_commands[kCategoryCount] = {};
+  int cascade_commands[kCategoryCount] = {};
+  for (int i = 0; i < window_count; ++i) {
+    for (int slice = 0; slice < kFeatureSliceCount; ++slice) {
+      StreamSlice(i - kFeatureSliceCount + 1 + slice,
+                  input + slice * kFeatureSliceSize);
+    }
+    const int32_t time_ms = i * kFeatureSliceStrideMs;
+
+    int64_t start = esp_timer_get_time();
+    const bool is_open =
+        gate.Update(input, (i == 0) ? kFeatureSliceCount : 1);
+    gate_us += esp_timer_get_time() - start;
+    // The single stage runs the model on every window, the cascade gets the
+    // same result for the same cost on the windows the gate lets through.
+    start = esp_timer_get_time();
+    if (interpreter->Invoke() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke() failed");
+      return kTfLiteError;
+    }
+    const int64_t invoke_us = esp_timer_get_time() - start;
+    single_us += invoke_us;
+    if (Recognize(&single_recognizer, output, time_ms, single_commands) !=
+        kTfLiteOk) {
+      return kTfLiteError;
+    }
+    if (is_open) {
+      cascade_us += invoke_us;
+      ++cascade_invokes;
+      if (Recognize(&cascade_recognizer, output, time_ms,
+                    cascade_commands) != kTfLiteOk) {
+        return kTfLiteError;
+      }
+    }
+
+    int top_index = 0;
+    for (int j = 1; j < kCategoryCount; ++j) {
+      if (output->data.int8[j] > output->data.int8[top_index]) {
+        top_index = j;
+      }
+    }
+    if (top_index != kSilenceIndex && top_index != kUnknownIndex &&
+        output->data.int8[top_index] >= kWordScore) {
+      ++word_windows;
+      if (is_open) {
+        ++gated_word_windows;
+      }
+    }
+  }
+
+  // Commands count as recalled up to as many as the single stage recognized
+  // of each.
+  int commands = 0;
+  int recalled_commands = 0;
+  for (int i = 0; i < kCategoryCount; ++i) {
+    commands += single_commands[i];
+    recalled_commands += (cascade_commands[i] < single_commands[i])
+                             ? cascade_commands[i]
+                             : single_commands[i];
+  }
+  const int64_t audio_ms =
+      static_cast<int64_t>(window_count) * kFeatureSliceStrideMs;
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "Single stage: %d invokes, %d us of Invoke() per "
+                       "second of audio",
+                       window_count,
+                       static_cast<int>(single_us * 1000 / audio_ms));
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "Cascade: %d invokes, %d us of Invoke() and %d us of "
+                       "gate per second of audio",
+                       cascade_invokes,
+                       static_cast<int>(cascade_us * 1000 / audio_ms),
+                       static_cast<int>(gate_us * 1000 / audio_ms));
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "Cascade recall: %d of %d windows with a word, %d of "
+                       "%d commands",
+                       gated_word_windows, word_windows, recalled_commands,
+                       commands);
+  if (commands == 0) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "No commands recognized, run the check on more "
+                         "windows");
+    return kTfLiteError;
+  }
+  if (recalled_commands < commands) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "The gate drops commands the model recognizes");
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
@@ -0,0 +1,38 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_CASCADE_CHECK_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_CASCADE_CHECK_H_
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+// Scrolls a spectrogram of the recorded "yes" and "no" samples between
+// stretches of background noise through `window_count` windows, a slice at a
+// time. The noise is synthetic audio with a change of level and a few knocks
+// in it, turned into features by a MicroFrontend set up like the device's.
+// Runs the model on the windows two ways with `interpreter`: on every window,
+// and only on the windows a SpeechGate lets through. Each path feeds a
+// recognizer of its own.
+// Reports the time spent in Invoke() per second of audio on both paths, and
+// the recall of the cascade against the single stage, over the windows where
+// the model heard a word and over the commands recognized. Fails if the
+// cascade misses a command the single stage recognized.
+TfLiteStatus CompareCascadeInference(tflite::ErrorReporter* error_reporter,
+                                     tflite::MicroInterpreter* interpreter,
+                                     int window_count);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_CASCADE_CHECK_H_
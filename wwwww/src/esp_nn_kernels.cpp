@@ -0,0 +1,335 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "esp_nn_kernels.h"
+
+#ifdef MICRO_SPEECH_ESP_NN
+
+#if defined(__has_include)
+#if !__has_include("esp_nn.h")
+#error "MICRO_SPEECH_ESP_NN needs esp_nn.h, add espressif/esp-nn to lib_deps"
+#endif
+#endif
+#include "esp_nn.h"
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/kernel_util.h"
+
+namespace {
+
+constexpr int kInputTensor = 0;
+constexpr int kFilterTensor = 1;
+constexpr int kBiasTensor = 2;
+constexpr int kOutputTensor = 0;
+
+// The reference kernels, which the ESP-NN ones hand anything they don't
+// support to. Both resolvers resolve to the same ones.
+const TfLiteRegistration* g_reference_depthwise_conv = nullptr;
+const TfLiteRegistration* g_reference_fully_connected = nullptr;
+
+struct DepthwiseConvOpData {
+  // Whether ESP-NN can't run this op, which then runs on the reference kernel
+  // with its own data.
+  bool use_reference;
+  void* reference_data;
+  int32_t* per_channel_multiplier;
+  int32_t* per_channel_shift;
+  int32_t input_offset;
+  int32_t output_offset;
+  int32_t activation_min;
+  int32_t activation_max;
+  int padding_width;
+  int padding_height;
+  int scratch_index;
+};
+
+struct FullyConnectedOpData {
+  bool use_reference;
+  void* reference_data;
+  int32_t multiplier;
+  int32_t shift;
+  int32_t input_offset;
+  int32_t filter_offset;
+  int32_t output_offset;
+  int32_t activation_min;
+  int32_t activation_max;
+};
+
+void* DepthwiseConvInit(TfLiteContext* context, const char* buffer,
+                        size_t length) {
+  auto* data = static_cast<DepthwiseConvOpData*>(
+      context->AllocatePersistentBuffer(context, sizeof(DepthwiseConvOpData)));
+  if (data != nullptr) {
+    data->use_reference = false;
+    data->reference_data =
+        g_reference_depthwise_conv->init(context, buffer, length);
+  }
+  return data;
+}
+
+// Shape of a single NHWC image for ESP-NN.
+data_dims_t ImageDims(const TfLiteIntArray* dims) {
+  data_dims_t image;
+  image.width = dims->data[2];
+  image.height = dims->data[1];
+  image.channels = dims->data[3];
+  image.extra = 1;
+  return image;
+}
+
+// Shape of a depthwise filter for ESP-NN, which gets its channels from the
+// input and the depth multiplier.
+data_dims_t FilterDims(const TfLiteIntArray* dims) {
+  data_dims_t filter;
+  filter.width = dims->data[2];
+  filter.height = dims->data[1];
+  filter.channels = 0;
+  filter.extra = 0;
+  return filter;
+}
+
+dw_conv_params_t ConvParams(const TfLiteDepthwiseConvParams* params,
+                            const DepthwiseConvOpData* data) {
+  dw_conv_params_t conv_params;
+  conv_params.in_offset = data->input_offset;
+  conv_params.out_offset = data->output_offset;
+  conv_params.ch_mult = params->depth_multiplier;
+  conv_params.stride.width = params->stride_width;
+  conv_params.stride.height = params->stride_height;
+  conv_params.padding.width = data->padding_width;
+  conv_params.padding.height = data->padding_height;
+  conv_params.dilation.width = 1;
+  conv_params.dilation.height = 1;
+  conv_params.activation.min = data->activation_min;
+  conv_params.activation.max = data->activation_max;
+  return conv_params;
+}
+
+TfLiteStatus DepthwiseConvPrepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<DepthwiseConvOpData*>(node->user_data);
+  const auto* params =
+      static_cast<const TfLiteDepthwiseConvParams*>(node->builtin_data);
+  const TfLiteTensor* input = tflite::GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = tflite::GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias =
+      tflite::GetOptionalInputTensor(context, node, kBiasTensor);
+  TfLiteTensor* output = tflite::GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE(context, input != nullptr && filter != nullptr &&
+                              output != nullptr);
+
+  // ESP-NN only covers int8 with one image and no dilation.
+  const bool is_supported =
+      input->type == kTfLiteInt8 && filter->type == kTfLiteInt8 &&
+      input->dims->size == 4 && input->dims->data[0] == 1 &&
+      params->dilation_width_factor == 1 &&
+      params->dilation_height_factor == 1 &&
+      filter->quantization.type == kTfLiteAffineQuantization;
+  if (!is_supported) {
+    data->use_reference = true;
+    return CallBaseKernel(g_reference_depthwise_conv->prepare, context, node,
+                          data->reference_data);
+  }
+
+  const int channels = filter->dims->data[3];
+  data->per_channel_multiplier = static_cast<int32_t*>(
+      context->AllocatePersistentBuffer(context, channels * sizeof(int32_t)));
+  data->per_channel_shift = static_cast<int32_t*>(
+      context->AllocatePersistentBuffer(context, channels * sizeof(int32_t)));
+  TF_LITE_ENSURE(context, data->per_channel_multiplier != nullptr &&
+                              data->per_channel_shift != nullptr);
+  int32_t unused_multiplier;
+  int unused_shift;
+  TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
+      context, input, filter, bias, output, params->activation,
+      &unused_multiplier, &unused_shift, &data->activation_min,
+      &data->activation_max, data->per_channel_multiplier,
+      reinterpret_cast<int*>(data->per_channel_shift), channels));
+  data->input_offset = -input->params.zero_point;
+  data->output_offset = output->params.zero_point;
+
+  int output_height;
+  int output_width;
+  const TfLitePaddingValues padding = tflite::ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width, 1, 1,
+      input->dims->data[1], input->dims->data[2], filter->dims->data[1],
+      filter->dims->data[2], params->padding, &output_height, &output_width);
+  data->padding_width = padding.width;
+  data->padding_height = padding.height;
+
+  // The vector kernels need a scratch buffer for some shapes.
+  const data_dims_t input_dims = ImageDims(input->dims);
+  const data_dims_t filter_dims = FilterDims(filter->dims);
+  const data_dims_t output_dims = ImageDims(output->dims);
+  const dw_conv_params_t conv_params = ConvParams(params, data);
+  const int scratch_size = esp_nn_get_depthwise_conv_scratch_size(
+      &input_dims, &filter_dims, &output_dims, &conv_params);
+  data->scratch_index = -1;
+  if (scratch_size > 0) {
+    TF_LITE_ENSURE_STATUS(context->RequestScratchBufferInArena(
+        context, scratch_size, &data->scratch_index));
+  }
+  return kTfLiteOk;
+}
+
+TfLiteStatus DepthwiseConvEval(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<DepthwiseConvOpData*>(node->user_data);
+  if (data->use_reference) {
+    return CallBaseKernel(g_reference_depthwise_conv->invoke, context, node,
+                          data->reference_data);
+  }
+  const auto* params =
+      static_cast<const TfLiteDepthwiseConvParams*>(node->builtin_data);
+  const TfLiteEvalTensor* input =
+      tflite::micro::GetEvalInput(context, node, kInputTensor);
+  const TfLiteEvalTensor* filter =
+      tflite::micro::GetEvalInput(context, node, kFilterTensor);
+  const TfLiteEvalTensor* bias =
+      (node->inputs->size > kBiasTensor)
+          ? tflite::micro::GetEvalInput(context, node, kBiasTensor)
+          : nullptr;
+  TfLiteEvalTensor* output =
+      tflite::micro::GetEvalOutput(context, node, kOutputTensor);
+
+  const data_dims_t input_dims = ImageDims(input->dims);
+  const data_dims_t filter_dims = FilterDims(filter->dims);
+  const data_dims_t output_dims = ImageDims(output->dims);
+  const dw_conv_params_t conv_params = ConvParams(params, data);
+  quant_data_t quant_data;
+  quant_data.shift = data->per_channel_shift;
+  quant_data.mult = data->per_channel_multiplier;
+
+  if (data->scratch_index >= 0) {
+    esp_nn_set_depthwise_conv_scratch_buf(
+        context->GetScratchBuffer(context, data->scratch_index));
+  }
+  esp_nn_depthwise_conv_s8(
+      &input_dims, tflite::micro::GetTensorData<int8_t>(input), &filter_dims,
+      tflite::micro::GetTensorData<int8_t>(filter),
+      (bias != nullptr) ? tflite::micro::GetTensorData<int32_t>(bias)
+                        : nullptr,
+      &output_dims, tflite::micro::GetTensorData<int8_t>(output), &conv_params,
+      &quant_data);
+  return kTfLiteOk;
+}
+
+void* FullyConnectedInit(TfLiteContext* context, const char* buffer,
+                         size_t length) {
+  auto* data = static_cast<FullyConnectedOpData*>(
+      context->AllocatePersistentBuffer(context, sizeof(FullyConnectedOpData)));
+  if (data != nullptr) {
+    data->use_reference = false;
+    data->reference_data =
+        g_reference_fully_connected->init(context, buffer, length);
+  }
+  return data;
+}
+
+TfLiteStatus FullyConnectedPrepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<FullyConnectedOpData*>(node->user_data);
+  const auto* params =
+      static_cast<const TfLiteFullyConnectedParams*>(node->builtin_data);
+  const TfLiteTensor* input = tflite::GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = tflite::GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias =
+      tflite::GetOptionalInputTensor(context, node, kBiasTensor);
+  TfLiteTensor* output = tflite::GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE(context, input != nullptr && filter != nullptr &&
+                              output != nullptr);
+
+  // ESP-NN takes row lengths and output sizes as 16 bits.
+  const bool is_supported =
+      input->type == kTfLiteInt8 && filter->type == kTfLiteInt8 &&
+      filter->dims->size == 2 && filter->dims->data[0] <= UINT16_MAX &&
+      filter->dims->data[1] <= UINT16_MAX;
+  if (!is_supported) {
+    data->use_reference = true;
+    return CallBaseKernel(g_reference_fully_connected->prepare, context, node,
+                          data->reference_data);
+  }
+
+  double real_multiplier = 0.0;
+  TF_LITE_ENSURE_STATUS(tflite::GetQuantizedConvolutionMultipler(
+      context, input, filter, bias, output, &real_multiplier));
+  int shift;
+  tflite::QuantizeMultiplier(real_multiplier, &data->multiplier, &shift);
+  data->shift = shift;
+  TF_LITE_ENSURE_STATUS(tflite::CalculateActivationRangeQuantized(
+      context, params->activation, output, &data->activation_min,
+      &data->activation_max));
+  data->input_offset = -input->params.zero_point;
+  data->filter_offset = -filter->params.zero_point;
+  data->output_offset = output->params.zero_point;
+  return kTfLiteOk;
+}
+
+TfLiteStatus FullyConnectedEval(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<FullyConnectedOpData*>(node->user_data);
+  if (data->use_reference) {
+    return CallBaseKernel(g_reference_fully_connected->invoke, context, node,
+                          data->reference_data);
+  }
+  const TfLiteEvalTensor* input =
+      tflite::micro::GetEvalInput(context, node, kInputTensor);
+  const TfLiteEvalTensor* filter =
+      tflite::micro::GetEvalInput(context, node, kFilterTensor);
+  const TfLiteEvalTensor* bias =
+      (node->inputs->size > kBiasTensor)
+          ? tflite::micro::GetEvalInput(context, node, kBiasTensor)
+          : nullptr;
+  TfLiteEvalTensor* output =
+      tflite::micro::GetEvalOutput(context, node, kOutputTensor);
+
+  const int output_depth = filter->dims->data[0];
+  const int accum_depth = filter->dims->data[1];
+  const int32_t* bias_data =
+      (bias != nullptr) ? tflite::micro::GetTensorData<int32_t>(bias)
+                        : nullptr;
+  const int8_t* input_data = tflite::micro::GetTensorData<int8_t>(input);
+  int8_t* output_data = tflite::micro::GetTensorData<int8_t>(output);
+  int input_size = 1;
+  for (int i = 0; i < input->dims->size; ++i) {
+    input_size *= input->dims->data[i];
+  }
+  for (int batch = 0; batch < input_size / accum_depth; ++batch) {
+    esp_nn_fully_connected_s8(
+        input_data, data->input_offset, accum_depth,
+        tflite::micro::GetTensorData<int8_t>(filter), data->filter_offset,
+        bias_data, output_data, output_depth, data->output_offset, data->shift,
+        data->multiplier, data->activation_min, data->activation_max);
+    input_data += accum_depth;
+    output_data += output_depth;
+  }
+  return kTfLiteOk;
+}
+
+const WrappingOpResolver::KernelFunctions kDepthwiseConvFunctions = {
+    DepthwiseConvInit, DepthwiseConvPrepare, DepthwiseConvEval};
+const WrappingOpResolver::KernelFunctions kFullyConnectedFunctions = {
+    FullyConnectedInit, FullyConnectedPrepare, FullyConnectedEval};
+
+}  // namespace
+
+EspNnOpResolver::EspNnOpResolver(const tflite::MicroOpResolver* base)
+    : WrappingOpResolver(base, kDepthwiseConvFunctions,
+                         kFullyConnectedFunctions) {
+  g_reference_depthwise_conv =
+      base->FindOp(tflite::BuiltinOperator_DEPTHWISE_CONV_2D);
+  g_reference_fully_connected =
+      base->FindOp(tflite::BuiltinOperator_FULLY_CONNECTED);
+}
+
+#endif  // MICRO_SPEECH_ESP_NN
@@ -0,0 +1,41 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_ESP_NN_KERNELS_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_ESP_NN_KERNELS_H_
+
+#ifdef MICRO_SPEECH_ESP_NN
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "wrapping_op_resolver.h"
+
+// Resolves ops like `base`, except that int8 DepthwiseConv2D and
+// FullyConnected run on ESP-NN, whose kernels use the vector instructions of
+// the ESP32-S3. Everything else about those ops, the parsing of their options
+// and the quantization parameters, is what the reference kernels do, and
+// ESP-NN computes the same results bit for bit, see CompareKernelBackends().
+// Shapes ESP-NN doesn't handle, and other types, fall back to the reference
+// kernels.
+class EspNnOpResolver : public WrappingOpResolver {
+ public:
+  // `base` has to outlive this, and have every op of the model registered.
+  explicit EspNnOpResolver(const tflite::MicroOpResolver* base);
+};
+
+#endif  // MICRO_SPEECH_ESP_NN
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_ESP_NN_KERNELS_H_
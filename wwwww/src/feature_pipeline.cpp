@@ -0,0 +1,154 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "feature_pipeline.h"
+
+#include "audio_provider.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+namespace {
+
+const char* TAG = "FEATURE_PIPELINE";
+
+// Enough for the frontend's stack use plus logging.
+constexpr uint32_t kFeatureTaskStackBytes = 8 * 1024;
+
+// Period of the drop count logged by the feature task.
+constexpr int32_t kPipelineStatsIntervalMs = 10000;
+
+}  // namespace
+
+FeaturePipeline::FeaturePipeline(FeatureProvider* provider,
+                                 int8_t* const buffers[kBufferCount])
+    : provider_(provider),
+      error_reporter_(nullptr),
+      consumer_(nullptr),
+      next_buffer_(0),
+      windows_peeked_(0) {
+  for (int i = 0; i < kBufferCount; ++i) {
+    buffers_[i] = buffers[i];
+  }
+}
+
+TfLiteStatus FeaturePipeline::Start(tflite::ErrorReporter* error_reporter,
+                                    int core, int priority) {
+  error_reporter_ = error_reporter;
+  consumer_ = xTaskGetCurrentTaskHandle();
+  if (xTaskCreatePinnedToCore(TaskEntry, "FeaturePipeline",
+                              kFeatureTaskStackBytes, this, priority, nullptr,
+                              core) != pdPASS) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Couldn't start the feature task");
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+void FeaturePipeline::TaskEntry(void* arg) {
+  static_cast<FeaturePipeline*>(arg)->Run();
+}
+
+void FeaturePipeline::Run() {
+  int32_t previous_time = 0;
+  int32_t last_stats_time = 0;
+  // Slices added since the last published window.
+  int pending_slices = 0;
+  for (;;) {
+    // Sleep until the next stride of audio has been captured.
+    WaitForAudioTimestamp(
+        ((previous_time / kFeatureSliceStrideMs) + 1) * kFeatureSliceStrideMs,
+        kFeatureSliceStrideMs * 5);
+    const int32_t current_time = LatestAudioTimestamp();
+    int how_many_new_slices = 0;
+    const int64_t feature_start = esp_timer_get_time();
+    if (provider_->PopulateFeatureData(error_reporter_, previous_time,
+                                       current_time, &how_many_new_slices) !=
+        kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter_, "Feature generation failed");
+      continue;
+    }
+    const uint32_t feature_us =
+        static_cast<uint32_t>(esp_timer_get_time() - feature_start);
+    previous_time = current_time;
+    if (how_many_new_slices == 0) {
+      continue;
+    }
+    pending_slices += how_many_new_slices;
+    if (pending_slices > kFeatureSliceCount) {
+      pending_slices = kFeatureSliceCount;
+    }
+
+    RingSpan<FeatureWindow> slot = queue_.Reserve(1);
+    if (slot.size() == 0) {
+      // The consumer still holds every buffer. This window is skipped, and
+      // the slices it added go out with the next one.
+      dropped_windows_.Add(1);
+      ESP_LOGD(TAG, "No free buffer, skipped the window at %d ms",
+               current_time);
+    } else {
+      FeatureWindow* window = slot.first;
+      window->time_ms = current_time;
+      window->new_slices = pending_slices;
+      window->feature_us = feature_us;
+      window->buffer_index = next_buffer_;
+      window->features = buffers_[next_buffer_];
+      provider_->CopyFeatureData(window->features);
+      queue_.Commit(1);
+      next_buffer_ = (next_buffer_ + 1) % kBufferCount;
+      pending_slices = 0;
+      xTaskNotifyGive(consumer_);
+    }
+
+    if (current_time - last_stats_time >= kPipelineStatsIntervalMs) {
+      ESP_LOGI(TAG, "%u windows dropped so far",
+               static_cast<unsigned>(dropped_windows_.value()));
+      last_stats_time = current_time;
+    }
+  }
+}
+
+const FeatureWindow* FeaturePipeline::WaitForWindow(int32_t timeout_ms) {
+  RingSpan<FeatureWindow> span = queue_.Peek(kBufferCount);
+  while (span.size() == 0) {
+    // A notification left over from a window that was already taken wakes
+    // this up for nothing, which only costs one more trip around the loop.
+    if (ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms)) == 0) {
+      return nullptr;
+    }
+    span = queue_.Peek(kBufferCount);
+  }
+  windows_peeked_ = span.size();
+  // Anything older than the newest window is already stale, but the slices
+  // it brought are still part of what changed.
+  dropped_windows_.Add(windows_peeked_ - 1);
+  int new_slices = 0;
+  for (uint32_t i = 0; i < span.first_size; ++i) {
+    new_slices += span.first[i].new_slices;
+  }
+  for (uint32_t i = 0; i < span.second_size; ++i) {
+    new_slices += span.second[i].new_slices;
+  }
+  FeatureWindow* newest = (span.second_size > 0)
+                              ? &span.second[span.second_size - 1]
+                              : &span.first[span.first_size - 1];
+  newest->new_slices =
+      (new_slices < kFeatureSliceCount) ? new_slices : kFeatureSliceCount;
+  return newest;
+}
+
+void FeaturePipeline::ReleaseWindow() {
+  queue_.Consume(windows_peeked_);
+  windows_peeked_ = 0;
+}
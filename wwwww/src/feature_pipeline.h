@@ -0,0 +1,107 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FEATURE_PIPELINE_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FEATURE_PIPELINE_H_
+
+#include <cstdint>
+
+// clang-format off
+#include "freertos/FreeRTOS.h"
+// clang-format on
+
+#include "feature_provider.h"
+#include "freertos/task.h"
+#include "micro_model_settings.h"
+#include "ring_buffer.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+// A whole spectrogram as of `time_ms`, in the layout the model takes, held in
+// `features`, which is the input buffer number `buffer_index`. Only its last
+// `new_slices` slices differ from the previous window the consumer got, even
+// when windows were dropped in between. Generating its slices took
+// `feature_us`.
+struct FeatureWindow {
+  int32_t time_ms;
+  int new_slices;
+  uint32_t feature_us;
+  int buffer_index;
+  int8_t* features;
+};
+
+// Runs a FeatureProvider in a task of its own, so feature generation for the
+// next stride goes on while the model runs on the current one: in parallel
+// when the two are on different cores, or by preempting the model when they
+// share one. Every stride that brings new slices publishes a FeatureWindow to
+// a single consumer through a lock-free queue.
+// The spectrogram is written straight into one of kBufferCount input buffers,
+// typically the input tensors of as many interpreters, which take turns. The
+// consumer runs the model on a window's buffer in place and hands it back
+// afterwards, so windows change hands without being copied.
+// The queue applies backpressure instead of growing: while every buffer is
+// taken, the producer keeps its spectrogram up to date but publishes nothing,
+// and the consumer always gets the newest window that's waiting. No audio is
+// lost either way, only inferences on windows that were already stale.
+class FeaturePipeline {
+ public:
+  // One window being inferred and one being filled or waiting is enough to
+  // keep both sides busy.
+  static constexpr int kBufferCount = 2;
+
+  // `provider` and the kFeatureElementCount bytes behind each of `buffers`
+  // must outlive the pipeline, and are only used by its task once Start() was
+  // called.
+  FeaturePipeline(FeatureProvider* provider,
+                  int8_t* const buffers[kBufferCount]);
+
+  // Starts the feature task on `core`. The calling task becomes the consumer,
+  // the only one that may call WaitForWindow() and ReleaseWindow().
+  TfLiteStatus Start(tflite::ErrorReporter* error_reporter, int core,
+                     int priority);
+
+  // Puts the consumer to sleep until a window is published, or `timeout_ms`
+  // passes. Returns the newest window, whose buffer stays unchanged until
+  // ReleaseWindow(), or nullptr on timeout.
+  const FeatureWindow* WaitForWindow(int32_t timeout_ms);
+
+  // Hands the window from WaitForWindow() back once its buffer isn't needed
+  // anymore, along with any older ones it skipped, so the feature task can
+  // fill their buffers again.
+  void ReleaseWindow();
+
+  // Windows that were never inferred, either because the queue was full when
+  // they were ready or because a newer one was waiting behind them.
+  uint32_t dropped_windows() const { return dropped_windows_.value(); }
+
+ private:
+  static void TaskEntry(void* arg);
+  void Run();
+
+  FeatureProvider* provider_;
+  int8_t* buffers_[kBufferCount];
+  tflite::ErrorReporter* error_reporter_;
+  TaskHandle_t consumer_;
+  // Windows are published and released in order, and the queue holds one
+  // per buffer, so a free queue slot means the next buffer is free too.
+  RingBuffer<FeatureWindow, kBufferCount> queue_;
+  // Buffer the next window goes into, only touched by the feature task.
+  int next_buffer_;
+  // Windows held by the consumer since WaitForWindow().
+  uint32_t windows_peeked_;
+  RelaxedCounter dropped_windows_;
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FEATURE_PIPELINE_H_
@@ -15,13 +15,22 @@ limitations under the License.
 
 #include "feature_provider.h"
 
+#include <cstring>
+
 #include "audio_provider.h"
 #include "micro_features_generator.h"
 #include "micro_model_settings.h"
+#include "noise_snapshot.h"
 
 FeatureProvider::FeatureProvider(int feature_size, int8_t* feature_data)
     : feature_size_(feature_size),
       feature_data_(feature_data),
+      head_(0),
+      noise_reference_(),
+      noise_reference_time_(0),
+      last_noise_snapshot_time_(0),
+      is_noise_settled_(false),
+      is_warm_start_(false),
       is_first_run_(true) {
   // Initialize the feature data to default values.
   for (int n = 0; n < feature_size_; ++n) {
@@ -31,6 +40,56 @@ FeatureProvider::FeatureProvider(int feature_size, int8_t* feature_data)
 
 FeatureProvider::~FeatureProvider() {}
 
+TfLiteStatus FeatureProvider::SetFeatureQuantization(
+    tflite::ErrorReporter* error_reporter, float scale, int32_t zero_point) {
+  return frontend_.SetOutputQuantization(error_reporter, scale, zero_point);
+}
+
+void FeatureProvider::CopyFeatureData(int8_t* output) const {
+  const int head_offset = head_ * kFeatureSliceSize;
+  memcpy(output, feature_data_ + head_offset,
+         kFeatureElementCount - head_offset);
+  memcpy(output + (kFeatureElementCount - head_offset), feature_data_,
+         head_offset);
+}
+
+void FeatureProvider::TrackNoiseEstimates(
+    tflite::ErrorReporter* error_reporter, int32_t time_in_ms) {
+  constexpr int32_t kSettleCheckIntervalMs = 1000;
+  if (!is_noise_settled_ &&
+      time_in_ms - noise_reference_time_ >= kSettleCheckIntervalMs) {
+    // The estimates count as settled once no channel moved by more than 1/32
+    // over the last second.
+    uint32_t estimates[kFeatureSliceSize];
+    frontend_.GetNoiseEstimates(estimates);
+    bool is_settled = true;
+    for (int i = 0; i < kFeatureSliceSize; ++i) {
+      const uint32_t change = (estimates[i] > noise_reference_[i])
+                                  ? estimates[i] - noise_reference_[i]
+                                  : noise_reference_[i] - estimates[i];
+      if (change > noise_reference_[i] / 32) {
+        is_settled = false;
+      }
+      noise_reference_[i] = estimates[i];
+    }
+    noise_reference_time_ = time_in_ms;
+    if (is_settled) {
+      is_noise_settled_ = true;
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Noise estimates settled %d ms after a %s start",
+                           time_in_ms, is_warm_start_ ? "warm" : "cold");
+      // Save right away, so even a short run leaves a snapshot behind.
+      last_noise_snapshot_time_ = time_in_ms - kNoiseSnapshotIntervalMs;
+    }
+  }
+  // Estimates that haven't settled yet aren't worth carrying over.
+  if (is_noise_settled_ &&
+      time_in_ms - last_noise_snapshot_time_ >= kNoiseSnapshotIntervalMs) {
+    QueueNoiseEstimatesSave(error_reporter, frontend_);
+    last_noise_snapshot_time_ = time_in_ms;
+  }
+}
+
 TfLiteStatus FeatureProvider::PopulateFeatureData(
     tflite::ErrorReporter* error_reporter, int32_t last_time_in_ms,
     int32_t time_in_ms, int* how_many_new_slices) {
@@ -49,72 +108,76 @@ TfLiteStatus FeatureProvider::PopulateFeatureData(
   int slices_needed = current_step - last_step;
   // If this is the first call, make sure we don't use any cached information.
   if (is_first_run_) {
-    TfLiteStatus init_status = InitializeMicroFeatures(error_reporter);
+    TfLiteStatus init_status =
+        frontend_.InitializeForModel(error_reporter, &frontend_workspace_);
     if (init_status != kTfLiteOk) {
       return init_status;
     }
+    // Start from the noise estimates of the last run if they still apply.
+    is_warm_start_ = RestoreNoiseEstimates(error_reporter, &frontend_);
+    frontend_.GetNoiseEstimates(noise_reference_);
+    noise_reference_time_ = time_in_ms;
     is_first_run_ = false;
     slices_needed = kFeatureSliceCount;
   }
+  // If the capture side overwrote audio we never read, the spectrogram no
+  // longer lines up with the audio clock. Skip the backlog and rebuild every
+  // slice from the freshest audio instead of working through stale samples.
+  const int32_t lost_samples = TakeLostAudioSamples();
+  if (lost_samples > 0) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Lost %d audio samples, resynchronizing",
+                         lost_samples);
+    DiscardStaleAudio(ModelPipelineConfig::kSpectrogramMs);
+    slices_needed = kFeatureSliceCount;
+  }
   if (slices_needed > kFeatureSliceCount) {
     slices_needed = kFeatureSliceCount;
   }
   *how_many_new_slices = slices_needed;
 
-  const int slices_to_keep = kFeatureSliceCount - slices_needed;
-  const int slices_to_drop = kFeatureSliceCount - slices_to_keep;
-  // If we can avoid recalculating some slices, just move the existing data
-  // up in the spectrogram, to perform something like this:
+  // The spectrogram is kept as a ring of slices, so instead of moving the
+  // slices we keep up in the buffer, the new ones just overwrite the oldest
+  // rows and the head moves past them:
   // last time = 80ms          current time = 120ms
   // +-----------+             +-----------+
-  // | data@20ms |         --> | data@60ms |
-  // +-----------+       --    +-----------+
-  // | data@40ms |     --  --> | data@80ms |
-  // +-----------+   --  --    +-----------+
-  // | data@60ms | --  --      |  <empty>  |
-  // +-----------+   --        +-----------+
-  // | data@80ms | --          |  <empty>  |
+  // | data@60ms |             | data@60ms | <- head
   // +-----------+             +-----------+
-  if (slices_to_keep > 0) {
-    for (int dest_slice = 0; dest_slice < slices_to_keep; ++dest_slice) {
-      int8_t* dest_slice_data =
-          feature_data_ + (dest_slice * kFeatureSliceSize);
-      const int src_slice = dest_slice + slices_to_drop;
-      const int8_t* src_slice_data =
-          feature_data_ + (src_slice * kFeatureSliceSize);
-      for (int i = 0; i < kFeatureSliceSize; ++i) {
-        dest_slice_data[i] = src_slice_data[i];
-      }
-    }
-  }
-  // Any slices that need to be filled in with feature data have their
-  // appropriate audio data pulled, and features calculated for that slice.
+  // | data@80ms |             | data@80ms |
+  // +-----------+             +-----------+
+  // | data@20ms | <- head     | data@100ms|
+  // +-----------+             +-----------+
+  // | data@40ms |             | data@120ms|
+  // +-----------+             +-----------+
+  // Any slices that need to be filled in with feature data have the audio for
+  // all of them pulled at once, and their features calculated in a single pass
+  // straight into those rows.
   if (slices_needed > 0) {
-    for (int new_slice = slices_to_keep; new_slice < kFeatureSliceCount;
-         ++new_slice) {
-      const int new_step = (current_step - kFeatureSliceCount + 1) + new_slice;
-      const int32_t slice_start_ms = (new_step * kFeatureSliceStrideMs);
-      int16_t* audio_samples = nullptr;
-      int audio_samples_size = 0;
-      // TODO(petewarden): Fix bug that leads to non-zero slice_start_ms
-      GetAudioSamples(error_reporter, (slice_start_ms > 0 ? slice_start_ms : 0),
-                      kFeatureSliceDurationMs, &audio_samples_size,
-                      &audio_samples);
-      if (audio_samples_size < kMaxAudioSampleSize) {
-        TF_LITE_REPORT_ERROR(error_reporter,
-                             "Audio data size %d too small, want %d",
-                             audio_samples_size, kMaxAudioSampleSize);
-        return kTfLiteError;
-      }
-      int8_t* new_slice_data = feature_data_ + (new_slice * kFeatureSliceSize);
-      size_t num_samples_read;
-      TfLiteStatus generate_status = GenerateMicroFeatures(
-          error_reporter, audio_samples, audio_samples_size, kFeatureSliceSize,
-          new_slice_data, &num_samples_read);
-      if (generate_status != kTfLiteOk) {
-        return generate_status;
-      }
+    AudioCaptureBuffer::Span audio_span;
+    TfLiteStatus audio_status =
+        GetAudioStrides(error_reporter, slices_needed, &audio_span);
+    if (audio_status != kTfLiteOk) {
+      return audio_status;
+    }
+    const int rows_to_end = kFeatureSliceCount - head_;
+    const int first_rows =
+        (slices_needed < rows_to_end) ? slices_needed : rows_to_end;
+    RingSpan<int8_t> rows;
+    rows.first = feature_data_ + (head_ * kFeatureSliceSize);
+    rows.first_size = first_rows * kFeatureSliceSize;
+    rows.second = feature_data_;
+    rows.second_size = (slices_needed - first_rows) * kFeatureSliceSize;
+    // If the audio came up short, the last slices keep their old contents,
+    // just like a partial read used to leave stale samples in the window.
+    int slices_generated = 0;
+    TfLiteStatus generate_status = frontend_.GenerateFeaturesBatch(
+        error_reporter, audio_span, slices_needed, kFeatureSliceSize, rows,
+        &slices_generated);
+    if (generate_status != kTfLiteOk) {
+      return generate_status;
     }
+    head_ = (head_ + slices_needed) % kFeatureSliceCount;
+    TrackNoiseEstimates(error_reporter, time_in_ms);
   }
   return kTfLiteOk;
 }
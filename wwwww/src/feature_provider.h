@@ -16,6 +16,8 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FEATURE_PROVIDER_H_
 #define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FEATURE_PROVIDER_H_
 
+#include "micro_features_generator.h"
+#include "micro_model_settings.h"
 #include "tensorflow/lite/c/common.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
@@ -26,6 +28,9 @@ limitations under the License.
 // horizontal slices representing the frequencies at one point in time, stacked
 // on top of each other to form a spectrogram showing how those frequencies
 // changed over time.
+// The slices are stored as a ring, oldest first starting at a moving head row,
+// so new slices replace the oldest ones without scrolling the rest. Use
+// CopyFeatureData() to get them in time order.
 class FeatureProvider {
  public:
   // Create the provider, and bind it to an area of memory. This memory should
@@ -35,15 +40,44 @@ class FeatureProvider {
   FeatureProvider(int feature_size, int8_t* feature_data);
   ~FeatureProvider();
 
+  // Quantizes features for a model input tensor with the given parameters, so
+  // the feature data can be handed to the model as is.
+  TfLiteStatus SetFeatureQuantization(tflite::ErrorReporter* error_reporter,
+                                      float scale, int32_t zero_point);
+
   // Fills the feature data with information from audio inputs, and returns how
   // many feature slices were updated.
   TfLiteStatus PopulateFeatureData(tflite::ErrorReporter* error_reporter,
                                    int32_t last_time_in_ms, int32_t time_in_ms,
                                    int* how_many_new_slices);
 
+  // Writes the whole spectrogram to `output` oldest slice first, the layout
+  // the model takes, with at most two contiguous copies. That is all
+  // kFeatureElementCount bytes for every window: TFLM can't bind the input
+  // tensor to the ring's rotated view, so the features can't be generated
+  // straight into it.
+  void CopyFeatureData(int8_t* output) const;
+
  private:
+  // Watches the frontend's noise estimates settle after startup, and once they
+  // have, saves them regularly for the next boot.
+  void TrackNoiseEstimates(tflite::ErrorReporter* error_reporter,
+                           int32_t time_in_ms);
+
   int feature_size_;
   int8_t* feature_data_;
+  // Each provider runs its own frontend, so providers don't share state.
+  MicroFrontend frontend_;
+  MicroFrontendWorkspace frontend_workspace_;
+  // Row holding the oldest slice, which the next new slice replaces.
+  int head_;
+  // Noise estimates as of noise_reference_time_, to see whether they still
+  // move.
+  uint32_t noise_reference_[kFeatureSliceSize];
+  int32_t noise_reference_time_;
+  int32_t last_noise_snapshot_time_;
+  bool is_noise_settled_;
+  bool is_warm_start_;
   // Make sure we don't try to use cached information if this is the first call
   // into the provider.
   bool is_first_run_;
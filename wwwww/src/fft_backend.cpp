@@ -0,0 +1,95 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "fft_backend.h"
+
+// Configure FFT to output 16 bit fixed point.
+#define FIXED_POINT 16
+
+#ifdef MICRO_SPEECH_ESP_DSP_FFT
+#include "esp_dsp.h"
+#endif
+
+TfLiteStatus KissFftBackend::Initialize(tflite::ErrorReporter* error_reporter,
+                                        const FftState& state) {
+  // FrontendPopulateState() already set up the kissfft scratch space.
+  return kTfLiteOk;
+}
+
+complex_int16_t* KissFftBackend::Compute(FftState* state,
+                                         const int16_t* input,
+                                         int input_scale_shift) {
+  FftCompute(state, input, input_scale_shift);
+  return state->output;
+}
+
+#ifdef MICRO_SPEECH_ESP_DSP_FFT
+
+namespace {
+// ESP-DSP keeps one twiddle table for all transforms. Handing it static
+// storage keeps it off the heap.
+alignas(16) int16_t g_esp_dsp_twiddles[kMaxAudioSampleSize];
+bool g_is_esp_dsp_initialized = false;
+}  // namespace
+
+TfLiteStatus EspDspFftBackend::Initialize(
+    tflite::ErrorReporter* error_reporter, const FftState& state) {
+  if (state.fft_size > static_cast<size_t>(kMaxAudioSampleSize)) {
+    TF_LITE_REPORT_ERROR(error_reporter, "FFT size %d is over the %d maximum",
+                         static_cast<int>(state.fft_size),
+                         kMaxAudioSampleSize);
+    return kTfLiteError;
+  }
+  if (!g_is_esp_dsp_initialized) {
+    esp_err_t init_status =
+        dsps_fft2r_init_sc16(g_esp_dsp_twiddles, kMaxAudioSampleSize);
+    if (init_status != ESP_OK) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "dsps_fft2r_init_sc16() failed with %d",
+                           init_status);
+      return kTfLiteError;
+    }
+    g_is_esp_dsp_initialized = true;
+  }
+  return kTfLiteOk;
+}
+
+complex_int16_t* EspDspFftBackend::Compute(FftState* state,
+                                           const int16_t* input,
+                                           int input_scale_shift) {
+  const size_t fft_size = state->fft_size;
+  size_t i;
+  for (i = 0; i < state->input_size; ++i) {
+    data_[2 * i] = static_cast<int16_t>(static_cast<uint16_t>(input[i])
+                                        << input_scale_shift);
+    data_[2 * i + 1] = 0;
+  }
+  for (; i < fft_size; ++i) {
+    data_[2 * i] = 0;
+    data_[2 * i + 1] = 0;
+  }
+  // Like kissfft, every radix-2 stage halves the values, which keeps them in
+  // range and scales the result down by fft_size.
+  dsps_fft2r_sc16(data_, fft_size);
+  dsps_bit_rev_sc16_ansi(data_, fft_size);
+  return reinterpret_cast<complex_int16_t*>(data_);
+}
+
+#endif  // MICRO_SPEECH_ESP_DSP_FFT
+
+FftBackend* ReferenceFftBackend() {
+  static KissFftBackend backend;
+  return &backend;
+}
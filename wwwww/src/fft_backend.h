@@ -0,0 +1,89 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FFT_BACKEND_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FFT_BACKEND_H_
+
+#include "micro_model_settings.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/fft.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+// Computes the FFT stage of the feature frontend. Every implementation has to
+// produce what the bundled kissfft code does: the first fft_size / 2 + 1 bins
+// of the real FFT of the zero padded input, scaled down by fft_size, as 16-bit
+// fixed point.
+class FftBackend {
+ public:
+  virtual ~FftBackend() {}
+
+  // Short name for logs.
+  virtual const char* name() const = 0;
+
+  // Prepares for transforms of `state.fft_size` points.
+  virtual TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter,
+                                  const FftState& state) = 0;
+
+  // Transforms the first `state->input_size` samples of `input`, each shifted
+  // left by `input_scale_shift`. The bins stay valid until the next call. The
+  // buffers in `state` may be used as scratch space.
+  virtual complex_int16_t* Compute(FftState* state, const int16_t* input,
+                                   int input_scale_shift) = 0;
+};
+
+// The microfrontend's own kissfft path, kept as the reference the others are
+// checked against.
+class KissFftBackend : public FftBackend {
+ public:
+  const char* name() const override { return "kissfft"; }
+  TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter,
+                          const FftState& state) override;
+  complex_int16_t* Compute(FftState* state, const int16_t* input,
+                           int input_scale_shift) override;
+};
+
+#ifdef MICRO_SPEECH_ESP_DSP_FFT
+// Radix-2 16-bit FFT from ESP-DSP, which uses the vector instructions of the
+// ESP32-S3. It runs a complex transform over the real input, which still comes
+// out well ahead of the generic kissfft real transform. The transform runs in
+// scratch space owned by the instance, so frontends that can run at the same
+// time each need their own.
+class EspDspFftBackend : public FftBackend {
+ public:
+  const char* name() const override { return "esp-dsp"; }
+  TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter,
+                          const FftState& state) override;
+  complex_int16_t* Compute(FftState* state, const int16_t* input,
+                           int input_scale_shift) override;
+
+ private:
+  // Interleaved real and imaginary parts, aligned for the vector loads.
+  alignas(16) int16_t data_[2 * kMaxAudioSampleSize];
+};
+#endif  // MICRO_SPEECH_ESP_DSP_FFT
+
+// The backend every new frontend gets an instance of: ESP-DSP when built with
+// MICRO_SPEECH_ESP_DSP_FFT, kissfft otherwise.
+#ifdef MICRO_SPEECH_ESP_DSP_FFT
+typedef EspDspFftBackend DefaultFftBackend;
+#else
+typedef KissFftBackend DefaultFftBackend;
+#endif
+
+// The kissfft backend, for comparisons. It keeps no state of its own, so one
+// instance serves every frontend.
+FftBackend* ReferenceFftBackend();
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FFT_BACKEND_H_
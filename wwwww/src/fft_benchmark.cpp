@@ -0,0 +1,316 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "fft_benchmark.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "esp_timer.h"
+#include "frontend_stages.h"
+#include "micro_features_generator.h"
+#include "micro_model_settings.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/fft_util.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "xtensa/hal.h"
+
+namespace {
+
+constexpr int kWindowSamples = ModelPipelineConfig::kWindowSamples;
+constexpr int kStrideSamples = ModelPipelineConfig::kStrideSamples;
+constexpr int kBenchmarkTransforms = 200;
+constexpr int kSpectrumSize = kFrontendFftSize / 2 + 1;
+constexpr float kPi = 3.14159265f;
+
+// A chirp from 100Hz to 7.5kHz every second, with its level rising and falling
+// over 40dB, on top of quiet noise.
+int16_t SyntheticSample(int index) {
+  const float t = static_cast<float>(index % kAudioSampleFrequency) /
+                  kAudioSampleFrequency;
+  const float phase = 2.0f * kPi * (100.0f * t + 0.5f * 7400.0f * t * t);
+  const float level =
+      0.01f * powf(100.0f, 0.5f + 0.5f * sinf(2.0f * kPi * 3.0f * t));
+  const uint32_t noise = static_cast<uint32_t>(index) * 1664525u + 1013904223u;
+  const float value = level * sinf(phase) +
+                      0.002f * (static_cast<int32_t>(noise >> 16) - 32768) /
+                          32768.0f;
+  return static_cast<int16_t>(value * 32767.0f);
+}
+
+// Average microseconds per transform of `backend`.
+int TimeFft(tflite::ErrorReporter* error_reporter, FftBackend* backend,
+            FftState* state, const int16_t* input) {
+  if (backend->Initialize(error_reporter, *state) != kTfLiteOk) {
+    return -1;
+  }
+  const int64_t start = esp_timer_get_time();
+  for (int i = 0; i < kBenchmarkTransforms; ++i) {
+    backend->Compute(state, input, 1);
+  }
+  return static_cast<int>((esp_timer_get_time() - start) /
+                          kBenchmarkTransforms);
+}
+
+// Stages timed by CompareFrontendStages().
+enum FrontendStage {
+  kFilterbankStage,
+  kSqrtStage,
+  kNoiseReductionStage,
+  kPcanStage,
+  kLogScaleStage,
+  kFrontendStageCount,
+};
+
+const char* const kFrontendStageNames[kFrontendStageCount] = {
+    "filterbank", "sqrt", "noise reduction", "pcan", "log scale",
+};
+
+}  // namespace
+
+TfLiteStatus CompareFrontendStages(tflite::ErrorReporter* error_reporter,
+                                   int window_count) {
+  FrontendConfig config;
+  MicroFrontend::FillModelConfig(&config);
+  FrontendState reference;
+  FrontendState fast;
+  if (!FrontendPopulateState(&config, &reference, kAudioSampleFrequency)) {
+    TF_LITE_REPORT_ERROR(error_reporter, "FrontendPopulateState() failed");
+    return kTfLiteError;
+  }
+  if (!FrontendPopulateState(&config, &fast, kAudioSampleFrequency)) {
+    TF_LITE_REPORT_ERROR(error_reporter, "FrontendPopulateState() failed");
+    FrontendFreeStateContents(&reference);
+    return kTfLiteError;
+  }
+  InitializeFastLogScale();
+  const int correction_bits =
+      MostSignificantBit32(reference.fft.fft_size) - 1 - (kFilterbankBits / 2);
+
+  uint32_t reference_cycles[kFrontendStageCount] = {};
+  uint32_t fast_cycles[kFrontendStageCount] = {};
+  int differing_windows[kFrontendStageCount] = {};
+  int16_t audio[kWindowSamples];
+  int samples_generated = 0;
+  int windows_done = 0;
+  while (windows_done < window_count) {
+    // The first window needs all of its samples, the others just a stride.
+    const int audio_size = (samples_generated == 0) ? kWindowSamples
+                                                    : kStrideSamples;
+    for (int i = 0; i < audio_size; ++i) {
+      audio[i] = SyntheticSample(samples_generated + i);
+    }
+    samples_generated += audio_size;
+    size_t num_samples_read;
+    if (!WindowProcessSamples(&reference.window, audio, audio_size,
+                              &num_samples_read)) {
+      continue;
+    }
+    const int input_shift =
+        15 - MostSignificantBit32(reference.window.max_abs_output_value);
+    FftCompute(&reference.fft, reference.window.output, input_shift);
+    complex_int16_t spectrum[kSpectrumSize];
+    memcpy(spectrum, reference.fft.output, sizeof(spectrum));
+
+    // Each stage runs on both sides in turn, and their results are compared
+    // before the next stage works on them in place.
+    int32_t energy[kSpectrumSize];
+    uint32_t start = xthal_get_ccount();
+    FilterbankConvertFftComplexToEnergy(&reference.filterbank, spectrum,
+                                        energy);
+    FilterbankAccumulateChannels(&reference.filterbank, energy);
+    reference_cycles[kFilterbankStage] += xthal_get_ccount() - start;
+    start = xthal_get_ccount();
+    FastFilterbankAccumulate(&fast.filterbank, spectrum);
+    fast_cycles[kFilterbankStage] += xthal_get_ccount() - start;
+    if (memcmp(fast.filterbank.work, reference.filterbank.work,
+               sizeof(uint64_t) * (kFeatureSliceSize + 1)) != 0) {
+      ++differing_windows[kFilterbankStage];
+    }
+
+    start = xthal_get_ccount();
+    uint32_t* reference_signal =
+        FilterbankSqrt(&reference.filterbank, input_shift);
+    reference_cycles[kSqrtStage] += xthal_get_ccount() - start;
+    start = xthal_get_ccount();
+    uint32_t* fast_signal = FastFilterbankSqrt(&fast.filterbank, input_shift);
+    fast_cycles[kSqrtStage] += xthal_get_ccount() - start;
+    const size_t signal_bytes = sizeof(uint32_t) * kFeatureSliceSize;
+    if (memcmp(fast_signal, reference_signal, signal_bytes) != 0) {
+      ++differing_windows[kSqrtStage];
+    }
+
+    start = xthal_get_ccount();
+    NoiseReductionApply(&reference.noise_reduction, reference_signal);
+    reference_cycles[kNoiseReductionStage] += xthal_get_ccount() - start;
+    start = xthal_get_ccount();
+    FastNoiseReductionApply(&fast.noise_reduction, fast_signal);
+    fast_cycles[kNoiseReductionStage] += xthal_get_ccount() - start;
+    if (memcmp(fast_signal, reference_signal, signal_bytes) != 0 ||
+        memcmp(fast.noise_reduction.estimate,
+               reference.noise_reduction.estimate, signal_bytes) != 0) {
+      ++differing_windows[kNoiseReductionStage];
+    }
+
+    start = xthal_get_ccount();
+    PcanGainControlApply(&reference.pcan_gain_control, reference_signal);
+    reference_cycles[kPcanStage] += xthal_get_ccount() - start;
+    start = xthal_get_ccount();
+    FastPcanGainControlApply(&fast.pcan_gain_control, fast_signal);
+    fast_cycles[kPcanStage] += xthal_get_ccount() - start;
+    if (memcmp(fast_signal, reference_signal, signal_bytes) != 0) {
+      ++differing_windows[kPcanStage];
+    }
+
+    start = xthal_get_ccount();
+    const uint16_t* reference_output =
+        LogScaleApply(&reference.log_scale, reference_signal,
+                      kFeatureSliceSize, correction_bits);
+    reference_cycles[kLogScaleStage] += xthal_get_ccount() - start;
+    start = xthal_get_ccount();
+    const uint16_t* fast_output = FastLogScaleApply(
+        &fast.log_scale, fast_signal, kFeatureSliceSize, correction_bits);
+    fast_cycles[kLogScaleStage] += xthal_get_ccount() - start;
+    if (memcmp(fast_output, reference_output,
+               sizeof(uint16_t) * kFeatureSliceSize) != 0) {
+      ++differing_windows[kLogScaleStage];
+    }
+    ++windows_done;
+  }
+  FrontendFreeStateContents(&reference);
+  FrontendFreeStateContents(&fast);
+
+  TfLiteStatus status = kTfLiteOk;
+  uint32_t reference_total = 0;
+  uint32_t fast_total = 0;
+  for (int i = 0; i < kFrontendStageCount; ++i) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "%s: library %d cycles, fast %d cycles, %d of %d "
+                         "windows differ",
+                         kFrontendStageNames[i],
+                         static_cast<int>(reference_cycles[i] / window_count),
+                         static_cast<int>(fast_cycles[i] / window_count),
+                         differing_windows[i], window_count);
+    reference_total += reference_cycles[i];
+    fast_total += fast_cycles[i];
+    if (differing_windows[i] > 0) {
+      status = kTfLiteError;
+    }
+  }
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "Stages after the FFT: library %d cycles, fast %d "
+                       "cycles",
+                       static_cast<int>(reference_total / window_count),
+                       static_cast<int>(fast_total / window_count));
+  if (status != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "The fast frontend stages don't match the library");
+  }
+  return status;
+}
+
+TfLiteStatus CompareFftBackends(tflite::ErrorReporter* error_reporter,
+                                FftBackend* reference, FftBackend* candidate,
+                                int window_count, int tolerance) {
+  int16_t window[kWindowSamples];
+  for (int i = 0; i < kWindowSamples; ++i) {
+    window[i] = SyntheticSample(i);
+  }
+
+  FftState fft_state;
+  if (!FftPopulateState(&fft_state, kWindowSamples)) {
+    TF_LITE_REPORT_ERROR(error_reporter, "FftPopulateState() failed");
+    return kTfLiteError;
+  }
+  const int reference_fft_us =
+      TimeFft(error_reporter, reference, &fft_state, window);
+  const int candidate_fft_us =
+      TimeFft(error_reporter, candidate, &fft_state, window);
+  FftFreeStateContents(&fft_state);
+  if (reference_fft_us < 0 || candidate_fft_us < 0) {
+    return kTfLiteError;
+  }
+
+  FrontendConfig config;
+  MicroFrontend::FillModelConfig(&config);
+  MicroFrontend reference_frontend;
+  MicroFrontend candidate_frontend;
+  if (reference_frontend.Initialize(error_reporter, config,
+                                    kAudioSampleFrequency) != kTfLiteOk ||
+      reference_frontend.SetFftBackend(error_reporter, reference) !=
+          kTfLiteOk ||
+      candidate_frontend.Initialize(error_reporter, config,
+                                    kAudioSampleFrequency) != kTfLiteOk ||
+      candidate_frontend.SetFftBackend(error_reporter, candidate) !=
+          kTfLiteOk) {
+    return kTfLiteError;
+  }
+
+  int64_t reference_us = 0;
+  int64_t candidate_us = 0;
+  int max_difference = 0;
+  int differing_features = 0;
+  for (int n = 0; n < window_count; ++n) {
+    for (int i = 0; i < kWindowSamples; ++i) {
+      window[i] = SyntheticSample((n * kStrideSamples) + i);
+    }
+    int8_t reference_features[kFeatureSliceSize];
+    int8_t candidate_features[kFeatureSliceSize];
+    size_t num_samples_read;
+    const int64_t start = esp_timer_get_time();
+    TfLiteStatus reference_status = reference_frontend.GenerateFeatures(
+        error_reporter, window, kWindowSamples, kFeatureSliceSize,
+        reference_features, &num_samples_read);
+    const int64_t middle = esp_timer_get_time();
+    TfLiteStatus candidate_status = candidate_frontend.GenerateFeatures(
+        error_reporter, window, kWindowSamples, kFeatureSliceSize,
+        candidate_features, &num_samples_read);
+    const int64_t end = esp_timer_get_time();
+    if (reference_status != kTfLiteOk || candidate_status != kTfLiteOk) {
+      return kTfLiteError;
+    }
+    reference_us += middle - start;
+    candidate_us += end - middle;
+    for (int i = 0; i < kFeatureSliceSize; ++i) {
+      const int difference =
+          abs(reference_features[i] - candidate_features[i]);
+      if (difference > 0) {
+        ++differing_features;
+      }
+      if (difference > max_difference) {
+        max_difference = difference;
+      }
+    }
+  }
+
+  TF_LITE_REPORT_ERROR(error_reporter, "FFT %s: %d us, %s: %d us",
+                       reference->name(), reference_fft_us, candidate->name(),
+                       candidate_fft_us);
+  TF_LITE_REPORT_ERROR(
+      error_reporter, "Feature slice %s: %d us, %s: %d us", reference->name(),
+      static_cast<int>(reference_us / window_count), candidate->name(),
+      static_cast<int>(candidate_us / window_count));
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "%d of %d features differ, by at most %d (limit %d)",
+                       differing_features, window_count * kFeatureSliceSize,
+                       max_difference, tolerance);
+  if (max_difference > tolerance) {
+    TF_LITE_REPORT_ERROR(error_reporter, "%s features are out of tolerance",
+                         candidate->name());
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
@@ -0,0 +1,40 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FFT_BENCHMARK_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FFT_BENCHMARK_H_
+
+#include "fft_backend.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+// Times `candidate` against `reference`, both for a bare FFT and for a whole
+// feature slice, and checks that the int8 features they lead to never differ
+// by more than `tolerance`. The audio is a fixed synthetic signal that sweeps
+// every filterbank channel at changing levels, so results are repeatable and
+// need no microphone. Reports the timings, and returns an error if the
+// features drift too far.
+TfLiteStatus CompareFftBackends(tflite::ErrorReporter* error_reporter,
+                                FftBackend* reference, FftBackend* candidate,
+                                int window_count, int tolerance);
+
+// Runs the stages after the FFT from frontend_stages.h and from the library
+// side by side on `window_count` windows of the same synthetic audio, and
+// reports the CPU cycles each stage takes on average. Returns an error if any
+// of them produces a single value that's different.
+TfLiteStatus CompareFrontendStages(tflite::ErrorReporter* error_reporter,
+                                   int window_count);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FFT_BENCHMARK_H_
@@ -0,0 +1,278 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "frontend_stages.h"
+
+#include <cmath>
+
+#include "micro_model_settings.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/filterbank.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/log_scale.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/noise_reduction.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/pcan_gain_control.h"
+
+namespace {
+
+// Values below this, after the correction shift, come out of the log table.
+// PCAN maps channels at the noise floor to well under it, so in practice it
+// covers most of every slice.
+constexpr int kLogTableSize = 2048;
+
+// What LogScaleApply() returns for every value under kLogTableSize, at the
+// kLogScaleShift the model was trained with.
+struct LogTable {
+  LogTable();
+  uint16_t values[kLogTableSize];
+};
+
+LogTable::LogTable() {
+  LogScaleState state;
+  state.enable_log = 1;
+  state.scale_shift = kLogScaleShift;
+  // LogScaleApply() packs its 16-bit output into the front of the input, so
+  // the table is filled in chunks.
+  constexpr int kChunkSize = 64;
+  uint32_t chunk[kChunkSize];
+  for (int start = 0; start < kLogTableSize; start += kChunkSize) {
+    for (int i = 0; i < kChunkSize; ++i) {
+      chunk[i] = start + i;
+    }
+    const uint16_t* logs = LogScaleApply(&state, chunk, kChunkSize, 0);
+    for (int i = 0; i < kChunkSize; ++i) {
+      values[start + i] = logs[i];
+    }
+  }
+}
+
+// Built by whichever frontend gets here first, exactly once even when several
+// start at the same time, and never written again.
+const LogTable& GetLogTable() {
+  static const LogTable table;
+  return table;
+}
+
+// The channel widths are padded to blocks of this many bins by
+// FilterbankPopulateState() and tools/generate_frontend_tables.cpp.
+constexpr int kFilterbankChannelBlockSize = 4;
+
+// Rounded square root, exactly like Sqrt32() and Sqrt64() in filterbank.c:
+// floor(sqrt(num)), plus one if the remainder is larger than that, unless it
+// would overflow. The library finds the root one bit at a time; here a float
+// estimate from the top 24 bits gets corrected with integer math. For the
+// filterbank's values, which stay under 2^48, the estimate is at most a
+// couple off.
+inline uint32_t RoundedSqrt(uint64_t num) {
+  if (num == 0) {
+    return 0;
+  }
+  if ((num >> 32) == 0) {
+    const uint32_t num32 = static_cast<uint32_t>(num);
+    uint32_t root = static_cast<uint32_t>(sqrtf(static_cast<float>(num32)));
+    if (root > 0xFFFF) {
+      root = 0xFFFF;
+    }
+    while (root * root > num32) {
+      --root;
+    }
+    while (root < 0xFFFF && (root + 1) * (root + 1) <= num32) {
+      ++root;
+    }
+    // Sqrt32() rounds up to at most 16 bits.
+    if (num32 - root * root > root && root != 0xFFFF) {
+      ++root;
+    }
+    return root;
+  }
+  // Keep an even number of bits, so the root of the rest only needs shifting
+  // by half of them.
+  const int shift = (MostSignificantBit64(num) - 23) & ~1;
+  uint64_t root = static_cast<uint64_t>(
+      sqrtf(static_cast<float>(num >> shift)) *
+      static_cast<float>(1u << (shift / 2)));
+  if (root > 0xFFFFFFFF) {
+    root = 0xFFFFFFFF;
+  }
+  while (root * root > num) {
+    --root;
+  }
+  while (root < 0xFFFFFFFF && (root + 1) * (root + 1) <= num) {
+    ++root;
+  }
+  if (num - root * root > root && root != 0xFFFFFFFF) {
+    ++root;
+  }
+  return static_cast<uint32_t>(root);
+}
+
+// NoiseReductionApply() for one channel.
+inline void ReduceNoise(uint32_t smoothing, uint32_t min_signal_remaining,
+                        int smoothing_bits, uint32_t* estimate,
+                        uint32_t* signal) {
+  const uint32_t one_minus_smoothing = (1 << kNoiseReductionBits) - smoothing;
+  const uint32_t signal_scaled_up = *signal << smoothing_bits;
+  uint32_t new_estimate =
+      ((static_cast<uint64_t>(signal_scaled_up) * smoothing) +
+       (static_cast<uint64_t>(*estimate) * one_minus_smoothing)) >>
+      kNoiseReductionBits;
+  *estimate = new_estimate;
+  if (new_estimate > signal_scaled_up) {
+    new_estimate = signal_scaled_up;
+  }
+  const uint32_t floor =
+      (static_cast<uint64_t>(*signal) * min_signal_remaining) >>
+      kNoiseReductionBits;
+  const uint32_t subtracted =
+      (signal_scaled_up - new_estimate) >> smoothing_bits;
+  *signal = subtracted > floor ? subtracted : floor;
+}
+
+// WideDynamicFunction() from pcan_gain_control.c, here so it can be inlined.
+inline int16_t PcanGain(uint32_t x, const int16_t* lut) {
+  if (x <= 2) {
+    return lut[x];
+  }
+  const int16_t interval = MostSignificantBit32(x);
+  lut += 4 * interval - 6;
+  const int16_t frac =
+      ((interval < 11) ? (x << (11 - interval)) : (x >> (interval - 11))) &
+      0x3FF;
+  int32_t result = (static_cast<int32_t>(lut[2]) * frac) >> 5;
+  result += static_cast<int32_t>(static_cast<uint32_t>(lut[1]) << 5);
+  result *= frac;
+  result = (result + (1 << 14)) >> 15;
+  result += lut[0];
+  return static_cast<int16_t>(result);
+}
+
+// PcanShrink() from pcan_gain_control.c.
+inline uint32_t PcanShrinkInline(uint32_t x) {
+  if (x < (2 << kPcanSnrBits)) {
+    return (x * x) >> (2 + 2 * kPcanSnrBits - kPcanOutputBits);
+  }
+  return (x >> (kPcanSnrBits - kPcanOutputBits)) - (1 << kPcanOutputBits);
+}
+
+}  // namespace
+
+void InitializeFastLogScale() { GetLogTable(); }
+
+void FastFilterbankAccumulate(FilterbankState* state,
+                              const complex_int16_t* fft_output) {
+  uint64_t* work = state->work;
+  uint64_t weight_accumulator = 0;
+  uint64_t unweight_accumulator = 0;
+  const int num_channels_plus_1 = state->num_channels + 1;
+  for (int i = 0; i < num_channels_plus_1; ++i) {
+    // The library only computes the energy of the bins between start_index
+    // and end_index, the padding outside them always has zero weights.
+    const complex_int16_t* bins =
+        fft_output + state->channel_frequency_starts[i];
+    const int16_t* weights = state->weights + state->channel_weight_starts[i];
+    const int16_t* unweights =
+        state->unweights + state->channel_weight_starts[i];
+    const int width = state->channel_widths[i];
+    for (int j = 0; j < width; j += kFilterbankChannelBlockSize) {
+      for (int k = 0; k < kFilterbankChannelBlockSize; ++k) {
+        const int32_t real = bins[j + k].real;
+        const int32_t imag = bins[j + k].imag;
+        // Wraps like the int32_t energy in the library, then the products
+        // are taken as 32 x 32 -> 64 bits, which is all the 64-bit ones in
+        // FilterbankAccumulateChannels() amount to.
+        const int32_t energy = static_cast<int32_t>(
+            static_cast<uint32_t>(real * real) +
+            static_cast<uint32_t>(imag * imag));
+        weight_accumulator += static_cast<uint64_t>(
+            static_cast<int64_t>(weights[j + k]) * energy);
+        unweight_accumulator += static_cast<uint64_t>(
+            static_cast<int64_t>(unweights[j + k]) * energy);
+      }
+    }
+    work[i] = weight_accumulator;
+    weight_accumulator = unweight_accumulator;
+    unweight_accumulator = 0;
+  }
+}
+
+uint32_t* FastFilterbankSqrt(FilterbankState* state, int scale_down_shift) {
+  const int num_channels = state->num_channels;
+  const uint64_t* work = state->work + 1;
+  // Same as the library, the output overwrites the work buffer it was read
+  // from.
+  uint32_t* output = reinterpret_cast<uint32_t*>(state->work);
+  for (int i = 0; i < num_channels; ++i) {
+    output[i] = RoundedSqrt(work[i]) >> scale_down_shift;
+  }
+  return output;
+}
+
+void FastNoiseReductionApply(NoiseReductionState* state, uint32_t* signal) {
+  const uint32_t even_smoothing = state->even_smoothing;
+  const uint32_t odd_smoothing = state->odd_smoothing;
+  const uint32_t min_signal_remaining = state->min_signal_remaining;
+  const int smoothing_bits = state->smoothing_bits;
+  const int num_channels = state->num_channels;
+  uint32_t* estimate = state->estimate;
+  // Channels come in even and odd pairs, which saves picking the smoothing
+  // for each of them.
+  int i = 0;
+  for (; i + 1 < num_channels; i += 2) {
+    ReduceNoise(even_smoothing, min_signal_remaining, smoothing_bits,
+                &estimate[i], &signal[i]);
+    ReduceNoise(odd_smoothing, min_signal_remaining, smoothing_bits,
+                &estimate[i + 1], &signal[i + 1]);
+  }
+  if (i < num_channels) {
+    ReduceNoise(even_smoothing, min_signal_remaining, smoothing_bits,
+                &estimate[i], &signal[i]);
+  }
+}
+
+void FastPcanGainControlApply(PcanGainControlState* state, uint32_t* signal) {
+  const uint32_t* noise_estimate = state->noise_estimate;
+  const int16_t* gain_lut = state->gain_lut;
+  const int32_t snr_shift = state->snr_shift;
+  const int num_channels = state->num_channels;
+  for (int i = 0; i < num_channels; ++i) {
+    const uint32_t gain = PcanGain(noise_estimate[i], gain_lut);
+    const uint32_t snr =
+        (static_cast<uint64_t>(signal[i]) * gain) >> snr_shift;
+    signal[i] = PcanShrinkInline(snr);
+  }
+}
+
+uint16_t* FastLogScaleApply(LogScaleState* state, uint32_t* signal,
+                            int signal_size, int correction_bits) {
+  if (!state->enable_log || state->scale_shift != kLogScaleShift) {
+    return LogScaleApply(state, signal, signal_size, correction_bits);
+  }
+  const uint16_t* log_table = GetLogTable().values;
+  uint16_t* output = reinterpret_cast<uint16_t*>(signal);
+  for (int i = 0; i < signal_size; ++i) {
+    uint32_t value = signal[i];
+    if (correction_bits < 0) {
+      value >>= -correction_bits;
+    } else {
+      value <<= correction_bits;
+    }
+    if (value < static_cast<uint32_t>(kLogTableSize)) {
+      output[i] = log_table[value];
+    } else {
+      // Rare enough that going through the library costs nothing.
+      output[i] = *LogScaleApply(state, &value, 1, 0);
+    }
+  }
+  return output;
+}
@@ -0,0 +1,52 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_STAGES_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_STAGES_H_
+
+#include <cstdint>
+
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+
+// Faster versions of the frontend stages that run after the FFT. Each one
+// takes the same state as its counterpart in the microfrontend library and
+// produces exactly the same values, bit for bit, so they can be swapped in
+// one at a time and checked against the library with CompareFrontendStages().
+
+// Builds the log table used by FastLogScaleApply(), which otherwise happens on
+// its first call. The table is only built once and only covers kLogScaleShift,
+// any other shift goes through the library for every value.
+void InitializeFastLogScale();
+
+// FilterbankConvertFftComplexToEnergy() followed by
+// FilterbankAccumulateChannels(), in a single pass over the FFT bins that
+// never stores the energy.
+void FastFilterbankAccumulate(FilterbankState* state,
+                              const complex_int16_t* fft_output);
+
+// FilterbankSqrt().
+uint32_t* FastFilterbankSqrt(FilterbankState* state, int scale_down_shift);
+
+// NoiseReductionApply().
+void FastNoiseReductionApply(NoiseReductionState* state, uint32_t* signal);
+
+// PcanGainControlApply().
+void FastPcanGainControlApply(PcanGainControlState* state, uint32_t* signal);
+
+// LogScaleApply().
+uint16_t* FastLogScaleApply(LogScaleState* state, uint32_t* signal,
+                            int signal_size, int correction_bits);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_STAGES_H_
@@ -0,0 +1,47 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Generated by tools/generate_frontend_tables.cpp from the settings in
+// micro_model_settings.h. Don't edit, rerun the tool instead.
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_TABLES_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_TABLES_H_
+
+#include <cstdint>
+
+constexpr int kFrontendWindowSize = 480;
+constexpr int kFrontendWindowStep = 320;
+constexpr int kFrontendFftSize = 512;
+constexpr int kFrontendFilterbankStartIndex = 5;
+constexpr int kFrontendFilterbankEndIndex = 241;
+constexpr int kFrontendFilterbankChannelCount = 41;
+constexpr int kFrontendFilterbankWeightCount = 316;
+constexpr uint16_t kFrontendNoiseEvenSmoothing = 409;
+constexpr uint16_t kFrontendNoiseOddSmoothing = 983;
+constexpr uint16_t kFrontendNoiseMinSignalRemaining = 819;
+constexpr int32_t kFrontendPcanSnrShift = 6;
+constexpr int kFrontendPcanGainLutSize = 125;
+
+// The filterbank arrays have one more channel than there are features, the
+// extra one only bounds the last feature's frequencies.
+extern const int16_t g_frontend_window_coefficients[kFrontendWindowSize];
+extern const int16_t g_frontend_channel_frequency_starts[kFrontendFilterbankChannelCount];
+extern const int16_t g_frontend_channel_weight_starts[kFrontendFilterbankChannelCount];
+extern const int16_t g_frontend_channel_widths[kFrontendFilterbankChannelCount];
+extern const int16_t g_frontend_filterbank_weights[kFrontendFilterbankWeightCount];
+extern const int16_t g_frontend_filterbank_unweights[kFrontendFilterbankWeightCount];
+extern const int16_t g_frontend_pcan_gain_lut[kFrontendPcanGainLutSize];
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_TABLES_H_
@@ -0,0 +1,145 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "frontend_tables_check.h"
+
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "frontend_tables.h"
+#include "micro_features_generator.h"
+#include "micro_model_settings.h"
+
+namespace {
+
+// Returns the first index where `count` entries of `expected` and `actual`
+// differ, or -1 if they're all equal.
+int FindMismatch(const int16_t* expected, const int16_t* actual, int count) {
+  for (int i = 0; i < count; ++i) {
+    if (expected[i] != actual[i]) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+bool CheckTable(tflite::ErrorReporter* error_reporter, const char* name,
+                const int16_t* expected, const int16_t* actual, int count) {
+  const int mismatch = FindMismatch(expected, actual, count);
+  if (mismatch < 0) {
+    return true;
+  }
+  TF_LITE_REPORT_ERROR(error_reporter, "%s[%d] is %d, the library has %d",
+                       name, mismatch, expected[mismatch], actual[mismatch]);
+  return false;
+}
+
+bool CompareTables(tflite::ErrorReporter* error_reporter,
+                   const FrontendState& state) {
+  const FilterbankState& filterbank = state.filterbank;
+  if (state.window.size != kFrontendWindowSize ||
+      state.window.step != kFrontendWindowStep ||
+      state.fft.fft_size != kFrontendFftSize ||
+      filterbank.start_index != kFrontendFilterbankStartIndex ||
+      filterbank.end_index != kFrontendFilterbankEndIndex ||
+      state.noise_reduction.even_smoothing != kFrontendNoiseEvenSmoothing ||
+      state.noise_reduction.odd_smoothing != kFrontendNoiseOddSmoothing ||
+      state.noise_reduction.min_signal_remaining !=
+          kFrontendNoiseMinSignalRemaining ||
+      state.pcan_gain_control.snr_shift != kFrontendPcanSnrShift) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Frontend table settings differ");
+    return false;
+  }
+  bool tables_match =
+      CheckTable(error_reporter, "g_frontend_window_coefficients",
+                 g_frontend_window_coefficients, state.window.coefficients,
+                 kFrontendWindowSize) &&
+      CheckTable(error_reporter, "g_frontend_channel_frequency_starts",
+                 g_frontend_channel_frequency_starts,
+                 filterbank.channel_frequency_starts,
+                 kFrontendFilterbankChannelCount) &&
+      CheckTable(error_reporter, "g_frontend_channel_weight_starts",
+                 g_frontend_channel_weight_starts,
+                 filterbank.channel_weight_starts,
+                 kFrontendFilterbankChannelCount) &&
+      CheckTable(error_reporter, "g_frontend_channel_widths",
+                 g_frontend_channel_widths, filterbank.channel_widths,
+                 kFrontendFilterbankChannelCount) &&
+      CheckTable(error_reporter, "g_frontend_filterbank_weights",
+                 g_frontend_filterbank_weights, filterbank.weights,
+                 kFrontendFilterbankWeightCount) &&
+      CheckTable(error_reporter, "g_frontend_filterbank_unweights",
+                 g_frontend_filterbank_unweights, filterbank.unweights,
+                 kFrontendFilterbankWeightCount);
+  // The library leaves every fourth gain entry from index 5 on uninitialized,
+  // nothing reads those.
+  for (int i = 0; tables_match && i < kFrontendPcanGainLutSize; ++i) {
+    if (i >= 5 && (i % 4) == 1) {
+      continue;
+    }
+    tables_match = CheckTable(error_reporter, "g_frontend_pcan_gain_lut",
+                              g_frontend_pcan_gain_lut + i,
+                              state.pcan_gain_control.gain_lut + i, 1);
+  }
+  return tables_match;
+}
+
+}  // namespace
+
+TfLiteStatus CheckFrontendTables(tflite::ErrorReporter* error_reporter) {
+  FrontendConfig config;
+  MicroFrontend::FillModelConfig(&config);
+  FrontendState state;
+  const uint32_t heap_before = esp_get_free_heap_size();
+  const int64_t populate_start = esp_timer_get_time();
+  if (!FrontendPopulateState(&config, &state, kAudioSampleFrequency)) {
+    TF_LITE_REPORT_ERROR(error_reporter, "FrontendPopulateState() failed");
+    return kTfLiteError;
+  }
+  const int64_t populate_end = esp_timer_get_time();
+  const uint32_t populate_heap = heap_before - esp_get_free_heap_size();
+  const bool tables_match = CompareTables(error_reporter, state);
+  FrontendFreeStateContents(&state);
+
+  static MicroFrontendWorkspace workspace;
+  static MicroFrontend frontend;
+  const uint32_t heap_before_static = esp_get_free_heap_size();
+  const int64_t static_start = esp_timer_get_time();
+  TfLiteStatus init_status =
+      frontend.InitializeForModel(error_reporter, &workspace);
+  const int64_t static_end = esp_timer_get_time();
+  const uint32_t static_heap =
+      heap_before_static - esp_get_free_heap_size();
+  if (init_status != kTfLiteOk) {
+    return init_status;
+  }
+
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "Frontend setup from config: %d us, %d bytes of heap",
+                       static_cast<int>(populate_end - populate_start),
+                       static_cast<int>(populate_heap));
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "Frontend setup from tables: %d us, %d bytes of heap, "
+                       "%d bytes of workspace",
+                       static_cast<int>(static_end - static_start),
+                       static_cast<int>(static_heap),
+                       static_cast<int>(sizeof(workspace)));
+  if (!tables_match) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "frontend_tables.cpp doesn't match the library, "
+                         "rerun tools/generate_frontend_tables.cpp");
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
@@ -0,0 +1,184 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "inference_governor.h"
+
+#include "esp_log.h"
+
+namespace {
+
+const char* TAG = "GOVERNOR";
+
+constexpr uint32_t kStrideUs = kFeatureSliceStrideMs * 1000;
+
+// Period of the telemetry logged by LogTelemetry().
+constexpr int32_t kGovernorStatsIntervalMs = 10000;
+
+// A window this far behind the audio clock has a fresher one right behind it.
+constexpr int32_t kMaxLagMs = kFeatureSliceStrideMs;
+// But the model runs on one of every few windows however late they are.
+constexpr int kMaxConsecutiveLateSkips = 2;
+
+// Silence dominates when it's the top score with at least this much, which is
+// a probability of 0.75 at the output scale of 1/256 from -128.
+constexpr int8_t kQuietSilenceScore = 64;
+// A score counts as rising when it gained this much, about 5%, since the
+// previous inference.
+constexpr int kRisingScoreStep = 13;
+// Quiet inferences in a row before the interval doubles.
+constexpr int kQuietInferencesToBackOff = 5;
+
+// The stage times can stretch the interval up to this, a bit under a third
+// of the window, before the recognizer's averaging stops making sense.
+constexpr int kMaxLoadIntervalSlices = 16;
+
+}  // namespace
+
+InferenceGovernor::InferenceGovernor(bool overlapped_features)
+    : overlapped_features_(overlapped_features),
+      slices_since_inference_(0),
+      last_feature_us_(0),
+      score_interval_slices_(1),
+      load_interval_slices_(1),
+      average_busy_us_(0),
+      quiet_inferences_(0),
+      consecutive_late_skips_(0),
+      previous_scores_(),
+      last_log_time_(0) {
+  telemetry_.interval_slices.Set(1);
+}
+
+bool InferenceGovernor::ShouldInfer(int32_t window_time_ms, int new_slices,
+                                    uint32_t feature_us,
+                                    int32_t audio_time_ms) {
+  telemetry_.windows.Add(1);
+  slices_since_inference_ += new_slices;
+  if (slices_since_inference_ > kFeatureSliceCount) {
+    slices_since_inference_ = kFeatureSliceCount;
+  }
+  last_feature_us_ = feature_us;
+  telemetry_.peak_feature_us.Max(feature_us);
+  const int32_t lag_ms = audio_time_ms - window_time_ms;
+  if (lag_ms > 0) {
+    telemetry_.peak_lag_ms.Max(lag_ms);
+  }
+
+  if (slices_since_inference_ < score_interval_slices_) {
+    telemetry_.idle_skips.Add(1);
+    return false;
+  }
+  if (slices_since_inference_ < load_interval_slices_) {
+    telemetry_.load_skips.Add(1);
+    return false;
+  }
+  if (lag_ms > kMaxLagMs &&
+      consecutive_late_skips_ < kMaxConsecutiveLateSkips) {
+    ++consecutive_late_skips_;
+    telemetry_.late_skips.Add(1);
+    ESP_LOGD(TAG, "Skipped the window at %d ms, %d ms behind",
+             window_time_ms, lag_ms);
+    return false;
+  }
+  consecutive_late_skips_ = 0;
+  return true;
+}
+
+void InferenceGovernor::RecordInference(uint32_t invoke_us,
+                                        uint32_t respond_us,
+                                        const int8_t* scores) {
+  telemetry_.inferences.Add(1);
+  telemetry_.peak_invoke_us.Max(invoke_us);
+  telemetry_.peak_respond_us.Max(respond_us);
+
+  // Everything the model's core did for this window has to fit into the
+  // audio that arrived since the previous inference.
+  uint32_t busy_us = invoke_us + respond_us;
+  if (!overlapped_features_) {
+    busy_us += last_feature_us_;
+  }
+  if (busy_us > slices_since_inference_ * kStrideUs) {
+    telemetry_.deadline_misses.Add(1);
+  }
+  average_busy_us_ = (average_busy_us_ * 3 + busy_us) / 4;
+  load_interval_slices_ = (average_busy_us_ + kStrideUs - 1) / kStrideUs;
+  if (load_interval_slices_ < 1) {
+    load_interval_slices_ = 1;
+  } else if (load_interval_slices_ > kMaxLoadIntervalSlices) {
+    load_interval_slices_ = kMaxLoadIntervalSlices;
+  }
+
+  AdaptToScores(scores);
+  slices_since_inference_ = 0;
+  const int interval = (score_interval_slices_ > load_interval_slices_)
+                           ? score_interval_slices_
+                           : load_interval_slices_;
+  telemetry_.interval_slices.Set(interval);
+}
+
+void InferenceGovernor::AdaptToScores(const int8_t* scores) {
+  int top_index = 0;
+  bool is_rising = false;
+  for (int i = 0; i < kCategoryCount; ++i) {
+    if (scores[i] > scores[top_index]) {
+      top_index = i;
+    }
+    if (i != kSilenceIndex &&
+        scores[i] >= previous_scores_[i] + kRisingScoreStep) {
+      is_rising = true;
+    }
+    previous_scores_[i] = scores[i];
+  }
+  const bool is_quiet = (top_index == kSilenceIndex) &&
+                        (scores[kSilenceIndex] >= kQuietSilenceScore);
+  if (is_rising || !is_quiet) {
+    score_interval_slices_ = 1;
+    quiet_inferences_ = 0;
+    return;
+  }
+  ++quiet_inferences_;
+  if (quiet_inferences_ >= kQuietInferencesToBackOff &&
+      score_interval_slices_ < kMaxIntervalSlices) {
+    score_interval_slices_ *= 2;
+    quiet_inferences_ = 0;
+  }
+}
+
+void InferenceGovernor::LogTelemetry(int32_t audio_time_ms) {
+  if (audio_time_ms - last_log_time_ < kGovernorStatsIntervalMs) {
+    return;
+  }
+  last_log_time_ = audio_time_ms;
+  ESP_LOGI(TAG,
+           "%u windows: %u inferred, %u idle, %u overloaded, %u late, %u "
+           "gated, %u missed deadlines, every %u slices",
+           static_cast<unsigned>(telemetry_.windows.value()),
+           static_cast<unsigned>(telemetry_.inferences.value()),
+           static_cast<unsigned>(telemetry_.idle_skips.value()),
+           static_cast<unsigned>(telemetry_.load_skips.value()),
+           static_cast<unsigned>(telemetry_.late_skips.value()),
+           static_cast<unsigned>(telemetry_.gate_skips.value()),
+           static_cast<unsigned>(telemetry_.deadline_misses.value()),
+           static_cast<unsigned>(telemetry_.interval_slices.value()));
+  ESP_LOGI(TAG,
+           "Peaks: features %u us, invoke %u us, respond %u us, %u ms behind",
+           static_cast<unsigned>(telemetry_.peak_feature_us.value()),
+           static_cast<unsigned>(telemetry_.peak_invoke_us.value()),
+           static_cast<unsigned>(telemetry_.peak_respond_us.value()),
+           static_cast<unsigned>(telemetry_.peak_lag_ms.value()));
+  telemetry_.peak_feature_us.Reset();
+  telemetry_.peak_invoke_us.Reset();
+  telemetry_.peak_respond_us.Reset();
+  telemetry_.peak_lag_ms.Reset();
+}
@@ -0,0 +1,116 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_INFERENCE_GOVERNOR_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_INFERENCE_GOVERNOR_H_
+
+#include <cstdint>
+
+#include "micro_model_settings.h"
+#include "ring_stats.h"
+
+// What the governor decided and measured. Like RingStats, only the task that
+// runs the model updates it but any task may read it.
+struct GovernorTelemetry {
+  // Windows offered to ShouldInfer(), and how many of them the model ran on.
+  RelaxedCounter windows;
+  RelaxedCounter inferences;
+  // Windows skipped while only silence was heard.
+  RelaxedCounter idle_skips;
+  // Windows skipped because the stages couldn't keep up with every one.
+  RelaxedCounter load_skips;
+  // Windows skipped because they were already stale, to catch up.
+  RelaxedCounter late_skips;
+  // Windows ShouldInfer() accepted that the gate of a cascade then kept from
+  // the model.
+  RelaxedCounter gate_skips;
+  // Inferences whose stages took longer than the audio they covered.
+  RelaxedCounter deadline_misses;
+  // Slices between inferences the governor currently asks for.
+  RelaxedCounter interval_slices;
+  // Highest stage times and lag behind the audio clock since the last
+  // LogTelemetry().
+  RelaxedCounter peak_feature_us;
+  RelaxedCounter peak_invoke_us;
+  RelaxedCounter peak_respond_us;
+  RelaxedCounter peak_lag_ms;
+};
+
+// Keeps inference in step with the audio clock. For every window of features
+// it decides whether the model runs on it:
+// - Every slice while anything but silence is heard, or a score is rising.
+// - Backing off to every kMaxIntervalSlices slices while silence dominates.
+// - Never more often than the measured stage times fit into the audio that
+//   arrives in between, so load spikes from the LEDs or the serial port
+//   stretch the interval instead of piling up.
+// - Skipping windows that are already more than a stride behind the audio
+//   when they get here, since a fresher one is about to be ready.
+// Skipped windows still count, the next inference gets told about all the
+// slices that changed since the previous one.
+class InferenceGovernor {
+ public:
+  // Longest interval while it's quiet, which still gives the recognizer
+  // plenty of results within its averaging window.
+  static constexpr int kMaxIntervalSlices = 4;
+
+  // `overlapped_features` is whether features are generated on another core
+  // than the model runs on, so their time doesn't count against its budget.
+  explicit InferenceGovernor(bool overlapped_features);
+
+  // Offers the window with the spectrogram as of `window_time_ms`, which
+  // brought `new_slices` slices and took `feature_us` to generate, when the
+  // audio clock is at `audio_time_ms`. Returns whether to run the model.
+  bool ShouldInfer(int32_t window_time_ms, int new_slices, uint32_t feature_us,
+                   int32_t audio_time_ms);
+
+  // Slices that changed since the last window the model ran on, for the one
+  // ShouldInfer() just accepted.
+  int new_slices() const { return slices_since_inference_; }
+
+  // Reports the time the model and acting on its `scores` took, for the
+  // window ShouldInfer() accepted.
+  void RecordInference(uint32_t invoke_us, uint32_t respond_us,
+                       const int8_t* scores);
+
+  // Reports that the window ShouldInfer() accepted didn't get past the first
+  // stage of a cascade. Its slices count toward the next inference.
+  void RecordGateSkip() { telemetry_.gate_skips.Add(1); }
+
+  // Logs the telemetry and starts new peaks, once per stats interval of
+  // `audio_time_ms`.
+  void LogTelemetry(int32_t audio_time_ms);
+
+  const GovernorTelemetry& telemetry() const { return telemetry_; }
+
+ private:
+  // Moves the interval according to the latest scores.
+  void AdaptToScores(const int8_t* scores);
+
+  bool overlapped_features_;
+  int slices_since_inference_;
+  uint32_t last_feature_us_;
+  // Interval asked for by the scores, and the one the stage times allow.
+  int score_interval_slices_;
+  int load_interval_slices_;
+  // Smoothed time the stages take per inference.
+  uint32_t average_busy_us_;
+  int quiet_inferences_;
+  int consecutive_late_skips_;
+  int8_t previous_scores_[kCategoryCount];
+  int32_t last_log_time_;
+  GovernorTelemetry telemetry_;
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_INFERENCE_GOVERNOR_H_
@@ -0,0 +1,184 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "kernel_backend_check.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include "micro_model_settings.h"
+#include "no_micro_features_data.h"
+#include "op_profiler.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "xtensa/hal.h"
+#include "yes_micro_features_data.h"
+
+namespace {
+
+// Room for either backend's scratch buffers on top of the tensors, whatever
+// the production arena is sized for.
+constexpr size_t kCheckArenaSize = 32 * 1024;
+
+// Static, they're too big for the stack.
+OpProfiler g_reference_profiler;
+OpProfiler g_candidate_profiler;
+
+// Kinds of input the invokes take turns with. Beyond the recorded samples,
+// random features reach accumulator values the words never do, and features
+// at the ends of the int8 range make the kernels saturate.
+enum InputKind {
+  kYesInput,
+  kNoInput,
+  kRandomInput,
+  kSaturatingInput,
+  kInputKindCount,
+};
+
+// Fills `input` with the spectrogram for invoke `index`.
+void FillInput(int index, int8_t* input) {
+  const int kind = index % kInputKindCount;
+  if (kind == kYesInput || kind == kNoInput) {
+    const signed char* sample = (kind == kYesInput)
+                                    ? g_yes_micro_f2e59fea_nohash_1_data
+                                    : g_no_micro_f9643d42_nohash_4_data;
+    memcpy(input, sample, kFeatureElementCount);
+    return;
+  }
+  // A different pseudo-random spectrogram for every invoke.
+  uint32_t state = static_cast<uint32_t>(index) * 2654435761u;
+  for (int i = 0; i < kFeatureElementCount; ++i) {
+    state = state * 1664525u + 1013904223u;
+    const int8_t value = static_cast<int8_t>(state >> 24);
+    if (kind == kRandomInput) {
+      input[i] = value;
+    } else {
+      input[i] = (value < 0) ? INT8_MIN : INT8_MAX;
+    }
+  }
+}
+
+}  // namespace
+
+TfLiteStatus CompareKernelBackends(tflite::ErrorReporter* error_reporter,
+                                   const tflite::Model* model,
+                                   const tflite::MicroOpResolver& reference,
+                                   const tflite::MicroOpResolver& candidate,
+                                   int invoke_count) {
+  uint8_t* arenas = static_cast<uint8_t*>(malloc(2 * kCheckArenaSize));
+  if (arenas == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Couldn't allocate %d bytes for the check arenas",
+                         static_cast<int>(2 * kCheckArenaSize));
+    return kTfLiteError;
+  }
+  g_reference_profiler.Reset();
+  g_candidate_profiler.Reset();
+  TfLiteStatus status = kTfLiteOk;
+  {
+    tflite::MicroInterpreter reference_interpreter(
+        model, reference, arenas, kCheckArenaSize, error_reporter,
+        &g_reference_profiler);
+    tflite::MicroInterpreter candidate_interpreter(
+        model, candidate, arenas + kCheckArenaSize, kCheckArenaSize,
+        error_reporter, &g_candidate_profiler);
+    if (reference_interpreter.AllocateTensors() != kTfLiteOk ||
+        candidate_interpreter.AllocateTensors() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+      status = kTfLiteError;
+    }
+
+    // The logits are in the input tensor of the softmax, which is still
+    // intact after Invoke() since nothing runs after it.
+    const tflite::SubGraph* subgraph = model->subgraphs()->Get(0);
+    const tflite::Operator* last_op =
+        subgraph->operators()->Get(subgraph->operators()->size() - 1);
+    const int logits_index = last_op->inputs()->Get(0);
+    // tensor() allocates a new TfLiteTensor in the arena on every call, so
+    // it's only called once.
+    const TfLiteTensor* reference_logits = nullptr;
+    const TfLiteTensor* candidate_logits = nullptr;
+    if (status == kTfLiteOk) {
+      reference_logits = reference_interpreter.tensor(logits_index);
+      candidate_logits = candidate_interpreter.tensor(logits_index);
+      if (reference_logits == nullptr || candidate_logits == nullptr) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Can't get the logits tensor");
+        status = kTfLiteError;
+      }
+    }
+
+    uint32_t reference_cycles = 0;
+    uint32_t candidate_cycles = 0;
+    int differing_invokes = 0;
+    for (int i = 0; status == kTfLiteOk && i < invoke_count; ++i) {
+      int8_t* reference_input = reference_interpreter.input(0)->data.int8;
+      FillInput(i, reference_input);
+      memcpy(candidate_interpreter.input(0)->data.int8, reference_input,
+             kFeatureElementCount);
+
+      uint32_t start = xthal_get_ccount();
+      if (reference_interpreter.Invoke() != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Reference Invoke() failed");
+        status = kTfLiteError;
+        break;
+      }
+      reference_cycles += xthal_get_ccount() - start;
+      start = xthal_get_ccount();
+      if (candidate_interpreter.Invoke() != kTfLiteOk) {
+        TF_LITE_REPORT_ERROR(error_reporter, "Candidate Invoke() failed");
+        status = kTfLiteError;
+        break;
+      }
+      candidate_cycles += xthal_get_ccount() - start;
+
+      const int8_t* expected = reference_logits->data.int8;
+      const int8_t* logits = candidate_logits->data.int8;
+      if (memcmp(logits, expected, kCategoryCount) != 0 ||
+          memcmp(candidate_interpreter.output(0)->data.int8,
+                 reference_interpreter.output(0)->data.int8,
+                 kCategoryCount) != 0) {
+        if (differing_invokes == 0) {
+          TF_LITE_REPORT_ERROR(error_reporter,
+                               "Invoke %d: candidate logits %d %d %d %d, "
+                               "reference %d %d %d %d",
+                               i, logits[0], logits[1], logits[2], logits[3],
+                               expected[0], expected[1], expected[2],
+                               expected[3]);
+        }
+        ++differing_invokes;
+      }
+    }
+
+    if (status == kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Invoke: reference %d cycles, candidate %d "
+                           "cycles, %d of %d invokes differ",
+                           static_cast<int>(reference_cycles / invoke_count),
+                           static_cast<int>(candidate_cycles / invoke_count),
+                           differing_invokes, invoke_count);
+      TF_LITE_REPORT_ERROR(error_reporter, "Reference kernels:");
+      g_reference_profiler.ReportCsv(error_reporter);
+      TF_LITE_REPORT_ERROR(error_reporter, "Candidate kernels:");
+      g_candidate_profiler.ReportCsv(error_reporter);
+      if (differing_invokes > 0) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "The kernel backends don't match");
+        status = kTfLiteError;
+      }
+    }
+  }
+  free(arenas);
+  return status;
+}
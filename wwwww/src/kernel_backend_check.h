@@ -0,0 +1,36 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_KERNEL_BACKEND_CHECK_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_KERNEL_BACKEND_CHECK_H_
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+// Builds an interpreter for `model` with the kernels of `reference` and one
+// with those of `candidate`, and invokes both `invoke_count` times on the
+// recorded "yes" and "no" spectrograms, random ones and ones at the ends of
+// the int8 range, in turn. Fails unless the logits and the scores of both are
+// identical every time. Reports the cycles per Invoke()
+// of each, and the CSV of an OpProfiler for each, to compare op by op.
+TfLiteStatus CompareKernelBackends(tflite::ErrorReporter* error_reporter,
+                                   const tflite::Model* model,
+                                   const tflite::MicroOpResolver& reference,
+                                   const tflite::MicroOpResolver& candidate,
+                                   int invoke_count);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_KERNEL_BACKEND_CHECK_H_
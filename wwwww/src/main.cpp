@@ -16,12 +16,29 @@ limitations under the License.
 // 這是 TensorFlow Lite Micro 的 micro_speech 範例主程式
 // 你可以將它作為你的語音辨識專案起點
 
+#include <cstring>
+
+#include "arena_report.h"
 #include "audio_provider.h"
+#include "cascade_check.h"
 #include "command_responder.h"
+#include "esp_nn_kernels.h"
+#include "esp_timer.h"
+#include "feature_pipeline.h"
 #include "feature_provider.h"
+#include "fft_benchmark.h"
+#include "frontend_tables_check.h"
+#include "inference_governor.h"
+#include "kernel_backend_check.h"
 #include "micro_model_settings.h"
 #include "model.h"
+#include "model_loader.h"
+#include "op_profiler.h"
 #include "recognize_commands.h"
+#include "specialized_kernels.h"
+#include "speech_gate.h"
+#include "streaming_model.h"
+#include "streaming_model_check.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 #include "tensorflow/lite/micro/micro_interpreter.h"
 #include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
@@ -32,19 +49,88 @@ limitations under the License.
 namespace {
 tflite::ErrorReporter* error_reporter = nullptr;
 const tflite::Model* model = nullptr;
-tflite::MicroInterpreter* interpreter = nullptr;
 TfLiteTensor* model_input = nullptr;
 FeatureProvider* feature_provider = nullptr;
 RecognizeCommands* recognizer = nullptr;
+// Decides which windows the model runs on, see setup().
+InferenceGovernor* governor = nullptr;
 int32_t previous_time = 0;
+#ifdef MICRO_SPEECH_PIPELINED
+// Features are generated in a task of their own, see setup().
+FeaturePipeline* feature_pipeline = nullptr;
+// Core 0 runs it next to loop() on core 1. Building with
+// -DMICRO_SPEECH_FEATURE_TASK_CORE=1 keeps everything on one core, where the
+// feature task preempts the model instead.
+#ifndef MICRO_SPEECH_FEATURE_TASK_CORE
+#define MICRO_SPEECH_FEATURE_TASK_CORE 0
+#endif
+// Below the capture task, above loop().
+constexpr int kFeatureTaskPriority = 5;
+// One interpreter per input buffer of the pipeline, so the next spectrogram
+// can be written into one input tensor while the model runs on the other.
+constexpr int kInterpreterCount = FeaturePipeline::kBufferCount;
+#else
+constexpr int kInterpreterCount = 1;
+#endif
+tflite::MicroInterpreter* interpreters[kInterpreterCount] = {};
+#ifdef MICRO_SPEECH_OP_PROFILE
+// Times every op of the interpreters, or of the streaming model when it runs
+// instead, reported as CSV every OpProfiler::kMaxSamples inferences.
+OpProfiler op_profiler;
+tflite::Profiler* profiler = &op_profiler;
+#else
+tflite::Profiler* profiler = nullptr;
+#endif
+#ifdef MICRO_SPEECH_CASCADE
+// First stage of the cascade, which keeps the model from running on windows
+// with nothing but silence in them.
+SpeechGate speech_gate;
+#endif
 
 // Create an area of memory to use for input, output, and intermediate arrays.
-// The size of this will depend on the model you're using, and may need to be
-// determined by experimentation.
-constexpr int kTensorArenaSize = 10 * 1024;
-uint8_t tensor_arena[kTensorArenaSize];
+// kTensorArenaUsedBytes is what AllocateTensors() takes for g_model, worked out
+// from the model: 5968 bytes of tensors at the peak, the reshaped input next to
+// the convolution output as the greedy planner lays them out, and about 1.8 KB
+// of persistent data. A build with -DMICRO_SPEECH_ARENA_REPORT prints the
+// figure the device measures, and setup() refuses to run if an interpreter
+// uses more than the figure here. Record it again whenever the model or
+// TensorFlow Lite changes; the margin covers differences in alignment between
+// builds.
+constexpr int kTensorArenaUsedBytes = 7808;
+constexpr int kTensorArenaMarginBytes = 1024;
+#ifdef MICRO_SPEECH_TENSOR_ARENA_SIZE
+constexpr int kTensorArenaSize = MICRO_SPEECH_TENSOR_ARENA_SIZE;
+#else
+constexpr int kTensorArenaSize =
+    kTensorArenaUsedBytes + kTensorArenaMarginBytes;
+#endif
+static_assert(kTensorArenaSize >=
+                  kTensorArenaUsedBytes + kTensorArenaMarginBytes,
+              "The tensor arena is smaller than the recorded usage plus the "
+              "margin");
+#ifdef MICRO_SPEECH_STREAMING
+// The streaming model reads the spectrograms straight from plain input
+// buffers, so only one interpreter gets built, with an arena of its own, for
+// the startup checks and for models that can't be streamed.
+constexpr int kTensorArenaCount = 1;
+int8_t streaming_input_buffers[kInterpreterCount][kFeatureElementCount];
+#else
+constexpr int kTensorArenaCount = kInterpreterCount;
+#endif
+uint8_t tensor_arenas[kTensorArenaCount][kTensorArenaSize];
 int8_t feature_buffer[kFeatureElementCount];
-int8_t* model_input_buffer = nullptr;
+int8_t* model_input_buffers[kInterpreterCount] = {};
+
+#ifdef MICRO_SPEECH_STREAMING
+// Runs the model a stride at a time on the spectrograms in the input tensors,
+// instead of the interpreters, unless the model isn't one it can stream.
+StreamingModel* streaming_model = nullptr;
+// Room for the cached convolution rows and the whole convolution output.
+// Like the tensor arena it depends on the model, StreamingModel::Initialize()
+// reports the size it needs.
+constexpr int kStreamingScratchSize = 10 * 1024;
+int8_t streaming_scratch[kStreamingScratchSize];
+#endif
 }  // namespace
 
 void setup() {
@@ -77,76 +163,251 @@ void setup() {
   if (micro_op_resolver.AddFullyConnected() != kTfLiteOk) { return; }
   if (micro_op_resolver.AddReshape() != kTfLiteOk) { return; }
   if (micro_op_resolver.AddSoftmax() != kTfLiteOk) { return; }
+  const tflite::MicroOpResolver* op_resolver = &micro_op_resolver;
+#ifdef MICRO_SPEECH_ESP_NN
+  // The same ops, with DepthwiseConv2D and FullyConnected on ESP-NN.
+  static EspNnOpResolver esp_nn_op_resolver(op_resolver);
+  op_resolver = &esp_nn_op_resolver;
+#endif
+#ifdef MICRO_SPEECH_SPECIALIZED_KERNELS
+  // DepthwiseConv2D and FullyConnected compiled for the shapes of g_model,
+  // on top of whichever kernels they replace.
+  static SpecializedOpResolver specialized_op_resolver(op_resolver);
+  op_resolver = &specialized_op_resolver;
+#endif
 
-  // Build an interpreter to run the model with.
+#ifdef MICRO_SPEECH_MODEL_PARTITION
+  // A model written to its own partition takes the place of the built-in one,
+  // so models can be swapped without rebuilding. It runs straight from flash
+  // like g_model does.
+  const tflite::Model* partition_model =
+      MapPartitionModel(error_reporter, kModelPartitionLabel, *op_resolver,
+                        tensor_arenas[0], kTensorArenaSize);
+  if (partition_model != nullptr) {
+    model = partition_model;
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Using the model in the \"%s\" partition",
+                         kModelPartitionLabel);
+  } else {
+    TF_LITE_REPORT_ERROR(error_reporter, "Using the built-in model");
+  }
+#endif
+#ifdef MICRO_SPEECH_KERNEL_CHECK
+  // Make sure the kernels in use give exactly what the reference kernels do
+  // on the recorded samples, and show the cycles they save op by op.
+  if (CompareKernelBackends(error_reporter, model, micro_op_resolver,
+                            *op_resolver, kFeatureSliceCount * 4) !=
+      kTfLiteOk) {
+    return;
+  }
+#endif
+
+#ifdef MICRO_SPEECH_ARENA_REPORT
+  ReportArenaUsage(error_reporter, model, *op_resolver, kTensorArenaUsedBytes);
+#endif
+
+  // Build the interpreters to run the model with.
   static tflite::MicroInterpreter static_interpreter(
-      model, micro_op_resolver, tensor_arena, kTensorArenaSize, error_reporter);
-  interpreter = &static_interpreter;
+      model, *op_resolver, tensor_arenas[0], kTensorArenaSize,
+      error_reporter, profiler);
+  interpreters[0] = &static_interpreter;
+#if defined(MICRO_SPEECH_PIPELINED) && !defined(MICRO_SPEECH_STREAMING)
+  static_assert(kInterpreterCount == 2, "Build one interpreter per buffer");
+  static tflite::MicroInterpreter second_interpreter(
+      model, *op_resolver, tensor_arenas[1], kTensorArenaSize,
+      error_reporter, profiler);
+  interpreters[1] = &second_interpreter;
+#endif
+
+  for (int i = 0; i < kTensorArenaCount; ++i) {
+    // Allocate memory from the tensor arena for the model's tensors.
+    TfLiteStatus allocate_status = interpreters[i]->AllocateTensors();
+    if (allocate_status != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+      return;
+    }
+    const int arena_used =
+        static_cast<int>(interpreters[i]->arena_used_bytes());
+    if (arena_used > kTensorArenaUsedBytes) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Tensor arena %d uses %d bytes, more than the %d "
+                           "recorded for this model, measure it again",
+                           i, arena_used, kTensorArenaUsedBytes);
+      return;
+    }
+    TF_LITE_REPORT_ERROR(error_reporter, "Tensor arena %d uses %d of %d bytes",
+                         i, arena_used, kTensorArenaSize);
+
+    // Get information about the memory area to use for a model's input.
+    model_input = interpreters[i]->input(0);
+    if ((model_input->dims->size != 2) || (model_input->dims->data[0] != 1) ||
+        (model_input->dims->data[1] !=
+         (kFeatureSliceCount * kFeatureSliceSize)) ||
+        (model_input->type != kTfLiteInt8)) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Bad input tensor parameters in model");
+      return;
+    }
+    model_input_buffers[i] = model_input->data.int8;
+  }
+#ifdef MICRO_SPEECH_STREAMING
+  for (int i = 0; i < kInterpreterCount; ++i) {
+    model_input_buffers[i] = streaming_input_buffers[i];
+  }
+#endif
+
+#ifdef MICRO_SPEECH_FRONTEND_TABLES_CHECK
+  // Make sure the precomputed frontend tables match what the library would
+  // build at runtime, and compare the cost of both.
+  if (CheckFrontendTables(error_reporter) != kTfLiteOk) {
+    return;
+  }
+#endif
 
-  // Allocate memory from the tensor_arena for the model's tensors.
-  TfLiteStatus allocate_status = interpreter->AllocateTensors();
-  if (allocate_status != kTfLiteOk) {
-    TF_LITE_REPORT_ERROR(error_reporter, "AllocateTensors() failed");
+#ifdef MICRO_SPEECH_FFT_CHECK
+  // Make sure the FFT backend in use produces the same features as the
+  // reference one, over about two seconds of audio, and show how long each
+  // takes.
+  static DefaultFftBackend candidate_fft_backend;
+  if (CompareFftBackends(error_reporter, ReferenceFftBackend(),
+                         &candidate_fft_backend, kFeatureSliceCount * 2,
+                         /*tolerance=*/2) != kTfLiteOk) {
     return;
   }
+#endif
 
-  // Get information about the memory area to use for a model's input.
-  model_input = interpreter->input(0);
-  if ((model_input->dims->size != 2) || (model_input->dims->data[0] != 1) ||
-      (model_input->dims->data[1] !=
-       (kFeatureSliceCount * kFeatureSliceSize)) ||
-      (model_input->type != kTfLiteInt8)) {
+#ifdef MICRO_SPEECH_FRONTEND_STAGES_CHECK
+  // Make sure the optimized stages after the FFT still match the library
+  // exactly, and show the cycles each of them saves.
+  if (CompareFrontendStages(error_reporter, kFeatureSliceCount * 2) !=
+      kTfLiteOk) {
+    return;
+  }
+#endif
+
+#ifdef MICRO_SPEECH_STREAMING
+  static StreamingModel static_streaming_model(
+      streaming_scratch, kStreamingScratchSize, profiler);
+  if (static_streaming_model.Initialize(error_reporter, model) == kTfLiteOk) {
+    streaming_model = &static_streaming_model;
+  } else {
     TF_LITE_REPORT_ERROR(error_reporter,
-                         "Bad input tensor parameters in model");
+                         "Can't stream this model, running it on whole "
+                         "windows instead");
+  }
+#ifdef MICRO_SPEECH_STREAMING_CHECK
+  // Make sure streaming gives exactly what the interpreter does on whole
+  // windows, over a few seconds of spectrogram, and show the cycles it saves.
+  if (streaming_model != nullptr &&
+      CompareStreamingInference(error_reporter, model, interpreters[0],
+                                streaming_model, kFeatureSliceCount * 4) !=
+          kTfLiteOk) {
+    return;
+  }
+#endif
+#endif
+
+#ifdef MICRO_SPEECH_CASCADE_CHECK
+  // Show what the cascade saves over running the model on every window, and
+  // make sure it still recognizes every command in the recorded samples.
+  if (CompareCascadeInference(error_reporter, interpreters[0],
+                              kFeatureSliceCount * 12) != kTfLiteOk) {
     return;
   }
-  model_input_buffer = model_input->data.int8;
+#endif
+
+#ifdef MICRO_SPEECH_OP_PROFILE
+  // The checks above ran the model too, only time what loop() runs.
+  op_profiler.Reset();
+#endif
 
   // Prepare to access the audio spectrograms from a microphone or other source
   // that will provide the inputs to the neural network.
   static FeatureProvider static_feature_provider(kFeatureElementCount,
                                                  feature_buffer);
   feature_provider = &static_feature_provider;
+  // Quantize the features exactly like the input tensor expects them.
+  if (feature_provider->SetFeatureQuantization(
+          error_reporter, model_input->params.scale,
+          model_input->params.zero_point) != kTfLiteOk) {
+    return;
+  }
 
   static RecognizeCommands static_recognizer(error_reporter);
   recognizer = &static_recognizer;
 
-  previous_time = 0;
-}
-
-void loop() {
-  // Fetch the spectrogram for the current time.
-  const int32_t current_time = LatestAudioTimestamp();
-  int how_many_new_slices = 0;
-  TfLiteStatus feature_status = feature_provider->PopulateFeatureData(
-      error_reporter, previous_time, current_time, &how_many_new_slices);
-  if (feature_status != kTfLiteOk) {
-    TF_LITE_REPORT_ERROR(error_reporter, "Feature generation failed");
-    return;
-  }
-  previous_time = current_time;
-  // If no new audio samples have been received since last time, don't bother
-  // running the network model.
-  if (how_many_new_slices == 0) {
-    return;
-  }
+  // Features only stay out of the model's time budget when the feature task
+  // runs on another core than loop().
+#ifdef MICRO_SPEECH_PIPELINED
+  const bool overlapped_features =
+      MICRO_SPEECH_FEATURE_TASK_CORE != xPortGetCoreID();
+#else
+  const bool overlapped_features = false;
+#endif
+  static InferenceGovernor static_governor(overlapped_features);
+  governor = &static_governor;
 
-  // Copy feature buffer to input tensor
-  for (int i = 0; i < kFeatureElementCount; i++) {
-    model_input_buffer[i] = feature_buffer[i];
-  }
+  previous_time = 0;
 
-  // Run the model on this input and make sure it succeeds.
-  TfLiteStatus invoke_status = interpreter->Invoke();
-  if (invoke_status != kTfLiteOk) {
-    TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
+#ifdef MICRO_SPEECH_PIPELINED
+  // loop() only has to run the model on the windows the feature task writes
+  // into the interpreters' input tensors.
+  static FeaturePipeline static_feature_pipeline(feature_provider,
+                                                 model_input_buffers);
+  feature_pipeline = &static_feature_pipeline;
+  if (feature_pipeline->Start(error_reporter, MICRO_SPEECH_FEATURE_TASK_CORE,
+                              kFeatureTaskPriority) != kTfLiteOk) {
     return;
   }
+#endif
+}
 
+// Runs the model on the spectrogram in input buffer `buffer_index`, whose last
+// `new_slices` slices are new, and acts on whatever command that shows.
+void RunInference(int buffer_index, int new_slices, int32_t current_time) {
   // The output from the model is a vector of probabilities for the various
   // classes, that is, how likely it is that the audio just heard was a
   // 'yes', 'no', or 'unknown'.
-  TfLiteTensor* output = interpreter->output(0);
+  const TfLiteTensor* output = nullptr;
+  const int64_t invoke_start = esp_timer_get_time();
+#ifdef MICRO_SPEECH_STREAMING
+  if (streaming_model != nullptr) {
+    // Only the parts of the model that see the new slices get computed.
+    if (streaming_model->Invoke(model_input_buffers[buffer_index],
+                                new_slices) != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Streaming Invoke failed");
+      return;
+    }
+    output = streaming_model->output();
+  }
+#else
+  // Whole windows don't care which slices are new.
+  (void)new_slices;
+#endif
+  if (output == nullptr) {
+    // Run the model on this input and make sure it succeeds.
+#ifdef MICRO_SPEECH_STREAMING
+    // The one interpreter there is has an input tensor of its own.
+    tflite::MicroInterpreter* interpreter = interpreters[0];
+    memcpy(interpreter->input(0)->data.int8, model_input_buffers[buffer_index],
+           kFeatureElementCount);
+#else
+    tflite::MicroInterpreter* interpreter = interpreters[buffer_index];
+#endif
+    TfLiteStatus invoke_status = interpreter->Invoke();
+    if (invoke_status != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke failed");
+      return;
+    }
+    output = interpreter->output(0);
+  }
+#ifdef MICRO_SPEECH_OP_PROFILE
+  if (op_profiler.invocations() >= OpProfiler::kMaxSamples) {
+    op_profiler.ReportCsv(error_reporter);
+    op_profiler.Reset();
+  }
+#endif
+  const int64_t respond_start = esp_timer_get_time();
   // Determine whether a command was recognized based on the output of inference
   const char* found_command = nullptr;
   uint8_t score = 0;
@@ -163,4 +424,98 @@ void loop() {
   // here
   RespondToCommand(error_reporter, current_time, found_command, score,
                    is_new_command);
-}
\ No newline at end of file
+  // The LEDs and the serial port can take a while, so they count too.
+  const int64_t respond_end = esp_timer_get_time();
+  governor->RecordInference(
+      static_cast<uint32_t>(respond_start - invoke_start),
+      static_cast<uint32_t>(respond_end - respond_start),
+      output->data.int8);
+}
+
+// Shows the window with the spectrogram `features`, whose last `new_slices`
+// slices are new, to the first stage of the cascade. Returns whether the model
+// is worth running on it, which is always without one.
+bool PassesGate(const int8_t* features, int new_slices) {
+#ifdef MICRO_SPEECH_CASCADE
+  return speech_gate.Update(features, new_slices);
+#else
+  (void)features;
+  (void)new_slices;
+  return true;
+#endif
+}
+
+#ifdef MICRO_SPEECH_PIPELINED
+
+void loop() {
+  // Sleep until the feature task publishes a new spectrogram.
+  const FeatureWindow* window =
+      feature_pipeline->WaitForWindow(kFeatureSliceStrideMs * 5);
+  if (window == nullptr) {
+    return;
+  }
+  const int32_t window_time = window->time_ms;
+  // The gate sees every window, the governor only decides which ones the
+  // model would otherwise run on.
+  const bool is_gate_open = PassesGate(window->features, window->new_slices);
+  if (governor->ShouldInfer(window_time, window->new_slices,
+                            window->feature_us, LatestAudioTimestamp())) {
+    if (is_gate_open) {
+      // The window is already in the input tensor of the interpreter it
+      // belongs to, and the feature task fills the other one in the meantime.
+      RunInference(window->buffer_index, governor->new_slices(), window_time);
+    } else {
+      governor->RecordGateSkip();
+    }
+  }
+  feature_pipeline->ReleaseWindow();
+  governor->LogTelemetry(window_time);
+}
+
+#else  // MICRO_SPEECH_PIPELINED
+
+void loop() {
+  // Sleep until the next stride of audio has been captured, instead of spinning
+  // on the timestamp until it moves.
+  WaitForAudioTimestamp(
+      ((previous_time / kFeatureSliceStrideMs) + 1) * kFeatureSliceStrideMs,
+      kFeatureSliceStrideMs * 5);
+
+  // Fetch the spectrogram for the current time.
+  const int32_t current_time = LatestAudioTimestamp();
+  int how_many_new_slices = 0;
+  const int64_t feature_start = esp_timer_get_time();
+  TfLiteStatus feature_status = feature_provider->PopulateFeatureData(
+      error_reporter, previous_time, current_time, &how_many_new_slices);
+  if (feature_status != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Feature generation failed");
+    return;
+  }
+  const uint32_t feature_us =
+      static_cast<uint32_t>(esp_timer_get_time() - feature_start);
+  previous_time = current_time;
+  // If no new audio samples have been received since last time, don't bother
+  // running the network model.
+  if (how_many_new_slices == 0) {
+    return;
+  }
+  governor->LogTelemetry(current_time);
+
+  // The features are already quantized for the model, they only need putting
+  // back in time order. That copies the whole spectrogram for every window,
+  // since the gate looks at all of them.
+  feature_provider->CopyFeatureData(model_input_buffers[0]);
+  const bool is_gate_open =
+      PassesGate(model_input_buffers[0], how_many_new_slices);
+  if (!governor->ShouldInfer(current_time, how_many_new_slices, feature_us,
+                             LatestAudioTimestamp())) {
+    return;
+  }
+  if (!is_gate_open) {
+    governor->RecordGateSkip();
+    return;
+  }
+  RunInference(0, governor->new_slices(), current_time);
+}
+
+#endif  // MICRO_SPEECH_PIPELINED
\ No newline at end of file
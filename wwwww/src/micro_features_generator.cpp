@@ -18,98 +18,356 @@ limitations under the License.
 #include <cmath>
 #include <cstring>
 
-#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
-#include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
+#include "frontend_stages.h"
+#include "frontend_tables.h"
 #include "micro_model_settings.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/kiss_fft_int16.h"
 
-// Configure FFT to output 16 bit fixed point.
-#define FIXED_POINT 16
+static_assert(kFrontendWindowSize == ModelPipelineConfig::kWindowSamples,
+              "frontend_tables.cpp is out of date, rerun "
+              "tools/generate_frontend_tables.cpp");
+static_assert(kFrontendWindowStep == ModelPipelineConfig::kStrideSamples,
+              "frontend_tables.cpp is out of date, rerun "
+              "tools/generate_frontend_tables.cpp");
+static_assert(kFrontendFftSize == ModelPipelineConfig::kFftSize,
+              "frontend_tables.cpp is out of date, rerun "
+              "tools/generate_frontend_tables.cpp");
+static_assert(kFrontendFilterbankChannelCount ==
+                  ModelPipelineConfig::kSliceSize + 1,
+              "frontend_tables.cpp is out of date, rerun "
+              "tools/generate_frontend_tables.cpp");
 
 namespace {
 
-FrontendState g_micro_features_state;
-bool g_is_first_time = true;
+// Quantization of the bundled model's input tensor, which maps the 0.0 to 26.0
+// float feature range onto -128 to 127. Used until the caller hands over the
+// parameters of the tensor it actually feeds.
+constexpr float kDefaultInputScale = 26.0f / 256.0f;
+constexpr int32_t kDefaultInputZeroPoint = -128;
+
+// The frontend's output values are 16 bits wide.
+constexpr uint32_t kMaxFrontendOutput = UINT16_MAX;
 
 }  // namespace
 
-TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter) {
-  FrontendConfig config;
-  config.window.size_ms = kFeatureSliceDurationMs;
-  config.window.step_size_ms = kFeatureSliceStrideMs;
-  config.noise_reduction.smoothing_bits = 10;
-  config.filterbank.num_channels = kFeatureSliceSize;
-  config.filterbank.lower_band_limit = 125.0;
-  config.filterbank.upper_band_limit = 7500.0;
-  config.noise_reduction.smoothing_bits = 10;
-  config.noise_reduction.even_smoothing = 0.025;
-  config.noise_reduction.odd_smoothing = 0.06;
-  config.noise_reduction.min_signal_remaining = 0.05;
-  config.pcan_gain_control.enable_pcan = 1;
-  config.pcan_gain_control.strength = 0.95;
-  config.pcan_gain_control.offset = 80.0;
-  config.pcan_gain_control.gain_bits = 21;
-  config.log_scale.enable_log = 1;
-  config.log_scale.scale_shift = 6;
-  if (!FrontendPopulateState(&config, &g_micro_features_state,
-                             kAudioSampleFrequency)) {
+// Quantizes one frontend output value the way the tensor expects:
+// input = round((feature / kFeatureFrontendScale) / scale) + zero_point
+static int8_t QuantizeFeature(uint32_t feature, float feature_step,
+                              int32_t zero_point) {
+  int32_t value =
+      static_cast<int32_t>(std::floor(feature * feature_step + 0.5f)) +
+      zero_point;
+  if (value < -128) {
+    value = -128;
+  }
+  if (value > 127) {
+    value = 127;
+  }
+  return value;
+}
+
+MicroFrontend::MicroFrontend()
+    : state_(),
+      default_fft_backend_(),
+      fft_backend_(&default_fft_backend_),
+      is_initialized_(false),
+      owns_state_(false),
+      is_first_window_(true) {
+  BuildQuantizerTable(kDefaultInputScale, kDefaultInputZeroPoint);
+}
+
+MicroFrontend::~MicroFrontend() { ReleaseState(); }
+
+void MicroFrontend::ReleaseState() {
+  if (is_initialized_ && owns_state_) {
+    FrontendFreeStateContents(&state_);
+  }
+  is_initialized_ = false;
+  owns_state_ = false;
+}
+
+void MicroFrontend::FillModelConfig(FrontendConfig* config) {
+  config->window.size_ms = kFeatureSliceDurationMs;
+  config->window.step_size_ms = kFeatureSliceStrideMs;
+  config->filterbank.num_channels = kFeatureSliceSize;
+  config->filterbank.lower_band_limit = kFilterbankLowerBandLimit;
+  config->filterbank.upper_band_limit = kFilterbankUpperBandLimit;
+  config->noise_reduction.smoothing_bits = kNoiseReductionSmoothingBits;
+  config->noise_reduction.even_smoothing = kNoiseReductionEvenSmoothing;
+  config->noise_reduction.odd_smoothing = kNoiseReductionOddSmoothing;
+  config->noise_reduction.min_signal_remaining =
+      kNoiseReductionMinSignalRemaining;
+  config->pcan_gain_control.enable_pcan = kPcanGainControlEnable;
+  config->pcan_gain_control.strength = kPcanGainControlStrength;
+  config->pcan_gain_control.offset = kPcanGainControlOffset;
+  config->pcan_gain_control.gain_bits = kPcanGainControlGainBits;
+  config->log_scale.enable_log = kLogScaleEnable;
+  config->log_scale.scale_shift = kLogScaleShift;
+}
+
+TfLiteStatus MicroFrontend::Initialize(tflite::ErrorReporter* error_reporter,
+                                       const FrontendConfig& config,
+                                       int sample_rate) {
+  ReleaseState();
+  if (!FrontendPopulateState(&config, &state_, sample_rate)) {
     TF_LITE_REPORT_ERROR(error_reporter, "FrontendPopulateState() failed");
     return kTfLiteError;
   }
-  g_is_first_time = true;
-  return kTfLiteOk;
+  is_initialized_ = true;
+  owns_state_ = true;
+  is_first_window_ = true;
+  InitializeFastLogScale();
+  return fft_backend_->Initialize(error_reporter, state_.fft);
+}
+
+TfLiteStatus MicroFrontend::InitializeForModel(
+    tflite::ErrorReporter* error_reporter, MicroFrontendWorkspace* workspace) {
+  ReleaseState();
+  memset(&state_, 0, sizeof(state_));
+
+  // The library only ever reads the tables, so pointing its non-const fields
+  // at the copies in flash is safe.
+  WindowState* window = &state_.window;
+  window->size = kFrontendWindowSize;
+  window->step = kFrontendWindowStep;
+  window->coefficients = const_cast<int16_t*>(g_frontend_window_coefficients);
+  window->input = workspace->window_input;
+  window->output = workspace->window_output;
+
+  FftState* fft = &state_.fft;
+  fft->fft_size = kFrontendFftSize;
+  fft->input_size = kFrontendWindowSize;
+  fft->input = workspace->fft_input;
+  fft->output = workspace->fft_output;
+  size_t scratch_size = sizeof(workspace->fft_scratch);
+  if (kissfft_fixed16::kiss_fftr_alloc(kFrontendFftSize, 0,
+                                       workspace->fft_scratch,
+                                       &scratch_size) !=
+      reinterpret_cast<void*>(workspace->fft_scratch)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "kissfft needs %d bytes of scratch space, have %d",
+                         static_cast<int>(scratch_size),
+                         static_cast<int>(sizeof(workspace->fft_scratch)));
+    return kTfLiteError;
+  }
+  fft->scratch = workspace->fft_scratch;
+  fft->scratch_size = scratch_size;
+
+  FilterbankState* filterbank = &state_.filterbank;
+  filterbank->num_channels = kFeatureSliceSize;
+  filterbank->start_index = kFrontendFilterbankStartIndex;
+  filterbank->end_index = kFrontendFilterbankEndIndex;
+  filterbank->channel_frequency_starts =
+      const_cast<int16_t*>(g_frontend_channel_frequency_starts);
+  filterbank->channel_weight_starts =
+      const_cast<int16_t*>(g_frontend_channel_weight_starts);
+  filterbank->channel_widths =
+      const_cast<int16_t*>(g_frontend_channel_widths);
+  filterbank->weights = const_cast<int16_t*>(g_frontend_filterbank_weights);
+  filterbank->unweights =
+      const_cast<int16_t*>(g_frontend_filterbank_unweights);
+  filterbank->work = workspace->filterbank_work;
+
+  NoiseReductionState* noise_reduction = &state_.noise_reduction;
+  noise_reduction->smoothing_bits = kNoiseReductionSmoothingBits;
+  noise_reduction->even_smoothing = kFrontendNoiseEvenSmoothing;
+  noise_reduction->odd_smoothing = kFrontendNoiseOddSmoothing;
+  noise_reduction->min_signal_remaining = kFrontendNoiseMinSignalRemaining;
+  noise_reduction->num_channels = kFeatureSliceSize;
+  noise_reduction->estimate = workspace->noise_estimate;
+
+  PcanGainControlState* pcan_gain_control = &state_.pcan_gain_control;
+  pcan_gain_control->enable_pcan = kPcanGainControlEnable;
+  pcan_gain_control->noise_estimate = workspace->noise_estimate;
+  pcan_gain_control->num_channels = kFeatureSliceSize;
+  pcan_gain_control->gain_lut = const_cast<int16_t*>(g_frontend_pcan_gain_lut);
+  pcan_gain_control->snr_shift = kFrontendPcanSnrShift;
+
+  state_.log_scale.enable_log = kLogScaleEnable;
+  state_.log_scale.scale_shift = kLogScaleShift;
+
+  FrontendReset(&state_);
+  is_initialized_ = true;
+  is_first_window_ = true;
+  InitializeFastLogScale();
+  return fft_backend_->Initialize(error_reporter, state_.fft);
+}
+
+TfLiteStatus MicroFrontend::SetFftBackend(
+    tflite::ErrorReporter* error_reporter, FftBackend* backend) {
+  fft_backend_ = backend;
+  if (!is_initialized_) {
+    return kTfLiteOk;
+  }
+  return fft_backend_->Initialize(error_reporter, state_.fft);
+}
+
+FrontendOutput MicroFrontend::ProcessSamples(const int16_t* samples,
+                                             size_t num_samples,
+                                             size_t* num_samples_read) {
+  FrontendOutput output;
+  output.values = nullptr;
+  output.size = 0;
+
+  // Try to apply the window - if it fails, wait for more data.
+  if (!WindowProcessSamples(&state_.window, samples, num_samples,
+                            num_samples_read)) {
+    return output;
+  }
+
+  // Scale the window up so that the fixed point FFT keeps as much resolution
+  // as possible.
+  const int input_shift =
+      15 - MostSignificantBit32(state_.window.max_abs_output_value);
+  complex_int16_t* fft_output =
+      fft_backend_->Compute(&state_.fft, state_.window.output, input_shift);
+
+  // The rest of the stages produce exactly what the library's would, see
+  // frontend_stages.h.
+  FastFilterbankAccumulate(&state_.filterbank, fft_output);
+  uint32_t* scaled_filterbank =
+      FastFilterbankSqrt(&state_.filterbank, input_shift);
+
+  FastNoiseReductionApply(&state_.noise_reduction, scaled_filterbank);
+  if (state_.pcan_gain_control.enable_pcan) {
+    FastPcanGainControlApply(&state_.pcan_gain_control, scaled_filterbank);
+  }
+
+  const int correction_bits =
+      MostSignificantBit32(state_.fft.fft_size) - 1 - (kFilterbankBits / 2);
+  output.values = FastLogScaleApply(&state_.log_scale, scaled_filterbank,
+                                    state_.filterbank.num_channels,
+                                    correction_bits);
+  output.size = state_.filterbank.num_channels;
+  return output;
 }
 
-// This is not exposed in any header, and is only used for testing, to ensure
-// that the state is correctly set up before generating results.
-void SetMicroFeaturesNoiseEstimates(const uint32_t* estimate_presets) {
-  for (int i = 0; i < g_micro_features_state.filterbank.num_channels; ++i) {
-    g_micro_features_state.noise_reduction.estimate[i] = estimate_presets[i];
+TfLiteStatus MicroFrontend::SetOutputQuantization(
+    tflite::ErrorReporter* error_reporter, float scale, int32_t zero_point) {
+  if (!(scale > 0.0f) || zero_point < -128 || zero_point > 127) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Unsupported feature quantization, scale %f zero "
+                         "point %d",
+                         scale, zero_point);
+    return kTfLiteError;
   }
+  if (!BuildQuantizerTable(scale, zero_point)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Feature quantization scale %f is too fine for a "
+                         "%d entry table",
+                         scale, kQuantizerTableSize);
+    BuildQuantizerTable(kDefaultInputScale, kDefaultInputZeroPoint);
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
 }
 
-TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
-                                   const int16_t* input, int input_size,
-                                   int output_size, int8_t* output,
-                                   size_t* num_samples_read) {
-  const int16_t* frontend_input;
-  if (g_is_first_time) {
-    frontend_input = input;
-    g_is_first_time = false;
-  } else {
-    frontend_input = input + 160;
+bool MicroFrontend::BuildQuantizerTable(float scale, int32_t zero_point) {
+  const float feature_step = 1.0f / (kFeatureFrontendScale * scale);
+  for (int i = 0; i < kQuantizerTableSize; ++i) {
+    quantizer_table_[i] = QuantizeFeature(i, feature_step, zero_point);
   }
-  FrontendOutput frontend_output = FrontendProcessSamples(
-      &g_micro_features_state, frontend_input, input_size, num_samples_read);
+  // Values past the end of the table are looked up as its last entry, which is
+  // only right if the quantized range has saturated by then.
+  return quantizer_table_[kQuantizerTableSize - 1] ==
+         QuantizeFeature(kMaxFrontendOutput, feature_step, zero_point);
+}
 
+void MicroFrontend::Quantize(const FrontendOutput& frontend_output,
+                             int8_t* output) const {
   for (size_t i = 0; i < frontend_output.size; ++i) {
-    // These scaling values are derived from those used in input_data.py in the
-    // training pipeline.
-    // The feature pipeline outputs 16-bit signed integers in roughly a 0 to 670
-    // range. In training, these are then arbitrarily divided by 25.6 to get
-    // float values in the rough range of 0.0 to 26.0. This scaling is performed
-    // for historical reasons, to match up with the output of other feature
-    // generators.
-    // The process is then further complicated when we quantize the model. This
-    // means we have to scale the 0.0 to 26.0 real values to the -128 to 127
-    // signed integer numbers.
-    // All this means that to get matching values from our integer feature
-    // output into the tensor input, we have to perform:
-    // input = (((feature / 25.6) / 26.0) * 256) - 128
-    // To simplify this and perform it in 32-bit integer math, we rearrange to:
-    // input = (feature * 256) / (25.6 * 26.0) - 128
-    constexpr int32_t value_scale = 256;
-    constexpr int32_t value_div = static_cast<int32_t>((25.6f * 26.0f) + 0.5f);
-    int32_t value =
-        ((frontend_output.values[i] * value_scale) + (value_div / 2)) /
-        value_div;
-    value -= 128;
-    if (value < -128) {
-      value = -128;
+    const uint16_t value = frontend_output.values[i];
+    output[i] = quantizer_table_[value < kQuantizerTableSize
+                                     ? value
+                                     : kQuantizerTableSize - 1];
+  }
+}
+
+int MicroFrontend::history_samples() const {
+  return state_.window.size - state_.window.step;
+}
+
+void MicroFrontend::SetNoiseEstimates(const uint32_t* estimate_presets) {
+  for (int i = 0; i < state_.filterbank.num_channels; ++i) {
+    state_.noise_reduction.estimate[i] = estimate_presets[i];
+  }
+}
+
+void MicroFrontend::GetNoiseEstimates(uint32_t* estimates) const {
+  for (int i = 0; i < state_.filterbank.num_channels; ++i) {
+    estimates[i] = state_.noise_reduction.estimate[i];
+  }
+}
+
+TfLiteStatus MicroFrontend::GenerateFeatures(
+    tflite::ErrorReporter* error_reporter, const int16_t* input,
+    int input_size, int output_size, int8_t* output,
+    size_t* num_samples_read) {
+  // After the first window the frontend already holds the history the window
+  // starts with, so only feed it the new samples.
+  const int skip = is_first_window_ ? 0 : history_samples();
+  is_first_window_ = false;
+  FrontendOutput frontend_output =
+      ProcessSamples(input + skip, input_size - skip, num_samples_read);
+  if (frontend_output.size > static_cast<size_t>(output_size)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Frontend produced %d features, want %d",
+                         static_cast<int>(frontend_output.size), output_size);
+    return kTfLiteError;
+  }
+  Quantize(frontend_output, output);
+
+  return kTfLiteOk;
+}
+
+TfLiteStatus MicroFrontend::GenerateFeaturesBatch(
+    tflite::ErrorReporter* error_reporter, const RingSpan<int16_t>& input,
+    int slice_count, int slice_size, const RingSpan<int8_t>& output,
+    int* slices_generated) {
+  // Like GenerateFeatures, skip the history at the start of the window once
+  // the frontend already holds it.
+  size_t skip = is_first_window_ ? 0 : history_samples();
+  is_first_window_ = false;
+  *slices_generated = 0;
+
+  const int16_t* pieces[2] = {input.first, input.second};
+  const size_t piece_sizes[2] = {input.first_size, input.second_size};
+  for (int piece = 0; piece < 2; ++piece) {
+    if (skip >= piece_sizes[piece]) {
+      skip -= piece_sizes[piece];
+      continue;
     }
-    if (value > 127) {
-      value = 127;
+    const int16_t* samples = pieces[piece] + skip;
+    size_t samples_left = piece_sizes[piece] - skip;
+    skip = 0;
+    // The frontend keeps any partial window internally, so a window that's
+    // split across the two pieces is simply finished by the second one.
+    while (samples_left > 0 && *slices_generated < slice_count) {
+      size_t num_samples_read = 0;
+      FrontendOutput frontend_output =
+          ProcessSamples(samples, samples_left, &num_samples_read);
+      if (num_samples_read == 0) {
+        break;
+      }
+      samples += num_samples_read;
+      samples_left -= num_samples_read;
+      if (frontend_output.size == 0) {
+        continue;
+      }
+      if (frontend_output.size != static_cast<size_t>(slice_size)) {
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "Frontend produced %d features, want %d",
+                             frontend_output.size, slice_size);
+        return kTfLiteError;
+      }
+      const uint32_t offset = *slices_generated * slice_size;
+      Quantize(frontend_output,
+               offset < output.first_size
+                   ? output.first + offset
+                   : output.second + (offset - output.first_size));
+      ++*slices_generated;
     }
-    output[i] = value;
   }
 
   return kTfLiteOk;
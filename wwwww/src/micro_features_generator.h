@@ -16,17 +16,128 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_FEATURES_GENERATOR_H_
 #define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_FEATURES_GENERATOR_H_
 
+#include "fft_backend.h"
+#include "frontend_tables.h"
+#include "micro_model_settings.h"
 #include "tensorflow/lite/c/common.h"
+#include "ring_buffer.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/frontend_util.h"
 #include "tensorflow/lite/micro/micro_error_reporter.h"
 
-// Sets up any resources needed for the feature generation pipeline.
-TfLiteStatus InitializeMicroFeatures(tflite::ErrorReporter* error_reporter);
+// Working memory for a MicroFrontend set up with InitializeForModel(). Giving
+// it static storage keeps the heap out of the frontend entirely.
+struct MicroFrontendWorkspace {
+  // Enough for kissfft's configuration and twiddles at kFrontendFftSize, which
+  // is checked when the frontend is set up.
+  static constexpr int kFftScratchBytes = 3072;
 
-// Converts audio sample data into a more compact form that's appropriate for
-// feeding into a neural network.
-TfLiteStatus GenerateMicroFeatures(tflite::ErrorReporter* error_reporter,
-                                   const int16_t* input, int input_size,
-                                   int output_size, int8_t* output,
-                                   size_t* num_samples_read);
+  int16_t window_input[kFrontendWindowSize];
+  int16_t window_output[kFrontendWindowSize];
+  int16_t fft_input[kFrontendFftSize];
+  // Sized like FftPopulateState() does it.
+  complex_int16_t fft_output[(kFrontendFftSize / 2 + 1) * 2];
+  alignas(8) uint8_t fft_scratch[kFftScratchBytes];
+  uint64_t filterbank_work[kFrontendFilterbankChannelCount];
+  uint32_t noise_estimate[kFeatureSliceSize];
+};
+
+// One feature generation pipeline: the frontend state for a single audio
+// stream, plus the bookkeeping for the overlap between consecutive windows.
+// Instances share nothing, so several streams or configurations can be
+// processed side by side, from different tasks or cores.
+class MicroFrontend {
+ public:
+  MicroFrontend();
+  ~MicroFrontend();
+
+  // Fills `config` with the settings the model in model.cpp was trained with.
+  static void FillModelConfig(FrontendConfig* config);
+
+  // Sets up the frontend state for `config`. Calling it again starts over,
+  // releasing the previous state.
+  TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter,
+                          const FrontendConfig& config, int sample_rate);
+
+  // Sets up the frontend for the settings in micro_model_settings.h without
+  // computing anything or touching the heap. The constant tables come from
+  // frontend_tables.cpp in flash, and everything that changes lives in
+  // `workspace`, which has to outlive the frontend.
+  TfLiteStatus InitializeForModel(tflite::ErrorReporter* error_reporter,
+                                  MicroFrontendWorkspace* workspace);
+
+  // Switches the FFT stage to `backend`, which must outlive the frontend.
+  // Frontends start out with a DefaultFftBackend of their own.
+  TfLiteStatus SetFftBackend(tflite::ErrorReporter* error_reporter,
+                             FftBackend* backend);
+
+  // Rebuilds the table that maps frontend output onto int8 features, for a
+  // model input tensor quantized with `scale` and `zero_point`. Until this is
+  // called, features are quantized for the input of the bundled model.
+  TfLiteStatus SetOutputQuantization(tflite::ErrorReporter* error_reporter,
+                                     float scale, int32_t zero_point);
+
+  // Number of samples at the start of each window that were already part of
+  // the previous one, derived from the configured window size and stride.
+  int history_samples() const;
+
+  // Overwrites the noise reduction estimates, one per channel.
+  void SetNoiseEstimates(const uint32_t* estimate_presets);
+
+  // Copies the noise reduction estimates out, one per channel.
+  void GetNoiseEstimates(uint32_t* estimates) const;
+
+  // Converts one window of audio into a slice of features. The window starts
+  // with history_samples() of overlap with the previous one, which are only
+  // used for the very first window.
+  TfLiteStatus GenerateFeatures(tflite::ErrorReporter* error_reporter,
+                                const int16_t* input, int input_size,
+                                int output_size, int8_t* output,
+                                size_t* num_samples_read);
+
+  // Generates up to `slice_count` consecutive feature slices in one pass over
+  // `input`, which holds the audio for all of them laid out like a single
+  // window stretched over several strides, possibly split in two where it
+  // wraps around a ring. The slices are written one after the other into
+  // `output`, which can wrap the same way as long as its first piece holds a
+  // whole number of slices, so the results can land straight in the rows of a
+  // circular spectrogram.
+  TfLiteStatus GenerateFeaturesBatch(tflite::ErrorReporter* error_reporter,
+                                     const RingSpan<int16_t>& input,
+                                     int slice_count, int slice_size,
+                                     const RingSpan<int8_t>& output,
+                                     int* slices_generated);
+
+ private:
+  // Frontend output values from this one up all quantize to the same feature,
+  // for any input scale that's coarse enough for a useful model.
+  static constexpr int kQuantizerTableSize = 1024;
+
+  // Fills the quantizer table, and returns false if values past its end don't
+  // all saturate to its last entry.
+  bool BuildQuantizerTable(float scale, int32_t zero_point);
+  void Quantize(const FrontendOutput& frontend_output, int8_t* output) const;
+
+  // Same as FrontendProcessSamples(), except the FFT goes through
+  // fft_backend_ and the later stages are the ones from frontend_stages.h.
+  FrontendOutput ProcessSamples(const int16_t* samples, size_t num_samples,
+                                size_t* num_samples_read);
+
+  // Frees the state if it was allocated by Initialize().
+  void ReleaseState();
+
+  // The state owns heap allocations, so copies would double free them.
+  MicroFrontend(const MicroFrontend&) = delete;
+  MicroFrontend& operator=(const MicroFrontend&) = delete;
+
+  FrontendState state_;
+  DefaultFftBackend default_fft_backend_;
+  FftBackend* fft_backend_;
+  bool is_initialized_;
+  // Whether state_ was allocated by FrontendPopulateState().
+  bool owns_state_;
+  bool is_first_window_;
+  int8_t quantizer_table_[kQuantizerTableSize];
+};
 
 #endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_FEATURES_GENERATOR_H_
@@ -16,28 +16,56 @@ limitations under the License.
 #ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_MODEL_SETTINGS_H_
 #define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_MODEL_SETTINGS_H_
 
+#include "pipeline_config.h"
+
 // Keeping these as constant expressions allow us to allocate fixed-sized arrays
 // on the stack for our working memory.
 
+// The pipeline the bundled model was trained for: 16KHz audio cut into 30ms
+// windows every 20ms, 40 filterbank channels per slice, 49 slices, and four
+// output categories. These values are derived from values used during model
+// training. If you change the way you preprocess the input, pick the new
+// values here, retrain, and rerun tools/generate_frontend_tables.cpp.
+typedef PipelineConfig<16000, 30, 20, 40, 49, 4> ModelPipelineConfig;
+
 // The size of the input time series data we pass to the FFT to produce the
 // frequency information. This has to be a power of two, and since we're dealing
 // with 30ms of 16KHz inputs, which means 480 samples, this is the next value.
-constexpr int kMaxAudioSampleSize = 512;
-constexpr int kAudioSampleFrequency = 16000;
+constexpr int kMaxAudioSampleSize = ModelPipelineConfig::kFftSize;
+constexpr int kAudioSampleFrequency = ModelPipelineConfig::kSampleRate;
+
+constexpr int kFeatureSliceSize = ModelPipelineConfig::kSliceSize;
+constexpr int kFeatureSliceCount = ModelPipelineConfig::kSliceCount;
+constexpr int kFeatureElementCount = ModelPipelineConfig::kElementCount;
+constexpr int kFeatureSliceStrideMs = ModelPipelineConfig::kStrideMs;
+constexpr int kFeatureSliceDurationMs = ModelPipelineConfig::kWindowMs;
+// The feature pipeline outputs 16-bit integers in roughly a 0 to 670 range.
+// In training these are divided by this value to get the float features the
+// model was trained on, for historical reasons, to match up with the output of
+// other feature generators. See input_data.py in the training pipeline.
+constexpr float kFeatureFrontendScale = 25.6f;
 
-// The following values are derived from values used during model training.
-// If you change the way you preprocess the input, update all these constants.
-constexpr int kFeatureSliceSize = 40;
-constexpr int kFeatureSliceCount = 49;
-constexpr int kFeatureElementCount = (kFeatureSliceSize * kFeatureSliceCount);
-constexpr int kFeatureSliceStrideMs = 20;
-constexpr int kFeatureSliceDurationMs = 30;
+// Settings of the frontend stages that turn audio into feature slices. The
+// model only works with features made exactly this way.
+constexpr float kFilterbankLowerBandLimit = 125.0f;
+constexpr float kFilterbankUpperBandLimit = 7500.0f;
+constexpr int kNoiseReductionSmoothingBits = 10;
+constexpr float kNoiseReductionEvenSmoothing = 0.025f;
+constexpr float kNoiseReductionOddSmoothing = 0.06f;
+constexpr float kNoiseReductionMinSignalRemaining = 0.05f;
+constexpr int kPcanGainControlEnable = 1;
+constexpr float kPcanGainControlStrength = 0.95f;
+constexpr float kPcanGainControlOffset = 80.0f;
+constexpr int kPcanGainControlGainBits = 21;
+constexpr int kLogScaleEnable = 1;
+constexpr int kLogScaleShift = 6;
 
 // Variables for the model's output categories.
 constexpr int kSilenceIndex = 0;
 constexpr int kUnknownIndex = 1;
-// If you modify the output categories, you need to update the following values.
-constexpr int kCategoryCount = 4;
+// If you modify the output categories, you need to update ModelPipelineConfig
+// and kCategoryLabels.
+constexpr int kCategoryCount = ModelPipelineConfig::kCategoryCount;
 extern const char* kCategoryLabels[kCategoryCount];
 
 #endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MICRO_FEATURES_MICRO_MODEL_SETTINGS_H_
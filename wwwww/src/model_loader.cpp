@@ -0,0 +1,160 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "model_loader.h"
+
+#include "micro_model_settings.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_partition.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef ESP_PLATFORM
+// Application-defined partition type of the model partition in
+// partitions.csv.
+const esp_partition_type_t kModelPartitionType =
+    static_cast<esp_partition_type_t>(0x40);
+#endif
+
+bool HasShape(const TfLiteTensor* tensor, int elements) {
+  return tensor != nullptr && tensor->type == kTfLiteInt8 &&
+         tensor->dims->size == 2 && tensor->dims->data[0] == 1 &&
+         tensor->dims->data[1] == elements;
+}
+
+}  // namespace
+
+const tflite::Model* CheckModel(tflite::ErrorReporter* error_reporter,
+                                const uint8_t* data, size_t size,
+                                const tflite::MicroOpResolver& op_resolver,
+                                uint8_t* arena, size_t arena_size) {
+  // An erased partition or a stray file fails here, before anything reads
+  // offsets out of it.
+  if (size < 8 || !tflite::ModelBufferHasIdentifier(data)) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Not a TensorFlow Lite model");
+    return nullptr;
+  }
+  flatbuffers::Verifier verifier(data, size);
+  if (!tflite::VerifyModelBuffer(verifier)) {
+    TF_LITE_REPORT_ERROR(error_reporter, "The model flatbuffer is corrupt");
+    return nullptr;
+  }
+  const tflite::Model* model = tflite::GetModel(data);
+  if (model->version() != TFLITE_SCHEMA_VERSION) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Model provided is schema version %d not equal "
+                         "to supported version %d.",
+                         static_cast<int>(model->version()),
+                         TFLITE_SCHEMA_VERSION);
+    return nullptr;
+  }
+
+  // Allocating the tensors resolves every op and plans the arena, which
+  // catches unsupported ops and models too big for it.
+  tflite::MicroInterpreter interpreter(model, op_resolver, arena, arena_size,
+                                       error_reporter);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "The model doesn't fit the ops or the arena");
+    return nullptr;
+  }
+  if (interpreter.inputs_size() != 1 || interpreter.outputs_size() != 1 ||
+      !HasShape(interpreter.input(0), kFeatureElementCount) ||
+      !HasShape(interpreter.output(0), kCategoryCount)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "The model needs one int8 input of %d features and "
+                         "one int8 output of %d scores",
+                         kFeatureElementCount, kCategoryCount);
+    return nullptr;
+  }
+  return model;
+}
+
+#ifdef ESP_PLATFORM
+
+const tflite::Model* MapPartitionModel(
+    tflite::ErrorReporter* error_reporter, const char* label,
+    const tflite::MicroOpResolver& op_resolver, uint8_t* arena,
+    size_t arena_size) {
+  const esp_partition_t* partition = esp_partition_find_first(
+      kModelPartitionType, ESP_PARTITION_SUBTYPE_ANY, label);
+  if (partition == nullptr) {
+    TF_LITE_REPORT_ERROR(error_reporter, "No \"%s\" partition", label);
+    return nullptr;
+  }
+  // The flash cache serves the model like it serves the compiled-in one, so
+  // this takes no RAM beyond an MMU entry per 64KB.
+  const void* data = nullptr;
+  spi_flash_mmap_handle_t handle;
+  const esp_err_t status = esp_partition_mmap(
+      partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &data, &handle);
+  if (status != ESP_OK) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Couldn't map the \"%s\" partition, error %d", label,
+                         static_cast<int>(status));
+    return nullptr;
+  }
+  const tflite::Model* model =
+      CheckModel(error_reporter, static_cast<const uint8_t*>(data),
+                 partition->size, op_resolver, arena, arena_size);
+  if (model == nullptr) {
+    spi_flash_munmap(handle);
+  }
+  return model;
+}
+
+#else  // ESP_PLATFORM
+
+const tflite::Model* MapModelFile(tflite::ErrorReporter* error_reporter,
+                                  const char* path,
+                                  const tflite::MicroOpResolver& op_resolver,
+                                  uint8_t* arena, size_t arena_size) {
+  const int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Couldn't open %s", path);
+    return nullptr;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Couldn't read %s", path);
+    close(fd);
+    return nullptr;
+  }
+  const size_t size = static_cast<size_t>(file_stat.st_size);
+  void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid without the descriptor.
+  close(fd);
+  if (data == MAP_FAILED) {
+    TF_LITE_REPORT_ERROR(error_reporter, "Couldn't map %s", path);
+    return nullptr;
+  }
+  const tflite::Model* model =
+      CheckModel(error_reporter, static_cast<const uint8_t*>(data), size,
+                 op_resolver, arena, arena_size);
+  if (model == nullptr) {
+    munmap(data, size);
+  }
+  return model;
+}
+
+#endif  // ESP_PLATFORM
@@ -0,0 +1,61 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MODEL_LOADER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MODEL_LOADER_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+// Label of the data partition a .tflite can be written to, see
+// partitions.csv.
+constexpr char kModelPartitionLabel[] = "model";
+
+// Checks that the `size` bytes at `data` hold a valid TensorFlow Lite model
+// this pipeline can run in place of the built-in one: a well-formed flatbuffer
+// of the supported schema version, whose ops are all in `op_resolver`, whose
+// tensors fit into the `arena_size` bytes at `arena`, and which takes a
+// kFeatureElementCount int8 spectrogram and returns kCategoryCount int8
+// scores. The arena is only used during the call. Returns the model, or
+// nullptr after reporting what's wrong with it.
+const tflite::Model* CheckModel(tflite::ErrorReporter* error_reporter,
+                                const uint8_t* data, size_t size,
+                                const tflite::MicroOpResolver& op_resolver,
+                                uint8_t* arena, size_t arena_size);
+
+#ifdef ESP_PLATFORM
+// Maps the model partition labeled `label` into the address space, without
+// copying it to RAM, and returns the model in it if CheckModel() accepts it.
+// The mapping is kept for as long as the program runs.
+const tflite::Model* MapPartitionModel(
+    tflite::ErrorReporter* error_reporter, const char* label,
+    const tflite::MicroOpResolver& op_resolver, uint8_t* arena,
+    size_t arena_size);
+#else
+// Maps the .tflite file at `path` read-only, and returns the model in it if
+// CheckModel() accepts it. The mapping is kept for as long as the program
+// runs.
+const tflite::Model* MapModelFile(tflite::ErrorReporter* error_reporter,
+                                  const char* path,
+                                  const tflite::MicroOpResolver& op_resolver,
+                                  uint8_t* arena, size_t arena_size);
+#endif
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_MODEL_LOADER_H_
@@ -0,0 +1,239 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "noise_snapshot.h"
+
+#include <cstring>
+#include <ctime>
+
+// clang-format off
+#include "freertos/FreeRTOS.h"
+// clang-format on
+
+#include "freertos/task.h"
+#include "frontend_tables.h"
+#include "micro_model_settings.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "ring_buffer.h"
+
+namespace {
+
+constexpr char kNvsNamespace[] = "micro_speech";
+constexpr char kSnapshotKey[] = "noise";
+constexpr char kBootCountKey[] = "boots";
+// Bump this whenever NoiseSnapshot changes.
+constexpr uint32_t kSnapshotVersion = 1;
+// Wall clock times before this mean the clock was never set.
+constexpr time_t kEarliestValidTime = 1577836800;  // 2020-01-01
+
+struct NoiseSnapshot {
+  uint32_t version;
+  // Estimates only carry over between identical frontends.
+  uint32_t settings_hash;
+  uint32_t boot_count;
+  // Wall clock time of the save, or 0 if the clock wasn't set.
+  int64_t saved_at;
+  uint32_t estimates[kFeatureSliceSize];
+};
+
+// Estimates on their way from the feature task to the snapshot task.
+struct NoiseEstimates {
+  uint32_t values[kFeatureSliceSize];
+};
+
+// Flash writes take milliseconds, so they run at the lowest priority that
+// still beats the idle task.
+constexpr uint32_t kSnapshotTaskStackBytes = 4096;
+constexpr UBaseType_t kSnapshotTaskPriority = tskIDLE_PRIORITY + 1;
+
+bool g_is_nvs_ready = false;
+uint32_t g_boot_count = 0;
+// Only the newest estimates get saved, so room for one being picked up and one
+// more is plenty.
+RingBuffer<NoiseEstimates, 2> g_pending_estimates;
+TaskHandle_t g_snapshot_task = nullptr;
+tflite::ErrorReporter* g_snapshot_error_reporter = nullptr;
+
+uint32_t HashBytes(uint32_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// FNV-1a over everything the noise estimates depend on.
+uint32_t SettingsHash() {
+  uint32_t hash = 2166136261u;
+  hash = HashBytes(hash, g_frontend_window_coefficients,
+                   sizeof(g_frontend_window_coefficients));
+  hash = HashBytes(hash, g_frontend_filterbank_weights,
+                   sizeof(g_frontend_filterbank_weights));
+  hash = HashBytes(hash, g_frontend_filterbank_unweights,
+                   sizeof(g_frontend_filterbank_unweights));
+  const int32_t settings[] = {kAudioSampleFrequency,
+                              kFrontendFftSize,
+                              kFeatureSliceSize,
+                              kNoiseReductionSmoothingBits,
+                              kFrontendNoiseEvenSmoothing,
+                              kFrontendNoiseOddSmoothing,
+                              kFrontendNoiseMinSignalRemaining};
+  return HashBytes(hash, settings, sizeof(settings));
+}
+
+// Opens the NVS namespace, and on the first call of each boot counts the boot.
+bool OpenStore(tflite::ErrorReporter* error_reporter, nvs_handle_t* handle) {
+  if (!g_is_nvs_ready) {
+    // The Arduino core normally did this already, in which case it's a no-op.
+    esp_err_t init_status = nvs_flash_init();
+    if (init_status != ESP_OK) {
+      TF_LITE_REPORT_ERROR(error_reporter, "nvs_flash_init() failed with %d",
+                           init_status);
+      return false;
+    }
+  }
+  esp_err_t open_status = nvs_open(kNvsNamespace, NVS_READWRITE, handle);
+  if (open_status != ESP_OK) {
+    TF_LITE_REPORT_ERROR(error_reporter, "nvs_open() failed with %d",
+                         open_status);
+    return false;
+  }
+  if (!g_is_nvs_ready) {
+    nvs_get_u32(*handle, kBootCountKey, &g_boot_count);
+    ++g_boot_count;
+    nvs_set_u32(*handle, kBootCountKey, g_boot_count);
+    nvs_commit(*handle);
+    g_is_nvs_ready = true;
+  }
+  return true;
+}
+
+bool IsStale(tflite::ErrorReporter* error_reporter,
+             const NoiseSnapshot& snapshot) {
+  const time_t now = time(nullptr);
+  if (now >= kEarliestValidTime && snapshot.saved_at >= kEarliestValidTime) {
+    const int64_t age = now - snapshot.saved_at;
+    if (age < 0 || age > kNoiseSnapshotMaxAgeS) {
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Noise estimates are %d s old, starting cold",
+                           static_cast<int>(age));
+      return true;
+    }
+    return false;
+  }
+  // Without a clock, only trust estimates the previous boot saved.
+  if (snapshot.boot_count + 1 < g_boot_count) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Noise estimates are %d boots old, starting cold",
+                         static_cast<int>(g_boot_count - snapshot.boot_count));
+    return true;
+  }
+  return false;
+}
+
+TfLiteStatus WriteSnapshot(tflite::ErrorReporter* error_reporter,
+                           const NoiseEstimates& estimates) {
+  nvs_handle_t handle;
+  if (!OpenStore(error_reporter, &handle)) {
+    return kTfLiteError;
+  }
+  NoiseSnapshot snapshot;
+  snapshot.version = kSnapshotVersion;
+  snapshot.settings_hash = SettingsHash();
+  snapshot.boot_count = g_boot_count;
+  const time_t now = time(nullptr);
+  snapshot.saved_at = (now >= kEarliestValidTime) ? now : 0;
+  memcpy(snapshot.estimates, estimates.values, sizeof(snapshot.estimates));
+  esp_err_t set_status =
+      nvs_set_blob(handle, kSnapshotKey, &snapshot, sizeof(snapshot));
+  if (set_status == ESP_OK) {
+    set_status = nvs_commit(handle);
+  }
+  nvs_close(handle);
+  if (set_status != ESP_OK) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Saving noise estimates failed with %d", set_status);
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
+
+// Sleeps until QueueNoiseEstimatesSave() hands over estimates, and saves the
+// newest of them.
+void SnapshotTask(void* arg) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    NoiseEstimates estimates;
+    bool has_estimates = false;
+    while (g_pending_estimates.Read(&estimates, 1) == 1) {
+      has_estimates = true;
+    }
+    if (has_estimates) {
+      WriteSnapshot(g_snapshot_error_reporter, estimates);
+    }
+  }
+}
+
+}  // namespace
+
+bool RestoreNoiseEstimates(tflite::ErrorReporter* error_reporter,
+                           MicroFrontend* frontend) {
+  nvs_handle_t handle;
+  if (!OpenStore(error_reporter, &handle)) {
+    return false;
+  }
+  NoiseSnapshot snapshot;
+  size_t size = sizeof(snapshot);
+  esp_err_t get_status = nvs_get_blob(handle, kSnapshotKey, &snapshot, &size);
+  nvs_close(handle);
+  if (get_status != ESP_OK || size != sizeof(snapshot) ||
+      snapshot.version != kSnapshotVersion) {
+    return false;
+  }
+  if (snapshot.settings_hash != SettingsHash()) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Noise estimates are from other frontend settings");
+    return false;
+  }
+  if (IsStale(error_reporter, snapshot)) {
+    return false;
+  }
+  frontend->SetNoiseEstimates(snapshot.estimates);
+  return true;
+}
+
+TfLiteStatus QueueNoiseEstimatesSave(tflite::ErrorReporter* error_reporter,
+                                     const MicroFrontend& frontend) {
+  if (g_snapshot_task == nullptr) {
+    g_snapshot_error_reporter = error_reporter;
+    if (xTaskCreate(SnapshotTask, "NoiseSnapshot", kSnapshotTaskStackBytes,
+                    nullptr, kSnapshotTaskPriority,
+                    &g_snapshot_task) != pdPASS) {
+      g_snapshot_task = nullptr;
+      TF_LITE_REPORT_ERROR(error_reporter,
+                           "Couldn't start the noise snapshot task");
+      return kTfLiteError;
+    }
+  }
+  NoiseEstimates estimates;
+  frontend.GetNoiseEstimates(estimates.values);
+  // If the snapshot task is that far behind, this save is skipped and the
+  // next one catches up.
+  if (g_pending_estimates.Write(&estimates, 1) == 1) {
+    xTaskNotifyGive(g_snapshot_task);
+  }
+  return kTfLiteOk;
+}
@@ -0,0 +1,52 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_NOISE_SNAPSHOT_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_NOISE_SNAPSHOT_H_
+
+#include "micro_features_generator.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+// The noise reduction stage needs seconds of audio before its per-channel
+// noise estimates settle after a cold start, and features are off until then.
+// These functions keep a copy of the estimates in NVS, so the next boot can
+// start from where the last one left off. PCAN gain control works from the
+// same estimates, so they are all the state that needs saving.
+
+// How often a running frontend should save its estimates. Every NVS write is
+// small, so even at this rate the default NVS partition's wear leveling keeps
+// flash wear negligible.
+constexpr int32_t kNoiseSnapshotIntervalMs = 60 * 1000;
+
+// Saved estimates older than this are from a different acoustic situation as
+// far as we know, and the frontend starts cold instead.
+constexpr int32_t kNoiseSnapshotMaxAgeS = 60 * 60;
+
+// Loads the saved estimates into `frontend`, which must be initialized with
+// the settings in micro_model_settings.h. Returns true if they were restored,
+// or false if there were none, they were saved with different frontend
+// settings, or they are stale, in which case the frontend is left cold.
+bool RestoreNoiseEstimates(tflite::ErrorReporter* error_reporter,
+                           MicroFrontend* frontend);
+
+// Copies the current estimates of `frontend` and hands them to a low-priority
+// task that saves them, without waiting for the write, which would stall the
+// caller for milliseconds. The task is started on the first call, and always
+// saves the newest estimates it was handed. Only one task may call this.
+TfLiteStatus QueueNoiseEstimatesSave(tflite::ErrorReporter* error_reporter,
+                                     const MicroFrontend& frontend);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_NOISE_SNAPSHOT_H_
@@ -0,0 +1,165 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "op_profiler.h"
+
+#include <algorithm>
+
+#ifdef ESP_PLATFORM
+#include "xtensa/hal.h"
+#else
+#include <chrono>
+#endif
+
+namespace {
+
+// Handle of events that aren't ops, which EndEvent() ignores.
+constexpr uint32_t kIgnoredEvent = 0;
+
+uint64_t Now() {
+#ifdef ESP_PLATFORM
+  return xthal_get_ccount();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+#ifdef ESP_PLATFORM
+const char* const kTimeUnit = "cycles";
+#else
+const char* const kTimeUnit = "ns";
+#endif
+
+}  // namespace
+
+OpProfiler::OpProfiler()
+    : op_count_(0), invocations_(0), current_op_(-1), current_start_(0) {
+  Reset();
+}
+
+uint32_t OpProfiler::BeginEvent(const char* tag, EventType event_type,
+                                int64_t event_metadata1,
+                                int64_t event_metadata2) {
+  (void)event_metadata2;
+  // The interpreter numbers its ops in `event_metadata1`.
+  if (event_type != EventType::OPERATOR_INVOKE_EVENT || event_metadata1 < 0 ||
+      event_metadata1 >= kMaxOps) {
+    return kIgnoredEvent;
+  }
+  const int op_index = static_cast<int>(event_metadata1);
+  if (op_index == 0) {
+    ++invocations_;
+  }
+  if (op_index >= op_count_) {
+    op_count_ = op_index + 1;
+  }
+  ops_[op_index].tag = tag;
+  current_op_ = op_index;
+  current_start_ = Now();
+  return op_index + 1;
+}
+
+void OpProfiler::EndEvent(uint32_t event_handle) {
+  const uint64_t end = Now();
+  if (event_handle == kIgnoredEvent ||
+      static_cast<int>(event_handle) - 1 != current_op_) {
+    return;
+  }
+  // The cycle counter wraps, but never twice during one op.
+  const uint32_t duration = static_cast<uint32_t>(end - current_start_);
+  OpStats* op = &ops_[current_op_];
+  if (op->count == 0 || duration < op->min) {
+    op->min = duration;
+  }
+  if (duration > op->max) {
+    op->max = duration;
+  }
+  op->sum += duration;
+  // Once full, the oldest samples make room for new ones.
+  op->samples[op->count % kMaxSamples] = duration;
+  ++op->count;
+#ifndef ESP_PLATFORM
+  if (trace_size_ < kMaxTraceEvents) {
+    TraceEvent* event = &trace_[trace_size_++];
+    event->tag = op->tag;
+    event->op_index = current_op_;
+    event->start = current_start_;
+    event->duration = duration;
+  }
+#endif
+  current_op_ = -1;
+}
+
+void OpProfiler::Reset() {
+  for (int i = 0; i < kMaxOps; ++i) {
+    ops_[i].tag = "";
+    ops_[i].min = 0;
+    ops_[i].max = 0;
+    ops_[i].sum = 0;
+    ops_[i].count = 0;
+  }
+  op_count_ = 0;
+  invocations_ = 0;
+  current_op_ = -1;
+#ifndef ESP_PLATFORM
+  trace_size_ = 0;
+#endif
+}
+
+void OpProfiler::ReportCsv(tflite::ErrorReporter* error_reporter) const {
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "op,name,count,min_%s,mean_%s,p99_%s,max_%s", kTimeUnit,
+                       kTimeUnit, kTimeUnit, kTimeUnit);
+  static uint32_t sorted[kMaxSamples];
+  for (int i = 0; i < op_count_; ++i) {
+    const OpStats& op = ops_[i];
+    if (op.count == 0) {
+      continue;
+    }
+    // The percentile only covers the samples still kept, the other figures
+    // cover every run since the last Reset().
+    const int sample_count =
+        (op.count < kMaxSamples) ? op.count : kMaxSamples;
+    std::copy(op.samples, op.samples + sample_count, sorted);
+    const int p99_index = (sample_count * 99 + 99) / 100 - 1;
+    std::nth_element(sorted, sorted + p99_index, sorted + sample_count);
+    TF_LITE_REPORT_ERROR(error_reporter, "%d,%s,%d,%u,%u,%u,%u", i, op.tag,
+                         op.count, static_cast<unsigned>(op.min),
+                         static_cast<unsigned>(op.sum / op.count),
+                         static_cast<unsigned>(sorted[p99_index]),
+                         static_cast<unsigned>(op.max));
+  }
+}
+
+#ifndef ESP_PLATFORM
+bool OpProfiler::WriteChromeTrace(FILE* file) const {
+  // Complete events, with timestamps in microseconds from the first op.
+  const uint64_t origin = (trace_size_ > 0) ? trace_[0].start : 0;
+  fprintf(file, "{\"traceEvents\":[\n");
+  for (int i = 0; i < trace_size_; ++i) {
+    const TraceEvent& event = trace_[i];
+    fprintf(file,
+            "{\"name\":\"%s\",\"cat\":\"op\",\"ph\":\"X\",\"ts\":%.3f,"
+            "\"dur\":%.3f,\"pid\":0,\"tid\":0,\"args\":{\"op\":%d}}%s\n",
+            event.tag, (event.start - origin) / 1000.0,
+            event.duration / 1000.0, event.op_index,
+            (i + 1 < trace_size_) ? "," : "");
+  }
+  fprintf(file, "],\"displayTimeUnit\":\"ns\"}\n");
+  return ferror(file) == 0;
+}
+#endif
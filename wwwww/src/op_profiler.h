@@ -0,0 +1,96 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_OP_PROFILER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_OP_PROFILER_H_
+
+#include <cstdint>
+#include <cstdio>
+
+#include "tensorflow/lite/core/api/profiler.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+// Times every op a MicroInterpreter runs, when passed to its constructor. It
+// keeps the last kMaxSamples durations of each op, in CPU cycles on the device
+// and in nanoseconds on the host, and reports their min, mean and 99th
+// percentile as CSV. The host build also records a timeline of the ops that
+// can be written out as a Chrome trace, to open in chrome://tracing or
+// Perfetto.
+// Interpreters that are invoked one after the other, never at the same time,
+// can share one profiler.
+class OpProfiler : public tflite::Profiler {
+ public:
+  // More than the ops of any model of the micro_speech family.
+  static constexpr int kMaxOps = 8;
+  // Invocations the statistics cover, enough for a stable 99th percentile.
+  static constexpr int kMaxSamples = 500;
+
+  OpProfiler();
+
+  uint32_t BeginEvent(const char* tag, EventType event_type,
+                      int64_t event_metadata1,
+                      int64_t event_metadata2) override;
+  void EndEvent(uint32_t event_handle) override;
+
+  // Number of times the first op ran since the last Reset().
+  int invocations() const { return invocations_; }
+
+  // Forgets all durations, and the timeline.
+  void Reset();
+
+  // Reports one CSV line per op with its index, name, sample count, and min,
+  // mean and 99th percentile duration, after a header line.
+  void ReportCsv(tflite::ErrorReporter* error_reporter) const;
+
+#ifndef ESP_PLATFORM
+  // Writes the timeline in the Chrome trace event format. Returns false if
+  // writing failed.
+  bool WriteChromeTrace(FILE* file) const;
+#endif
+
+ private:
+  struct OpStats {
+    const char* tag;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+    int count;
+    uint32_t samples[kMaxSamples];
+  };
+
+#ifndef ESP_PLATFORM
+  static constexpr int kMaxTraceEvents = kMaxOps * kMaxSamples;
+
+  struct TraceEvent {
+    const char* tag;
+    int op_index;
+    uint64_t start;
+    uint32_t duration;
+  };
+#endif
+
+  OpStats ops_[kMaxOps];
+  int op_count_;
+  int invocations_;
+  // Op that's running and when it started.
+  int current_op_;
+  uint64_t current_start_;
+#ifndef ESP_PLATFORM
+  TraceEvent trace_[kMaxTraceEvents];
+  int trace_size_;
+#endif
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_OP_PROFILER_H_
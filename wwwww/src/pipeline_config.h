@@ -0,0 +1,75 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_PIPELINE_CONFIG_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_PIPELINE_CONFIG_H_
+
+#include <cstdint>
+
+// Smallest power of two that is at least `value`.
+constexpr int NextPowerOfTwo(int value, int power = 1) {
+  return power >= value ? power : NextPowerOfTwo(value, power * 2);
+}
+
+// Shape of the whole audio to command pipeline: how the audio is cut into
+// windows, how many filterbank channels each feature slice has, how many
+// slices the model looks at and how many categories it scores. Everything
+// else (window, stride and history lengths in samples, the FFT size, the
+// spectrogram size) is derived here at compile time, so a variant with a
+// different stride or channel count is a matter of picking other arguments.
+template <int SampleRate, int WindowMs, int StrideMs, int Channels,
+          int SliceCount, int CategoryCount>
+struct PipelineConfig {
+  static_assert(SampleRate > 0 && SampleRate % 1000 == 0,
+                "The sample rate has to be a whole number of samples per ms");
+  static_assert(StrideMs > 0 && StrideMs <= WindowMs,
+                "Windows have to overlap or touch, not leave gaps");
+  static_assert(Channels > 0 && SliceCount > 0,
+                "The spectrogram can't be empty");
+  static_assert(CategoryCount > 0, "The model has to score something");
+
+  static constexpr int kSampleRate = SampleRate;
+  static constexpr int kSamplesPerMs = SampleRate / 1000;
+
+  // Audio going into each feature slice.
+  static constexpr int kWindowMs = WindowMs;
+  static constexpr int kStrideMs = StrideMs;
+  static constexpr int kWindowSamples = WindowMs * kSamplesPerMs;
+  static constexpr int kStrideSamples = StrideMs * kSamplesPerMs;
+  // Samples each window shares with the one before it.
+  static constexpr int kHistorySamples = kWindowSamples - kStrideSamples;
+  static constexpr int kFftSize = NextPowerOfTwo(kWindowSamples);
+
+  // Features the model takes.
+  static constexpr int kSliceSize = Channels;
+  static constexpr int kSliceCount = SliceCount;
+  static constexpr int kElementCount = Channels * SliceCount;
+  // Audio that goes into one full spectrogram.
+  static constexpr int kSpectrogramMs = SliceCount * StrideMs;
+  static constexpr int kSpectrogramSamples =
+      kHistorySamples + SliceCount * kStrideSamples;
+
+  // Scores the model puts out.
+  static constexpr int kCategoryCount = CategoryCount;
+
+  static constexpr int32_t SamplesForMs(int32_t ms) {
+    return ms * kSamplesPerMs;
+  }
+  static constexpr int32_t MsForSamples(int32_t samples) {
+    return samples / kSamplesPerMs;
+  }
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_PIPELINE_CONFIG_H_
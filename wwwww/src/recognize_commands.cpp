@@ -30,6 +30,14 @@ RecognizeCommands::RecognizeCommands(tflite::ErrorReporter* error_reporter,
       previous_results_(error_reporter) {
   previous_top_label_ = "silence";
   previous_top_label_time_ = std::numeric_limits<int32_t>::min();
+  if (average_window_duration_ms_ > PreviousResultsQueue::kMaxAverageWindowMs) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Averaging window of %d ms is over the %d ms the "
+                         "results queue holds, using that instead",
+                         average_window_duration_ms,
+                         PreviousResultsQueue::kMaxAverageWindowMs);
+    average_window_duration_ms_ = PreviousResultsQueue::kMaxAverageWindowMs;
+  }
 }
 
 TfLiteStatus RecognizeCommands::ProcessLatestResults(
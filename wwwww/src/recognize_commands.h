@@ -30,6 +30,14 @@ limitations under the License.
 // there are hard limits on the number of results it can store.
 class PreviousResultsQueue {
  public:
+  // Longest averaging window a RecognizeCommands can keep every result of
+  // when the model runs on every stride.
+  static constexpr int32_t kMaxAverageWindowMs = 1000;
+  // A result every stride over the window holds both of its ends, and the
+  // newest one is pushed before the oldest is dropped, so 52 at 20ms strides.
+  static constexpr int kMaxResults =
+      kMaxAverageWindowMs / kFeatureSliceStrideMs + 2;
+
   PreviousResultsQueue(tflite::ErrorReporter* error_reporter)
       : error_reporter_(error_reporter), front_index_(0), size_(0) {}
 
@@ -101,7 +109,6 @@ class PreviousResultsQueue {
 
  private:
   tflite::ErrorReporter* error_reporter_;
-  static constexpr int kMaxResults = 50;
   Result results_[kMaxResults];
 
   int front_index_;
@@ -129,12 +136,14 @@ class RecognizeCommands {
   // average. This prevents erroneous results when the averaging window is
   // initially being populated for example. The suppression argument disables
   // further recognitions for a set time after one has been triggered, which can
-  // help reduce spurious recognitions.
-  explicit RecognizeCommands(tflite::ErrorReporter* error_reporter,
-                             int32_t average_window_duration_ms = 1000,
-                             uint8_t detection_threshold = 200,
-                             int32_t suppression_ms = 1500,
-                             int32_t minimum_count = 3);
+  // help reduce spurious recognitions. Windows longer than
+  // PreviousResultsQueue::kMaxAverageWindowMs are shortened to it.
+  explicit RecognizeCommands(
+      tflite::ErrorReporter* error_reporter,
+      int32_t average_window_duration_ms =
+          PreviousResultsQueue::kMaxAverageWindowMs,
+      uint8_t detection_threshold = 200, int32_t suppression_ms = 1500,
+      int32_t minimum_count = 3);
 
   // Call this with the results of running a model on sample data.
   TfLiteStatus ProcessLatestResults(const TfLiteTensor* latest_results,
@@ -0,0 +1,183 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_RING_BUFFER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_RING_BUFFER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+
+#include "ring_stats.h"
+
+// Readable region of a ring, handed out without copying. It's split in two
+// when it wraps around the end of the storage, otherwise `second_size` is zero.
+template <typename T>
+struct RingSpan {
+  T* first;
+  uint32_t first_size;
+  T* second;
+  uint32_t second_size;
+  uint32_t size() const { return first_size + second_size; }
+};
+
+// Single-producer, single-consumer queue of `N` elements of type `T`, for
+// sample or event queues between two tasks. The capacity has to be a power of
+// two, so positions wrap with a mask instead of pointer range checks, and all
+// counts are in elements rather than bytes.
+// The read and write positions are free-running 32-bit counters that are only
+// ever advanced by the consumer and the producer respectively, so neither side
+// takes a lock. Nothing here blocks or allocates, which keeps the class usable
+// both on the device and on the host; callers that need to wait for data layer
+// that on top.
+template <typename T, uint32_t N>
+class RingBuffer {
+ public:
+  static_assert(N > 0 && (N & (N - 1)) == 0,
+                "RingBuffer capacity must be a power of two");
+  static_assert(N <= (1u << 31), "RingBuffer capacity is too large");
+
+  typedef RingSpan<T> Span;
+
+  RingBuffer() : write_index_(0), read_index_(0) {}
+
+  static constexpr uint32_t capacity() { return N; }
+
+  // Producer side.
+
+  // Number of elements that can be written without overwriting unread ones.
+  uint32_t available() const {
+    const uint32_t filled = write_index_.load(std::memory_order_relaxed) -
+                            read_index_.load(std::memory_order_acquire);
+    return filled >= N ? 0 : N - filled;
+  }
+
+  // Copies as many of `count` elements as fit and returns how many that was.
+  uint32_t Write(const T* data, uint32_t count) {
+    const uint32_t space = available();
+    if (count > space) {
+      count = space;
+    }
+    const uint32_t write = write_index_.load(std::memory_order_relaxed);
+    CopyIn(write, data, count);
+    write_index_.store(write + count, std::memory_order_release);
+    return count;
+  }
+
+  // Exposes up to `count` free elements to be filled in place, for elements
+  // that are expensive to build elsewhere and copy in. The consumer can't see
+  // them until they're published with Commit().
+  Span Reserve(uint32_t count) {
+    const uint32_t space = available();
+    if (count > space) {
+      count = space;
+    }
+    const uint32_t start =
+        write_index_.load(std::memory_order_relaxed) & (N - 1);
+    Span span;
+    span.first = &buffer_[start];
+    span.first_size = (count > N - start) ? N - start : count;
+    span.second = buffer_;
+    span.second_size = count - span.first_size;
+    return span;
+  }
+
+  // Publishes the first `count` elements of a region obtained with Reserve().
+  void Commit(uint32_t count) {
+    const uint32_t write = write_index_.load(std::memory_order_relaxed);
+    write_index_.store(write + count, std::memory_order_release);
+  }
+
+  // Consumer side.
+
+  // Number of elements that are ready to be read.
+  uint32_t size() const {
+    return write_index_.load(std::memory_order_acquire) -
+           read_index_.load(std::memory_order_relaxed);
+  }
+
+  // Exposes up to `count` of the oldest unread elements without copying or
+  // consuming them. They stay in place until released with Consume().
+  Span Peek(uint32_t count) {
+    const uint32_t filled = size();
+    stats_.peak_fill.Max(filled);
+    if (count > filled) {
+      count = filled;
+    }
+    const uint32_t start =
+        read_index_.load(std::memory_order_relaxed) & (N - 1);
+    Span span;
+    span.first = &buffer_[start];
+    span.first_size = (count > N - start) ? N - start : count;
+    span.second = buffer_;
+    span.second_size = count - span.first_size;
+    return span;
+  }
+
+  // Releases the first `count - keep` elements of a region obtained with
+  // Peek(), so the last `keep` elements start the next one. Returns the number
+  // of elements released.
+  uint32_t Consume(uint32_t count, uint32_t keep = 0) {
+    if (keep > count) {
+      return 0;
+    }
+    const uint32_t read = read_index_.load(std::memory_order_relaxed);
+    const uint32_t filled = size();
+    uint32_t release = count - keep;
+    if (release > filled) {
+      release = filled;
+    }
+    stats_.elements_read.Add(release);
+    read_index_.store(read + release, std::memory_order_release);
+    return release;
+  }
+
+  // Copies up to `count` elements out and consumes them.
+  uint32_t Read(T* data, uint32_t count) {
+    const Span span = Peek(count);
+    memcpy(data, span.first, span.first_size * sizeof(T));
+    memcpy(data + span.first_size, span.second, span.second_size * sizeof(T));
+    return Consume(span.size());
+  }
+
+  // Usage counters, safe to read from any task.
+  const RingStats& stats() const { return stats_; }
+
+  // Total number of elements written so far, wrapping at 2^32.
+  uint32_t total_written() const {
+    return write_index_.load(std::memory_order_relaxed);
+  }
+
+  // Drops everything that's currently unread.
+  void Reset() {
+    read_index_.store(write_index_.load(std::memory_order_acquire),
+                      std::memory_order_release);
+  }
+
+ private:
+  void CopyIn(uint32_t position, const T* data, uint32_t count) {
+    const uint32_t start = position & (N - 1);
+    const uint32_t first_size = (count > N - start) ? N - start : count;
+    memcpy(&buffer_[start], data, first_size * sizeof(T));
+    memcpy(buffer_, data + first_size, (count - first_size) * sizeof(T));
+  }
+
+  T buffer_[N];
+  std::atomic<uint32_t> write_index_;
+  std::atomic<uint32_t> read_index_;
+  RingStats stats_;
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_RING_BUFFER_H_
@@ -0,0 +1,91 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_RING_STATS_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_RING_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+
+// Counter that one task updates and any other task can sample at any time
+// without a lock. Copying it copies the current value, so it can live inside
+// copyable objects like ring buffer readers.
+class RelaxedCounter {
+ public:
+  RelaxedCounter() : value_(0) {}
+  RelaxedCounter(const RelaxedCounter& other) : value_(other.value()) {}
+  RelaxedCounter& operator=(const RelaxedCounter& other) {
+    value_.store(other.value(), std::memory_order_relaxed);
+    return *this;
+  }
+
+  uint32_t value() const { return value_.load(std::memory_order_relaxed); }
+
+  // Only the owning task may call these.
+  void Add(uint32_t amount) {
+    value_.store(value() + amount, std::memory_order_relaxed);
+  }
+  void Max(uint32_t candidate) {
+    if (candidate > value()) {
+      value_.store(candidate, std::memory_order_relaxed);
+    }
+  }
+  void Set(uint32_t value) { value_.store(value, std::memory_order_relaxed); }
+  void Reset() { Set(0); }
+
+ private:
+  std::atomic<uint32_t> value_;
+};
+
+// Usage counters kept by every ring buffer reader. They are cheap enough to
+// leave on all the time, and tell how much of the ring is actually needed and
+// whether the reader keeps up.
+struct RingStats {
+  // Highest number of unread elements seen when reading.
+  RelaxedCounter peak_fill;
+  // Elements handed to the reader and released by it.
+  RelaxedCounter elements_read;
+  // Elements overwritten before the reader got to them, or while it was
+  // looking at them, which only happens to readers of a BroadcastBuffer.
+  RelaxedCounter elements_lost;
+};
+
+// Histogram of how long a task spent blocked, in power-of-two buckets of
+// microseconds. Bucket 0 counts waits under 1us, bucket i counts waits from
+// 2^(i-1) up to 2^i us, and the last bucket also counts anything longer.
+// Like RelaxedCounter, only one task may record but any task may read.
+class WaitHistogram {
+ public:
+  static constexpr int kBucketCount = 20;
+
+  void Record(uint32_t wait_us) {
+    int bucket = 0;
+    while (wait_us != 0 && bucket < kBucketCount - 1) {
+      wait_us >>= 1;
+      ++bucket;
+    }
+    buckets_[bucket].Add(1);
+  }
+
+  uint32_t bucket(int index) const { return buckets_[index].value(); }
+
+  // Upper bound of a bucket in microseconds, for printing.
+  static uint32_t bucket_limit_us(int index) { return 1u << index; }
+
+ private:
+  RelaxedCounter buckets_[kBucketCount];
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_RING_STATS_H_
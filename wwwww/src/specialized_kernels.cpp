@@ -0,0 +1,249 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "specialized_kernels.h"
+
+#include "tensorflow/lite/c/builtin_op_data.h"
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/kernel_util.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/micro/kernels/kernel_util.h"
+
+namespace {
+
+constexpr int kInputTensor = 0;
+constexpr int kFilterTensor = 1;
+constexpr int kBiasTensor = 2;
+constexpr int kOutputTensor = 0;
+
+// The kernels of the base resolver, which run the nodes the specialized ones
+// weren't compiled for.
+const TfLiteRegistration* g_base_depthwise_conv = nullptr;
+const TfLiteRegistration* g_base_fully_connected = nullptr;
+
+struct DepthwiseConvOpData {
+  // Whether the node runs on the base kernel, with its own data.
+  bool use_base;
+  void* base_data;
+  ModelDepthwiseConv::Params params;
+};
+
+struct FullyConnectedOpData {
+  bool use_base;
+  void* base_data;
+  ModelFullyConnected::Params params;
+};
+
+bool HasDims(const TfLiteIntArray* dims, const int* expected, int count) {
+  if (dims == nullptr || dims->size != count) {
+    return false;
+  }
+  for (int i = 0; i < count; ++i) {
+    if (dims->data[i] != expected[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int ElementCount(const TfLiteIntArray* dims) {
+  int count = 1;
+  for (int i = 0; i < dims->size; ++i) {
+    count *= dims->data[i];
+  }
+  return count;
+}
+
+void* DepthwiseConvInit(TfLiteContext* context, const char* buffer,
+                        size_t length) {
+  auto* data = static_cast<DepthwiseConvOpData*>(
+      context->AllocatePersistentBuffer(context, sizeof(DepthwiseConvOpData)));
+  if (data != nullptr) {
+    data->use_base = false;
+    data->base_data = g_base_depthwise_conv->init(context, buffer, length);
+  }
+  return data;
+}
+
+// Whether the node is the one ModelDepthwiseConv was compiled for.
+bool IsModelDepthwiseConv(const TfLiteDepthwiseConvParams* params,
+                          const TfLiteTensor* input, const TfLiteTensor* filter,
+                          const TfLiteTensor* output) {
+  typedef ModelDepthwiseConv Kernel;
+  const int input_dims[] = {1, Kernel::kInputHeight, Kernel::kInputWidth,
+                            Kernel::kInputChannels};
+  const int filter_dims[] = {1, Kernel::kFilterHeight, Kernel::kFilterWidth,
+                             Kernel::kOutputChannels};
+  const int output_dims[] = {1, Kernel::kOutputHeight, Kernel::kOutputWidth,
+                             Kernel::kOutputChannels};
+  if (input->type != kTfLiteInt8 || filter->type != kTfLiteInt8 ||
+      output->type != kTfLiteInt8 || !HasDims(input->dims, input_dims, 4) ||
+      !HasDims(filter->dims, filter_dims, 4) ||
+      !HasDims(output->dims, output_dims, 4) ||
+      filter->quantization.type != kTfLiteAffineQuantization ||
+      params->depth_multiplier != Kernel::kDepthMultiplier ||
+      params->stride_height != Kernel::kStrideHeight ||
+      params->stride_width != Kernel::kStrideWidth ||
+      params->dilation_height_factor != 1 ||
+      params->dilation_width_factor != 1) {
+    return false;
+  }
+  int output_height;
+  int output_width;
+  const TfLitePaddingValues padding = tflite::ComputePaddingHeightWidth(
+      params->stride_height, params->stride_width, 1, 1, Kernel::kInputHeight,
+      Kernel::kInputWidth, Kernel::kFilterHeight, Kernel::kFilterWidth,
+      params->padding, &output_height, &output_width);
+  return padding.height == Kernel::kPadTop && padding.width == Kernel::kPadLeft;
+}
+
+TfLiteStatus DepthwiseConvPrepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<DepthwiseConvOpData*>(node->user_data);
+  const auto* params =
+      static_cast<const TfLiteDepthwiseConvParams*>(node->builtin_data);
+  const TfLiteTensor* input = tflite::GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = tflite::GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias =
+      tflite::GetOptionalInputTensor(context, node, kBiasTensor);
+  TfLiteTensor* output = tflite::GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE(context, input != nullptr && filter != nullptr &&
+                              output != nullptr);
+  if (!IsModelDepthwiseConv(params, input, filter, output)) {
+    data->use_base = true;
+    return CallBaseKernel(g_base_depthwise_conv->prepare, context, node,
+                          data->base_data);
+  }
+
+  ModelDepthwiseConv::Params* kernel_params = &data->params;
+  int32_t unused_multiplier;
+  int unused_shift;
+  TF_LITE_ENSURE_STATUS(tflite::PopulateConvolutionQuantizationParams(
+      context, input, filter, bias, output, params->activation,
+      &unused_multiplier, &unused_shift, &kernel_params->activation_min,
+      &kernel_params->activation_max, kernel_params->multipliers,
+      reinterpret_cast<int*>(kernel_params->shifts),
+      ModelDepthwiseConv::kOutputChannels));
+  kernel_params->input_offset = -input->params.zero_point;
+  kernel_params->output_offset = output->params.zero_point;
+  ModelDepthwiseConv::Prepare(
+      filter->data.int8, (bias != nullptr) ? bias->data.i32 : nullptr,
+      kernel_params);
+  return kTfLiteOk;
+}
+
+TfLiteStatus DepthwiseConvEval(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<DepthwiseConvOpData*>(node->user_data);
+  if (data->use_base) {
+    return CallBaseKernel(g_base_depthwise_conv->invoke, context, node,
+                          data->base_data);
+  }
+  ModelDepthwiseConv::Run(
+      data->params,
+      tflite::micro::GetTensorData<int8_t>(
+          tflite::micro::GetEvalInput(context, node, kInputTensor)),
+      tflite::micro::GetTensorData<int8_t>(
+          tflite::micro::GetEvalInput(context, node, kFilterTensor)),
+      tflite::micro::GetTensorData<int8_t>(
+          tflite::micro::GetEvalOutput(context, node, kOutputTensor)));
+  return kTfLiteOk;
+}
+
+void* FullyConnectedInit(TfLiteContext* context, const char* buffer,
+                         size_t length) {
+  auto* data = static_cast<FullyConnectedOpData*>(
+      context->AllocatePersistentBuffer(context, sizeof(FullyConnectedOpData)));
+  if (data != nullptr) {
+    data->use_base = false;
+    data->base_data = g_base_fully_connected->init(context, buffer, length);
+  }
+  return data;
+}
+
+TfLiteStatus FullyConnectedPrepare(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<FullyConnectedOpData*>(node->user_data);
+  const auto* params =
+      static_cast<const TfLiteFullyConnectedParams*>(node->builtin_data);
+  const TfLiteTensor* input = tflite::GetInput(context, node, kInputTensor);
+  const TfLiteTensor* filter = tflite::GetInput(context, node, kFilterTensor);
+  const TfLiteTensor* bias =
+      tflite::GetOptionalInputTensor(context, node, kBiasTensor);
+  TfLiteTensor* output = tflite::GetOutput(context, node, kOutputTensor);
+  TF_LITE_ENSURE(context, input != nullptr && filter != nullptr &&
+                              output != nullptr);
+  const int filter_dims[] = {ModelFullyConnected::kOutputDepth,
+                             ModelFullyConnected::kAccumDepth};
+  if (input->type != kTfLiteInt8 || filter->type != kTfLiteInt8 ||
+      output->type != kTfLiteInt8 ||
+      ElementCount(input->dims) != filter_dims[1] ||
+      !HasDims(filter->dims, filter_dims, 2) ||
+      ElementCount(output->dims) != ModelFullyConnected::kOutputDepth ||
+      filter->params.zero_point != 0) {
+    data->use_base = true;
+    return CallBaseKernel(g_base_fully_connected->prepare, context, node,
+                          data->base_data);
+  }
+
+  ModelFullyConnected::Params* kernel_params = &data->params;
+  double real_multiplier = 0.0;
+  TF_LITE_ENSURE_STATUS(tflite::GetQuantizedConvolutionMultipler(
+      context, input, filter, bias, output, &real_multiplier));
+  int shift;
+  tflite::QuantizeMultiplier(real_multiplier, &kernel_params->multiplier,
+                             &shift);
+  kernel_params->shift = shift;
+  TF_LITE_ENSURE_STATUS(tflite::CalculateActivationRangeQuantized(
+      context, params->activation, output, &kernel_params->activation_min,
+      &kernel_params->activation_max));
+  kernel_params->input_offset = -input->params.zero_point;
+  kernel_params->output_offset = output->params.zero_point;
+  ModelFullyConnected::Prepare(
+      filter->data.int8, (bias != nullptr) ? bias->data.i32 : nullptr,
+      kernel_params);
+  return kTfLiteOk;
+}
+
+TfLiteStatus FullyConnectedEval(TfLiteContext* context, TfLiteNode* node) {
+  auto* data = static_cast<FullyConnectedOpData*>(node->user_data);
+  if (data->use_base) {
+    return CallBaseKernel(g_base_fully_connected->invoke, context, node,
+                          data->base_data);
+  }
+  ModelFullyConnected::Run(
+      data->params,
+      tflite::micro::GetTensorData<int8_t>(
+          tflite::micro::GetEvalInput(context, node, kInputTensor)),
+      tflite::micro::GetTensorData<int8_t>(
+          tflite::micro::GetEvalInput(context, node, kFilterTensor)),
+      tflite::micro::GetTensorData<int8_t>(
+          tflite::micro::GetEvalOutput(context, node, kOutputTensor)));
+  return kTfLiteOk;
+}
+
+const WrappingOpResolver::KernelFunctions kDepthwiseConvFunctions = {
+    DepthwiseConvInit, DepthwiseConvPrepare, DepthwiseConvEval};
+const WrappingOpResolver::KernelFunctions kFullyConnectedFunctions = {
+    FullyConnectedInit, FullyConnectedPrepare, FullyConnectedEval};
+
+}  // namespace
+
+SpecializedOpResolver::SpecializedOpResolver(
+    const tflite::MicroOpResolver* base)
+    : WrappingOpResolver(base, kDepthwiseConvFunctions,
+                         kFullyConnectedFunctions) {
+  g_base_depthwise_conv =
+      base->FindOp(tflite::BuiltinOperator_DEPTHWISE_CONV_2D);
+  g_base_fully_connected =
+      base->FindOp(tflite::BuiltinOperator_FULLY_CONNECTED);
+}
@@ -0,0 +1,268 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_SPECIALIZED_KERNELS_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_SPECIALIZED_KERNELS_H_
+
+#include <cstdint>
+
+#include "micro_model_settings.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/kernels/internal/common.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "wrapping_op_resolver.h"
+
+// Output size and padding before the first element of one dimension of a
+// convolution, worked out like tflite::ComputePaddingHeightWidth() does for
+// SAME and VALID padding without dilation.
+constexpr int SameOutputSize(int input, int stride) {
+  return (input + stride - 1) / stride;
+}
+constexpr int ValidOutputSize(int input, int filter, int stride) {
+  return (input - filter + stride) / stride;
+}
+constexpr int PaddingBefore(int input, int filter, int stride, int output) {
+  return ((output - 1) * stride + filter - input) / 2 > 0
+             ? ((output - 1) * stride + filter - input) / 2
+             : 0;
+}
+
+// Int8 depthwise convolution for one fixed shape, NHWC with a single image,
+// SAME or VALID padding given as `PadTop` and `PadLeft` and no dilation.
+// With every dimension known at compile time the loops unroll, and the
+// per-channel accumulators live in registers. Outputs whose receptive field is
+// inside the image start from a bias that already has the input offset times
+// the filter sum folded in, so their inner loop is a plain int8 product. The
+// outputs along the edges skip the padding like the reference kernel does.
+// The integer math is the reference kernel's, so the results are the same.
+template <int InputHeight, int InputWidth, int InputChannels, int FilterHeight,
+          int FilterWidth, int DepthMultiplier, int StrideHeight,
+          int StrideWidth, int PadTop, int PadLeft, int OutputHeight,
+          int OutputWidth>
+struct DepthwiseConvKernel {
+  // The output shape and the padding follow from the rest, so a typo in any
+  // of them can't slip through.
+  static_assert(
+      (OutputHeight == SameOutputSize(InputHeight, StrideHeight) &&
+       OutputWidth == SameOutputSize(InputWidth, StrideWidth) &&
+       PadTop == PaddingBefore(InputHeight, FilterHeight, StrideHeight,
+                               OutputHeight) &&
+       PadLeft == PaddingBefore(InputWidth, FilterWidth, StrideWidth,
+                                OutputWidth)) ||
+          (OutputHeight ==
+               ValidOutputSize(InputHeight, FilterHeight, StrideHeight) &&
+           OutputWidth ==
+               ValidOutputSize(InputWidth, FilterWidth, StrideWidth) &&
+           PadTop == 0 && PadLeft == 0),
+      "The output shape and padding don't match SAME or VALID padding");
+
+  static constexpr int kInputHeight = InputHeight;
+  static constexpr int kInputWidth = InputWidth;
+  static constexpr int kInputChannels = InputChannels;
+  static constexpr int kFilterHeight = FilterHeight;
+  static constexpr int kFilterWidth = FilterWidth;
+  static constexpr int kDepthMultiplier = DepthMultiplier;
+  static constexpr int kStrideHeight = StrideHeight;
+  static constexpr int kStrideWidth = StrideWidth;
+  static constexpr int kPadTop = PadTop;
+  static constexpr int kPadLeft = PadLeft;
+  static constexpr int kOutputHeight = OutputHeight;
+  static constexpr int kOutputWidth = OutputWidth;
+  static constexpr int kOutputChannels = InputChannels * DepthMultiplier;
+
+  // Everything the kernel needs besides the tensors, set once by Prepare().
+  struct Params {
+    int32_t input_offset;
+    int32_t output_offset;
+    int32_t activation_min;
+    int32_t activation_max;
+    int32_t multipliers[kOutputChannels];
+    int32_t shifts[kOutputChannels];
+    int32_t biases[kOutputChannels];
+    int32_t folded_biases[kOutputChannels];
+  };
+
+  // Fills in the biases of `params`, whose other fields have to be set
+  // already. `bias` may be nullptr.
+  static void Prepare(const int8_t* filter, const int32_t* bias,
+                      Params* params) {
+    for (int channel = 0; channel < kOutputChannels; ++channel) {
+      int32_t filter_sum = 0;
+      for (int i = 0; i < FilterHeight * FilterWidth; ++i) {
+        filter_sum += filter[i * kOutputChannels + channel];
+      }
+      params->biases[channel] = (bias != nullptr) ? bias[channel] : 0;
+      params->folded_biases[channel] =
+          params->biases[channel] + params->input_offset * filter_sum;
+    }
+  }
+
+  static void Run(const Params& params, const int8_t* input,
+                  const int8_t* filter, int8_t* output) {
+    for (int out_y = 0; out_y < OutputHeight; ++out_y) {
+      const int in_y_origin = out_y * StrideHeight - PadTop;
+      const bool is_row_inside =
+          in_y_origin >= 0 && in_y_origin + FilterHeight <= InputHeight;
+      for (int out_x = 0; out_x < OutputWidth; ++out_x) {
+        const int in_x_origin = out_x * StrideWidth - PadLeft;
+        const bool is_inside = is_row_inside && in_x_origin >= 0 &&
+                               in_x_origin + FilterWidth <= InputWidth;
+        for (int in_channel = 0; in_channel < InputChannels; ++in_channel) {
+          const int first_channel = in_channel * DepthMultiplier;
+          int32_t acc[DepthMultiplier];
+          if (is_inside) {
+            for (int m = 0; m < DepthMultiplier; ++m) {
+              acc[m] = params.folded_biases[first_channel + m];
+            }
+            for (int filter_y = 0; filter_y < FilterHeight; ++filter_y) {
+              const int8_t* input_row =
+                  input + ((in_y_origin + filter_y) * InputWidth +
+                           in_x_origin) * InputChannels + in_channel;
+              const int8_t* filter_row = filter +
+                                         filter_y * FilterWidth *
+                                             kOutputChannels +
+                                         first_channel;
+              for (int filter_x = 0; filter_x < FilterWidth; ++filter_x) {
+                const int32_t value = input_row[filter_x * InputChannels];
+                const int8_t* weights = filter_row + filter_x * kOutputChannels;
+                for (int m = 0; m < DepthMultiplier; ++m) {
+                  acc[m] += value * weights[m];
+                }
+              }
+            }
+          } else {
+            for (int m = 0; m < DepthMultiplier; ++m) {
+              acc[m] = params.biases[first_channel + m];
+            }
+            for (int filter_y = 0; filter_y < FilterHeight; ++filter_y) {
+              const int in_y = in_y_origin + filter_y;
+              if (in_y < 0 || in_y >= InputHeight) {
+                continue;
+              }
+              for (int filter_x = 0; filter_x < FilterWidth; ++filter_x) {
+                const int in_x = in_x_origin + filter_x;
+                if (in_x < 0 || in_x >= InputWidth) {
+                  continue;
+                }
+                const int32_t value =
+                    input[(in_y * InputWidth + in_x) * InputChannels +
+                          in_channel] +
+                    params.input_offset;
+                const int8_t* weights =
+                    filter + (filter_y * FilterWidth + filter_x) *
+                                 kOutputChannels +
+                    first_channel;
+                for (int m = 0; m < DepthMultiplier; ++m) {
+                  acc[m] += value * weights[m];
+                }
+              }
+            }
+          }
+          int8_t* out = output +
+                        (out_y * OutputWidth + out_x) * kOutputChannels +
+                        first_channel;
+          for (int m = 0; m < DepthMultiplier; ++m) {
+            int32_t result = tflite::MultiplyByQuantizedMultiplier(
+                acc[m], params.multipliers[first_channel + m],
+                params.shifts[first_channel + m]);
+            result += params.output_offset;
+            result = result < params.activation_min ? params.activation_min
+                                                    : result;
+            result = result > params.activation_max ? params.activation_max
+                                                    : result;
+            out[m] = static_cast<int8_t>(result);
+          }
+        }
+      }
+    }
+  }
+};
+
+// Int8 fully connected layer for one fixed shape with a single batch and
+// symmetric weights, as int8 models have them. The input offset times each
+// row's weight sum is folded into its bias, leaving a plain int8 dot product
+// per output, over a compile-time length.
+template <int AccumDepth, int OutputDepth>
+struct FullyConnectedKernel {
+  static constexpr int kAccumDepth = AccumDepth;
+  static constexpr int kOutputDepth = OutputDepth;
+
+  struct Params {
+    int32_t input_offset;
+    int32_t output_offset;
+    int32_t multiplier;
+    int32_t shift;
+    int32_t activation_min;
+    int32_t activation_max;
+    int32_t folded_biases[OutputDepth];
+  };
+
+  // Fills in the biases of `params`, whose other fields have to be set
+  // already. `bias` may be nullptr.
+  static void Prepare(const int8_t* weights, const int32_t* bias,
+                      Params* params) {
+    for (int out = 0; out < OutputDepth; ++out) {
+      int32_t weight_sum = 0;
+      for (int i = 0; i < AccumDepth; ++i) {
+        weight_sum += weights[out * AccumDepth + i];
+      }
+      params->folded_biases[out] = ((bias != nullptr) ? bias[out] : 0) +
+                                   params->input_offset * weight_sum;
+    }
+  }
+
+  static void Run(const Params& params, const int8_t* input,
+                  const int8_t* weights, int8_t* output) {
+    for (int out = 0; out < OutputDepth; ++out) {
+      const int8_t* row = weights + out * AccumDepth;
+      int32_t acc = params.folded_biases[out];
+      for (int i = 0; i < AccumDepth; ++i) {
+        acc += input[i] * row[i];
+      }
+      int32_t result = tflite::MultiplyByQuantizedMultiplier(
+          acc, params.multiplier, params.shift);
+      result += params.output_offset;
+      result =
+          result < params.activation_min ? params.activation_min : result;
+      result =
+          result > params.activation_max ? params.activation_max : result;
+      output[out] = static_cast<int8_t>(result);
+    }
+  }
+};
+
+// The layers of g_model. Prepare() checks every node against these, and any
+// that doesn't match, after the model changed, runs on the kernel the
+// specialized one replaces.
+typedef DepthwiseConvKernel<kFeatureSliceCount, kFeatureSliceSize, 1, 10, 8, 8,
+                            2, 2, 4, 3, 25, 20>
+    ModelDepthwiseConv;
+typedef FullyConnectedKernel<ModelDepthwiseConv::kOutputHeight *
+                                 ModelDepthwiseConv::kOutputWidth *
+                                 ModelDepthwiseConv::kOutputChannels,
+                             kCategoryCount>
+    ModelFullyConnected;
+
+// Resolves ops like `base`, except that DepthwiseConv2D and FullyConnected
+// run on the kernels specialized for g_model above, wherever a node has the
+// shape they were compiled for.
+class SpecializedOpResolver : public WrappingOpResolver {
+ public:
+  // `base` has to outlive this, and have every op of the model registered.
+  explicit SpecializedOpResolver(const tflite::MicroOpResolver* base);
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_SPECIALIZED_KERNELS_H_
@@ -0,0 +1,59 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "speech_gate.h"
+
+namespace {
+
+// The floor moves 1/256 of the way up to a higher score every slice, a time
+// constant of about five seconds: long enough to sit through a word, short
+// enough to adapt to a fan being switched on.
+constexpr int kFloorRiseShift = 8;
+
+// Highest score a slice can have, which the floor starts from.
+constexpr int kMaxScore = 255;
+
+}  // namespace
+
+SpeechGate::SpeechGate()
+    : floor_q8_(kMaxScore << 8), last_score_(0), hold_slices_(kHoldSlices) {}
+
+bool SpeechGate::Update(const int8_t* features, int new_slices) {
+  if (new_slices > kFeatureSliceCount) {
+    new_slices = kFeatureSliceCount;
+  }
+  const int8_t* slice =
+      features + (kFeatureSliceCount - new_slices) * kFeatureSliceSize;
+  for (int i = 0; i < new_slices; ++i, slice += kFeatureSliceSize) {
+    int32_t sum = 0;
+    for (int j = 0; j < kFeatureSliceSize; ++j) {
+      sum += slice[j];
+    }
+    // Features start at -128, so the mean is shifted up to start at zero.
+    const int score = sum / kFeatureSliceSize + 128;
+    last_score_ = score;
+    if ((score << 8) < floor_q8_) {
+      floor_q8_ = score << 8;
+    } else {
+      floor_q8_ += ((score << 8) - floor_q8_) >> kFloorRiseShift;
+    }
+    if (score > floor() + kOpenMargin) {
+      hold_slices_ = kHoldSlices;
+    } else if (hold_slices_ > 0) {
+      --hold_slices_;
+    }
+  }
+  return hold_slices_ > 0;
+}
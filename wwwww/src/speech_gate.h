@@ -0,0 +1,66 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_SPEECH_GATE_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_SPEECH_GATE_H_
+
+#include <cstdint>
+
+#include "micro_model_settings.h"
+
+// First stage of a two-stage cascade, which screens every window so the model
+// only runs on the ones that may hold a word.
+// Its score for a slice is a linear function of the spectrogram, the mean of
+// its channels above the lowest feature value. With the frontend's noise
+// reduction that sits near zero in silence and well above it in speech, so
+// the weights are all the same rather than fitted to a corpus. The score is
+// compared against a floor that follows it down at once and up slowly, to
+// ride out noise the frontend lets through.
+// A slice that clears the floor by kOpenMargin opens the gate for as long as
+// the slice stays in the window, so the model sees every word all the way
+// through. The gate has no tensors of its own: it reads the new slices of the
+// same spectrogram the model runs on, a few dozen additions per slice.
+class SpeechGate {
+ public:
+  // Score above the floor, on the 0 to 255 scale of the features, that counts
+  // as sound. Lower values let quieter words through, and more noise: after
+  // the frontend's noise reduction a quiet room scores between about 10 and
+  // 30 from slice to slice, words 85 and up.
+  static constexpr int kOpenMargin = 32;
+  // Slices the gate stays open after the last one that cleared the margin.
+  static constexpr int kHoldSlices = kFeatureSliceCount;
+
+  // Starts out open, with a floor set by the first slice.
+  SpeechGate();
+
+  // Scores the last `new_slices` slices of `features`, a whole spectrogram
+  // oldest slice first in the layout the model takes, and returns whether
+  // the model should run on it. Has to see every window, even those the model
+  // won't run on, to keep up with the floor.
+  bool Update(const int8_t* features, int new_slices);
+
+  // Score of the newest slice, and the floor it was compared against.
+  int last_score() const { return last_score_; }
+  int floor() const { return floor_q8_ >> 8; }
+
+ private:
+  // Floor, with 8 fractional bits so it can rise by less than one per slice.
+  int32_t floor_q8_;
+  int last_score_;
+  // Slices left before the gate closes.
+  int hold_slices_;
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_SPEECH_GATE_H_
@@ -0,0 +1,557 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "streaming_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "tensorflow/lite/kernels/internal/quantization_util.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/reference/softmax.h"
+#include "tensorflow/lite/kernels/padding.h"
+#include "tensorflow/lite/schema/schema_utils.h"
+
+namespace {
+
+// Stream positions start over before they could overflow, which at one slice
+// per stride takes more than a year.
+constexpr int32_t kMaxWindowPosition = INT32_MAX - 2 * kFeatureSliceCount;
+
+// Same as the interpreter's softmax kernel.
+constexpr int kSoftmaxScaledDiffIntegerBits = 5;
+
+// Where each layer sits in the graph, which is also the op index the
+// interpreter reports to its profiler.
+constexpr int kReshapeOp = 0;
+constexpr int kConvOp = 1;
+constexpr int kFullyConnectedOp = 2;
+constexpr int kSoftmaxOp = 3;
+
+const tflite::Tensor* GetTensor(const tflite::SubGraph* subgraph, int index) {
+  if (index < 0 || index >= static_cast<int>(subgraph->tensors()->size())) {
+    return nullptr;
+  }
+  return subgraph->tensors()->Get(index);
+}
+
+// Constant data of `tensor`, which stays in the model, or nullptr if it has
+// none or isn't of type `type`.
+template <typename T>
+const T* GetConstantData(const tflite::Model* model,
+                         const tflite::Tensor* tensor,
+                         tflite::TensorType type) {
+  if (tensor == nullptr || tensor->type() != type ||
+      tensor->buffer() >= model->buffers()->size()) {
+    return nullptr;
+  }
+  const tflite::Buffer* buffer = model->buffers()->Get(tensor->buffer());
+  if (buffer == nullptr || buffer->data() == nullptr ||
+      buffer->data()->size() == 0) {
+    return nullptr;
+  }
+  return reinterpret_cast<const T*>(buffer->data()->data());
+}
+
+bool HasShape(const tflite::Tensor* tensor, const int* dims, int dims_count) {
+  if (tensor == nullptr || tensor->shape() == nullptr ||
+      static_cast<int>(tensor->shape()->size()) != dims_count) {
+    return false;
+  }
+  for (int i = 0; i < dims_count; ++i) {
+    if (tensor->shape()->Get(i) != dims[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether `tensor` is quantized, with per-tensor parameters unless
+// `channels` allows one scale per channel.
+bool HasQuantization(const tflite::Tensor* tensor, int channels = 1) {
+  if (tensor == nullptr || tensor->quantization() == nullptr) {
+    return false;
+  }
+  const auto* scale = tensor->quantization()->scale();
+  const auto* zero_point = tensor->quantization()->zero_point();
+  if (scale == nullptr || zero_point == nullptr || scale->size() == 0 ||
+      zero_point->size() == 0) {
+    return false;
+  }
+  return scale->size() == 1 || static_cast<int>(scale->size()) == channels;
+}
+
+float Scale(const tflite::Tensor* tensor, int channel = 0) {
+  const auto* scale = tensor->quantization()->scale();
+  return scale->Get(scale->size() == 1 ? 0 : channel);
+}
+
+int32_t ZeroPoint(const tflite::Tensor* tensor) {
+  return static_cast<int32_t>(tensor->quantization()->zero_point()->Get(0));
+}
+
+// CalculateActivationRangeQuantized() for an int8 output, which needs a
+// TfLiteContext.
+bool CalculateActivationRange(tflite::ActivationFunctionType activation,
+                              const tflite::Tensor* output, int32_t* min,
+                              int32_t* max) {
+  const float scale = Scale(output);
+  const int32_t zero_point = ZeroPoint(output);
+  auto quantize = [scale, zero_point](float value) {
+    return zero_point + static_cast<int32_t>(std::round(value / scale));
+  };
+  *min = INT8_MIN;
+  *max = INT8_MAX;
+  switch (activation) {
+    case tflite::ActivationFunctionType_NONE:
+      return true;
+    case tflite::ActivationFunctionType_RELU:
+      *min = std::max(*min, quantize(0.0f));
+      return true;
+    case tflite::ActivationFunctionType_RELU6:
+      *min = std::max(*min, quantize(0.0f));
+      *max = std::min(*max, quantize(6.0f));
+      return true;
+    case tflite::ActivationFunctionType_RELU_N1_TO_1:
+      *min = std::max(*min, quantize(-1.0f));
+      *max = std::min(*max, quantize(1.0f));
+      return true;
+    default:
+      return false;
+  }
+}
+
+// The operator at `index` if it's a `code` one, otherwise nullptr.
+const tflite::Operator* GetOperator(const tflite::Model* model,
+                                    const tflite::SubGraph* subgraph,
+                                    int index, tflite::BuiltinOperator code) {
+  const tflite::Operator* op = subgraph->operators()->Get(index);
+  if (op->opcode_index() >= model->operator_codes()->size() ||
+      tflite::GetBuiltinCode(model->operator_codes()->Get(
+          op->opcode_index())) != code) {
+    return nullptr;
+  }
+  return op;
+}
+
+}  // namespace
+
+StreamingModel::StreamingModel(int8_t* scratch, int scratch_size,
+                               tflite::Profiler* profiler)
+    : scratch_(scratch),
+      scratch_size_(scratch_size),
+      profiler_(profiler),
+      conv_params_(),
+      conv_filter_(nullptr),
+      conv_bias_(nullptr),
+      filter_height_(0),
+      filter_width_(0),
+      receptive_height_(0),
+      padding_top_(0),
+      input_height_(0),
+      input_width_(0),
+      conv_output_height_(0),
+      conv_output_width_(0),
+      conv_channels_(0),
+      conv_row_size_(0),
+      first_cached_row_(0),
+      last_cached_row_(-1),
+      row_cache_(nullptr),
+      row_cache_size_(0),
+      window_position_(0),
+      conv_output_(nullptr),
+      rows_computed_(0),
+      fc_params_(),
+      fc_weights_(nullptr),
+      fc_bias_(nullptr),
+      softmax_params_(),
+      output_(),
+      is_initialized_(false) {}
+
+TfLiteStatus StreamingModel::Initialize(tflite::ErrorReporter* error_reporter,
+                                        const tflite::Model* model) {
+  is_initialized_ = false;
+
+  // Reshape, DepthwiseConv2D, FullyConnected and Softmax, each one feeding
+  // the next.
+  if (model->subgraphs() == nullptr || model->subgraphs()->size() != 1) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming needs a model with one subgraph");
+    return kTfLiteError;
+  }
+  const tflite::SubGraph* subgraph = model->subgraphs()->Get(0);
+  if (subgraph->operators() == nullptr ||
+      subgraph->operators()->size() != 4 || subgraph->inputs()->size() != 1 ||
+      subgraph->outputs()->size() != 1) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming needs a model with four operators");
+    return kTfLiteError;
+  }
+  const tflite::Operator* reshape = GetOperator(
+      model, subgraph, kReshapeOp, tflite::BuiltinOperator_RESHAPE);
+  const tflite::Operator* conv = GetOperator(
+      model, subgraph, kConvOp, tflite::BuiltinOperator_DEPTHWISE_CONV_2D);
+  const tflite::Operator* fc =
+      GetOperator(model, subgraph, kFullyConnectedOp,
+                  tflite::BuiltinOperator_FULLY_CONNECTED);
+  const tflite::Operator* softmax = GetOperator(
+      model, subgraph, kSoftmaxOp, tflite::BuiltinOperator_SOFTMAX);
+  if (reshape == nullptr || conv == nullptr || fc == nullptr ||
+      softmax == nullptr || conv->inputs()->size() < 3 ||
+      fc->inputs()->size() < 3 ||
+      reshape->inputs()->Get(0) != subgraph->inputs()->Get(0) ||
+      conv->inputs()->Get(0) != reshape->outputs()->Get(0) ||
+      fc->inputs()->Get(0) != conv->outputs()->Get(0) ||
+      softmax->inputs()->Get(0) != fc->outputs()->Get(0) ||
+      softmax->outputs()->Get(0) != subgraph->outputs()->Get(0)) {
+    TF_LITE_REPORT_ERROR(
+        error_reporter,
+        "Streaming needs a Reshape, DepthwiseConv2D, FullyConnected and "
+        "Softmax chain");
+    return kTfLiteError;
+  }
+
+  // The spectrogram, as an image one slice per row.
+  const tflite::Tensor* input = GetTensor(subgraph, conv->inputs()->Get(0));
+  const int input_dims[4] = {1, kFeatureSliceCount, kFeatureSliceSize, 1};
+  if (!HasShape(input, input_dims, 4) ||
+      input->type() != tflite::TensorType_INT8 || !HasQuantization(input)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming needs a %dx%d int8 spectrogram",
+                         kFeatureSliceCount, kFeatureSliceSize);
+    return kTfLiteError;
+  }
+  input_height_ = kFeatureSliceCount;
+  input_width_ = kFeatureSliceSize;
+
+  // Convolution.
+  const tflite::DepthwiseConv2DOptions* conv_options =
+      conv->builtin_options_as_DepthwiseConv2DOptions();
+  const tflite::Tensor* filter = GetTensor(subgraph, conv->inputs()->Get(1));
+  const tflite::Tensor* bias = GetTensor(subgraph, conv->inputs()->Get(2));
+  const tflite::Tensor* conv_output =
+      GetTensor(subgraph, conv->outputs()->Get(0));
+  conv_filter_ =
+      GetConstantData<int8_t>(model, filter, tflite::TensorType_INT8);
+  conv_bias_ = GetConstantData<int32_t>(model, bias, tflite::TensorType_INT32);
+  if (conv_options == nullptr || conv_filter_ == nullptr ||
+      conv_bias_ == nullptr || filter->shape()->size() != 4 ||
+      conv_output == nullptr ||
+      conv_output->type() != tflite::TensorType_INT8 ||
+      !HasQuantization(conv_output)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming needs an int8 DepthwiseConv2D with bias");
+    return kTfLiteError;
+  }
+  filter_height_ = filter->shape()->Get(1);
+  filter_width_ = filter->shape()->Get(2);
+  conv_channels_ = filter->shape()->Get(3);
+  if (conv_channels_ != conv_options->depth_multiplier() ||
+      conv_channels_ > kMaxConvChannels ||
+      !HasQuantization(filter, conv_channels_) ||
+      !HasShape(bias, &conv_channels_, 1)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming supports up to %d depthwise channels",
+                         kMaxConvChannels);
+    return kTfLiteError;
+  }
+
+  const int stride_height = conv_options->stride_h();
+  const int dilation_height = conv_options->dilation_h_factor();
+  const TfLitePadding padding = conv_options->padding() == tflite::Padding_SAME
+                                    ? kTfLitePaddingSame
+                                    : kTfLitePaddingValid;
+  const TfLitePaddingValues padding_values = tflite::ComputePaddingHeightWidth(
+      stride_height, conv_options->stride_w(), dilation_height,
+      conv_options->dilation_w_factor(), input_height_, input_width_,
+      filter_height_, filter_width_, padding, &conv_output_height_,
+      &conv_output_width_);
+  const int conv_output_dims[4] = {1, conv_output_height_, conv_output_width_,
+                                   conv_channels_};
+  if (!HasShape(conv_output, conv_output_dims, 4)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Unexpected DepthwiseConv2D output shape");
+    return kTfLiteError;
+  }
+  padding_top_ = padding_values.height;
+  receptive_height_ = (filter_height_ - 1) * dilation_height + 1;
+  conv_row_size_ = conv_output_width_ * conv_channels_;
+
+  conv_params_.padding_type = padding == kTfLitePaddingSame
+                                  ? tflite::PaddingType::kSame
+                                  : tflite::PaddingType::kValid;
+  conv_params_.padding_values.width = padding_values.width;
+  conv_params_.padding_values.height = padding_top_;
+  conv_params_.stride_width = conv_options->stride_w();
+  conv_params_.stride_height = stride_height;
+  conv_params_.dilation_width_factor = conv_options->dilation_w_factor();
+  conv_params_.dilation_height_factor = dilation_height;
+  conv_params_.depth_multiplier = conv_options->depth_multiplier();
+  conv_params_.input_offset = -ZeroPoint(input);
+  conv_params_.weights_offset = 0;
+  conv_params_.output_offset = ZeroPoint(conv_output);
+  if (!CalculateActivationRange(conv_options->fused_activation_function(),
+                                conv_output,
+                                &conv_params_.quantized_activation_min,
+                                &conv_params_.quantized_activation_max)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Unsupported DepthwiseConv2D activation");
+    return kTfLiteError;
+  }
+  // Like PopulateConvolutionQuantizationParams().
+  for (int c = 0; c < conv_channels_; ++c) {
+    const double effective_scale = static_cast<double>(Scale(input)) *
+                                   static_cast<double>(Scale(filter, c)) /
+                                   static_cast<double>(Scale(conv_output));
+    int shift;
+    tflite::QuantizeMultiplier(effective_scale, &conv_multipliers_[c], &shift);
+    conv_shifts_[c] = shift;
+  }
+
+  // Output rows from first_cached_row_ to last_cached_row_ only see slices
+  // of the spectrogram, so they can be cached. If there are none, the whole
+  // convolution is computed every time, as the top rows.
+  first_cached_row_ = (padding_top_ + stride_height - 1) / stride_height;
+  last_cached_row_ =
+      (input_height_ - receptive_height_ + padding_top_) / stride_height;
+  if (last_cached_row_ >= conv_output_height_) {
+    last_cached_row_ = conv_output_height_ - 1;
+  }
+  if (receptive_height_ > input_height_ ||
+      first_cached_row_ > last_cached_row_) {
+    first_cached_row_ = conv_output_height_;
+    last_cached_row_ = conv_output_height_ - 1;
+    row_cache_size_ = 0;
+  } else {
+    // One entry for every first slice a cached row can have.
+    row_cache_size_ =
+        (last_cached_row_ - first_cached_row_) * stride_height + 1;
+  }
+  const int scratch_needed =
+      (row_cache_size_ + conv_output_height_) * conv_row_size_;
+  if (scratch_needed > scratch_size_) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming needs %d bytes of scratch, only %d given",
+                         scratch_needed, scratch_size_);
+    return kTfLiteError;
+  }
+  row_cache_ = scratch_;
+  conv_output_ = scratch_ + row_cache_size_ * conv_row_size_;
+
+  // Fully connected layer.
+  const tflite::FullyConnectedOptions* fc_options =
+      fc->builtin_options_as_FullyConnectedOptions();
+  const tflite::Tensor* weights = GetTensor(subgraph, fc->inputs()->Get(1));
+  const tflite::Tensor* fc_bias = GetTensor(subgraph, fc->inputs()->Get(2));
+  const tflite::Tensor* fc_output = GetTensor(subgraph, fc->outputs()->Get(0));
+  const int weights_dims[2] = {kCategoryCount,
+                               conv_output_height_ * conv_row_size_};
+  const int category_count = kCategoryCount;
+  const int output_dims[2] = {1, kCategoryCount};
+  fc_weights_ =
+      GetConstantData<int8_t>(model, weights, tflite::TensorType_INT8);
+  fc_bias_ =
+      GetConstantData<int32_t>(model, fc_bias, tflite::TensorType_INT32);
+  if (fc_options == nullptr || fc_weights_ == nullptr ||
+      fc_bias_ == nullptr || !HasShape(weights, weights_dims, 2) ||
+      !HasShape(fc_bias, &category_count, 1) ||
+      !HasShape(fc_output, output_dims, 2) ||
+      fc_output->type() != tflite::TensorType_INT8 ||
+      !HasQuantization(weights) || !HasQuantization(fc_output)) {
+    TF_LITE_REPORT_ERROR(
+        error_reporter,
+        "Streaming needs an int8 FullyConnected to %d categories with bias",
+        kCategoryCount);
+    return kTfLiteError;
+  }
+  // Like the interpreter's FullyConnected kernel.
+  const double fc_scale = static_cast<double>(Scale(conv_output)) *
+                          static_cast<double>(Scale(weights)) /
+                          static_cast<double>(Scale(fc_output));
+  int fc_shift;
+  tflite::QuantizeMultiplier(fc_scale, &fc_params_.output_multiplier,
+                             &fc_shift);
+  fc_params_.output_shift = fc_shift;
+  fc_params_.input_offset = -ZeroPoint(conv_output);
+  fc_params_.weights_offset = -ZeroPoint(weights);
+  fc_params_.output_offset = ZeroPoint(fc_output);
+  if (!CalculateActivationRange(fc_options->fused_activation_function(),
+                                fc_output,
+                                &fc_params_.quantized_activation_min,
+                                &fc_params_.quantized_activation_max)) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Unsupported FullyConnected activation");
+    return kTfLiteError;
+  }
+
+  // Softmax, which only comes as int8 with this output quantization.
+  const tflite::SoftmaxOptions* softmax_options =
+      softmax->builtin_options_as_SoftmaxOptions();
+  const tflite::Tensor* scores =
+      GetTensor(subgraph, softmax->outputs()->Get(0));
+  if (softmax_options == nullptr || !HasShape(scores, output_dims, 2) ||
+      scores->type() != tflite::TensorType_INT8 || !HasQuantization(scores) ||
+      ZeroPoint(scores) != -128 || Scale(scores) != 1.0f / 256) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming needs an int8 Softmax scaled by 1/256");
+    return kTfLiteError;
+  }
+  int input_left_shift;
+  tflite::PreprocessSoftmaxScaling(
+      static_cast<double>(softmax_options->beta()),
+      static_cast<double>(Scale(fc_output)), kSoftmaxScaledDiffIntegerBits,
+      &softmax_params_.input_multiplier, &input_left_shift);
+  softmax_params_.input_left_shift = input_left_shift;
+  softmax_params_.diff_min = -1.0 * tflite::CalculateInputRadius(
+                                        kSoftmaxScaledDiffIntegerBits,
+                                        softmax_params_.input_left_shift);
+
+  // The scores go out as a tensor, so they can be handled like the ones from
+  // the interpreter.
+  output_dims_[0] = 2;
+  output_dims_[1] = 1;
+  output_dims_[2] = kCategoryCount;
+  output_.type = kTfLiteInt8;
+  output_.dims = reinterpret_cast<TfLiteIntArray*>(output_dims_);
+  output_.data.int8 = scores_;
+  output_.bytes = kCategoryCount;
+  output_.params.scale = Scale(scores);
+  output_.params.zero_point = ZeroPoint(scores);
+
+  for (int i = 0; i < kFeatureSliceCount; ++i) {
+    cached_positions_[i] = -1;
+  }
+  window_position_ = 0;
+  is_initialized_ = true;
+  return kTfLiteOk;
+}
+
+void StreamingModel::ConvolveRows(const int8_t* features, int input_row,
+                                  int input_height, int padding_height,
+                                  int output_height, int8_t* output) {
+  tflite::DepthwiseParams params = conv_params_;
+  params.padding_values.height = padding_height;
+  const int32_t input_dims[4] = {1, input_height, input_width_, 1};
+  const int32_t filter_dims[4] = {1, filter_height_, filter_width_,
+                                  conv_channels_};
+  const int32_t bias_dims[1] = {conv_channels_};
+  const int32_t output_dims[4] = {1, output_height, conv_output_width_,
+                                  conv_channels_};
+  tflite::reference_integer_ops::DepthwiseConvPerChannel(
+      params, conv_multipliers_, conv_shifts_,
+      tflite::RuntimeShape(4, input_dims),
+      features + input_row * input_width_,
+      tflite::RuntimeShape(4, filter_dims), conv_filter_,
+      tflite::RuntimeShape(1, bias_dims), conv_bias_,
+      tflite::RuntimeShape(4, output_dims), output);
+}
+
+TfLiteStatus StreamingModel::Invoke(const int8_t* features, int new_slices) {
+  if (!is_initialized_) {
+    return kTfLiteError;
+  }
+  if (new_slices >= input_height_ ||
+      window_position_ > kMaxWindowPosition - new_slices) {
+    // Nothing cached is part of this window.
+    for (int i = 0; i < row_cache_size_; ++i) {
+      cached_positions_[i] = -1;
+    }
+    window_position_ = 0;
+  } else {
+    window_position_ += new_slices;
+  }
+  rows_computed_ = 0;
+
+  {
+    // The spectrogram already is the image the convolution reads, so the
+    // reshape costs nothing here. It's still reported, like the interpreter
+    // does, since profilers count invocations by the first op.
+    tflite::ScopedOperatorProfile profile(
+        profiler_, tflite::EnumNameBuiltinOperator(
+                       tflite::BuiltinOperator_RESHAPE),
+        kReshapeOp);
+  }
+
+  {
+    tflite::ScopedOperatorProfile profile(
+        profiler_, tflite::EnumNameBuiltinOperator(
+                       tflite::BuiltinOperator_DEPTHWISE_CONV_2D),
+        kConvOp);
+    // Rows that reach into the padding before the oldest slice, which moves
+    // every time.
+    if (first_cached_row_ > 0) {
+      ConvolveRows(features, 0, input_height_, padding_top_, first_cached_row_,
+                   conv_output_);
+      rows_computed_ += first_cached_row_;
+    }
+
+    // Rows that are only made of slices come out of the ring, and the ones
+    // that aren't there yet go into it. In steady state that's one row per new
+    // slice at most, the ones that end at the newest slices.
+    const int stride_height = conv_params_.stride_height;
+    for (int row = first_cached_row_; row <= last_cached_row_; ++row) {
+      const int input_row = row * stride_height - padding_top_;
+      const int32_t position = window_position_ + input_row;
+      const int slot = position % row_cache_size_;
+      int8_t* cached = row_cache_ + slot * conv_row_size_;
+      if (cached_positions_[slot] != position) {
+        ConvolveRows(features, input_row, receptive_height_, 0, 1, cached);
+        cached_positions_[slot] = position;
+        ++rows_computed_;
+      }
+      memcpy(conv_output_ + row * conv_row_size_, cached, conv_row_size_);
+    }
+
+    // Rows that reach into the padding after the newest slice.
+    const int bottom_row = last_cached_row_ + 1;
+    if (bottom_row < conv_output_height_) {
+      const int input_row = bottom_row * stride_height - padding_top_;
+      ConvolveRows(features, input_row, input_height_ - input_row, 0,
+                   conv_output_height_ - bottom_row,
+                   conv_output_ + bottom_row * conv_row_size_);
+      rows_computed_ += conv_output_height_ - bottom_row;
+    }
+  }
+
+  const int32_t conv_output_dims[4] = {1, conv_output_height_,
+                                       conv_output_width_, conv_channels_};
+  const int32_t weights_dims[2] = {kCategoryCount,
+                                   conv_output_height_ * conv_row_size_};
+  const int32_t category_count = kCategoryCount;
+  const int32_t output_dims[2] = {1, kCategoryCount};
+  {
+    tflite::ScopedOperatorProfile profile(
+        profiler_, tflite::EnumNameBuiltinOperator(
+                       tflite::BuiltinOperator_FULLY_CONNECTED),
+        kFullyConnectedOp);
+    tflite::reference_integer_ops::FullyConnected(
+        fc_params_, tflite::RuntimeShape(4, conv_output_dims), conv_output_,
+        tflite::RuntimeShape(2, weights_dims), fc_weights_,
+        tflite::RuntimeShape(1, &category_count), fc_bias_,
+        tflite::RuntimeShape(2, output_dims), logits_);
+  }
+  {
+    tflite::ScopedOperatorProfile profile(
+        profiler_,
+        tflite::EnumNameBuiltinOperator(tflite::BuiltinOperator_SOFTMAX),
+        kSoftmaxOp);
+    tflite::reference_ops::Softmax(
+        softmax_params_, tflite::RuntimeShape(2, output_dims), logits_,
+        tflite::RuntimeShape(2, output_dims), scores_);
+  }
+  return kTfLiteOk;
+}
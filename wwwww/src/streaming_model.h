@@ -0,0 +1,134 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_STREAMING_MODEL_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_STREAMING_MODEL_H_
+
+#include <cstdint>
+
+#include "micro_model_settings.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/core/api/profiler.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+// Runs models of the micro_speech family, a reshape of the spectrogram into
+// an image, one int8 depthwise convolution, a fully connected layer and a
+// softmax, one stride at a time instead of over the whole window.
+// Between two strides the spectrogram only scrolls by the slices that came
+// in, so most rows of the convolution output only move up. Every row whose
+// receptive field is inside the spectrogram is computed once, when its last
+// slice arrives, and kept in a ring keyed by the position of its first slice
+// in the stream. Only the few rows that reach into the padding at either end
+// are computed again for every window, since what they see of the spectrogram
+// changes each time. The fully connected layer and the softmax then run on
+// the assembled convolution output as usual.
+// All of it goes through the same reference kernels the interpreter uses, with
+// parameters derived from the model exactly like the interpreter derives them,
+// so the results match a full Invoke() bit for bit, see
+// CompareStreamingInference(). Each layer is reported to the profiler under
+// the same tag and op index the interpreter uses, so an OpProfiler times both
+// the same way.
+class StreamingModel {
+ public:
+  // Binds the model to `scratch`, which holds the cached convolution rows and
+  // has to outlive it. The size needed depends on the model, Initialize()
+  // reports it when there isn't enough. `profiler` can be nullptr.
+  StreamingModel(int8_t* scratch, int scratch_size,
+                 tflite::Profiler* profiler);
+
+  // Reads the layers and their parameters out of `model`, or fails if its
+  // graph isn't one this class knows how to stream.
+  TfLiteStatus Initialize(tflite::ErrorReporter* error_reporter,
+                          const tflite::Model* model);
+
+  // Runs the model on `features`, a whole spectrogram oldest slice first, of
+  // which only the last `new_slices` changed since the previous call. Any
+  // count from kFeatureSliceCount up starts over from scratch.
+  TfLiteStatus Invoke(const int8_t* features, int new_slices);
+
+  // Scores of the last Invoke(), shaped like the output tensor of the model.
+  const TfLiteTensor* output() const { return &output_; }
+
+  // Output of the fully connected layer, before the softmax.
+  const int8_t* logits() const { return logits_; }
+
+  // Convolution rows computed by the last Invoke(), out of conv_height().
+  int rows_computed() const { return rows_computed_; }
+  int conv_height() const { return conv_output_height_; }
+
+ private:
+  // Wide enough for the depthwise filters of any model in the family.
+  static constexpr int kMaxConvChannels = 32;
+
+  // Runs the convolution over `input_height` rows of `features` starting at
+  // `input_row`, into `output_height` rows of `output`.
+  void ConvolveRows(const int8_t* features, int input_row, int input_height,
+                    int padding_height, int output_height, int8_t* output);
+
+  int8_t* scratch_;
+  int scratch_size_;
+  tflite::Profiler* profiler_;
+
+  // Convolution.
+  tflite::DepthwiseParams conv_params_;
+  int32_t conv_multipliers_[kMaxConvChannels];
+  int32_t conv_shifts_[kMaxConvChannels];
+  const int8_t* conv_filter_;
+  const int32_t* conv_bias_;
+  int filter_height_;
+  int filter_width_;
+  // Input rows each output row depends on, with the dilation.
+  int receptive_height_;
+  int padding_top_;
+  int input_height_;
+  int input_width_;
+  int conv_output_height_;
+  int conv_output_width_;
+  int conv_channels_;
+  int conv_row_size_;
+  // Output rows [first_cached_row_, last_cached_row_] only ever see real
+  // slices, the others reach into the padding.
+  int first_cached_row_;
+  int last_cached_row_;
+
+  // Ring of cached rows, in the scratch memory, and the stream position of
+  // the first slice each one was computed from, or -1.
+  int8_t* row_cache_;
+  int row_cache_size_;
+  int32_t cached_positions_[kFeatureSliceCount];
+  // Stream position of the oldest slice in the current window.
+  int32_t window_position_;
+  // The whole convolution output, in the scratch memory after the ring.
+  int8_t* conv_output_;
+  int rows_computed_;
+
+  // Fully connected layer.
+  tflite::FullyConnectedParams fc_params_;
+  const int8_t* fc_weights_;
+  const int32_t* fc_bias_;
+  int8_t logits_[kCategoryCount];
+
+  // Softmax.
+  tflite::SoftmaxParams softmax_params_;
+  int8_t scores_[kCategoryCount];
+  int output_dims_[3];
+  TfLiteTensor output_;
+
+  bool is_initialized_;
+};
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_STREAMING_MODEL_H_
@@ -0,0 +1,134 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "streaming_model_check.h"
+
+#include <cstring>
+
+#include "micro_model_settings.h"
+#include "no_micro_features_data.h"
+#include "xtensa/hal.h"
+#include "yes_micro_features_data.h"
+
+namespace {
+
+// Slice `position` of an endless spectrogram that alternates between the "yes"
+// and the "no" samples, so windows catch both words and the changes between
+// them.
+const int8_t* StreamSlice(int position) {
+  const int sample_slice = position % (2 * kFeatureSliceCount);
+  const signed char* sample = g_yes_micro_f2e59fea_nohash_1_data;
+  if (sample_slice >= kFeatureSliceCount) {
+    sample = g_no_micro_f9643d42_nohash_4_data;
+  }
+  return reinterpret_cast<const int8_t*>(sample) +
+         (sample_slice % kFeatureSliceCount) * kFeatureSliceSize;
+}
+
+// Slices the stream moves by before window `index`: usually one, every so
+// often a few when windows were dropped, and now and then a whole window
+// after lost audio.
+int SlicesBeforeWindow(int index) {
+  if (index == 0 || (index % 61) == 30) {
+    return kFeatureSliceCount;
+  }
+  if ((index % 11) == 5) {
+    return 3;
+  }
+  if ((index % 7) == 3) {
+    return 2;
+  }
+  return 1;
+}
+
+}  // namespace
+
+TfLiteStatus CompareStreamingInference(tflite::ErrorReporter* error_reporter,
+                                       const tflite::Model* model,
+                                       tflite::MicroInterpreter* interpreter,
+                                       StreamingModel* streaming_model,
+                                       int window_count) {
+  // The interpreter keeps the logits in the input tensor of the softmax,
+  // which is still intact after Invoke() since nothing runs after it.
+  const tflite::SubGraph* subgraph = model->subgraphs()->Get(0);
+  const tflite::Operator* last_op =
+      subgraph->operators()->Get(subgraph->operators()->size() - 1);
+  const TfLiteTensor* interpreter_logits =
+      interpreter->tensor(last_op->inputs()->Get(0));
+  const TfLiteTensor* interpreter_scores = interpreter->output(0);
+  int8_t* input = interpreter->input(0)->data.int8;
+
+  uint64_t full_cycles = 0;
+  uint64_t streaming_cycles = 0;
+  int rows_computed = 0;
+  int differing_windows = 0;
+  int position = 0;
+  for (int i = 0; i < window_count; ++i) {
+    const int new_slices = SlicesBeforeWindow(i);
+    position += new_slices;
+    for (int slice = 0; slice < kFeatureSliceCount; ++slice) {
+      memcpy(input + slice * kFeatureSliceSize,
+             StreamSlice(position - kFeatureSliceCount + slice),
+             kFeatureSliceSize);
+    }
+
+    uint32_t start = xthal_get_ccount();
+    if (streaming_model->Invoke(input, new_slices) != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Streaming Invoke() failed");
+      return kTfLiteError;
+    }
+    streaming_cycles += xthal_get_ccount() - start;
+    rows_computed += streaming_model->rows_computed();
+    start = xthal_get_ccount();
+    if (interpreter->Invoke() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke() failed");
+      return kTfLiteError;
+    }
+    full_cycles += xthal_get_ccount() - start;
+
+    if (memcmp(streaming_model->logits(), interpreter_logits->data.int8,
+               kCategoryCount) != 0 ||
+        memcmp(streaming_model->output()->data.int8,
+               interpreter_scores->data.int8, kCategoryCount) != 0) {
+      if (differing_windows == 0) {
+        const int8_t* logits = streaming_model->logits();
+        const int8_t* expected = interpreter_logits->data.int8;
+        TF_LITE_REPORT_ERROR(error_reporter,
+                             "Window %d: streaming logits %d %d %d %d, "
+                             "interpreter %d %d %d %d",
+                             i, logits[0], logits[1], logits[2], logits[3],
+                             expected[0], expected[1], expected[2],
+                             expected[3]);
+      }
+      ++differing_windows;
+    }
+  }
+
+  TF_LITE_REPORT_ERROR(error_reporter,
+                       "Inference: full window %d cycles, streaming %d "
+                       "cycles with %d of %d convolution rows, %d of %d "
+                       "windows differ",
+                       static_cast<int>(full_cycles / window_count),
+                       static_cast<int>(streaming_cycles / window_count),
+                       rows_computed / window_count,
+                       streaming_model->conv_height(), differing_windows,
+                       window_count);
+  if (differing_windows > 0) {
+    TF_LITE_REPORT_ERROR(error_reporter,
+                         "Streaming inference doesn't match the interpreter");
+    return kTfLiteError;
+  }
+  return kTfLiteOk;
+}
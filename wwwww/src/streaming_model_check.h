@@ -0,0 +1,36 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_STREAMING_MODEL_CHECK_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_STREAMING_MODEL_CHECK_H_
+
+#include "streaming_model.h"
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+// Feeds `window_count` windows of a spectrogram that scrolls like the live
+// one, mostly a slice at a time with the odd skip and restart, through
+// `streaming_model` and through `interpreter` running `model` on the whole
+// window. Fails unless the logits and the scores of both match exactly on
+// every window, and reports the cycles each takes.
+TfLiteStatus CompareStreamingInference(tflite::ErrorReporter* error_reporter,
+                                       const tflite::Model* model,
+                                       tflite::MicroInterpreter* interpreter,
+                                       StreamingModel* streaming_model,
+                                       int window_count);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_STREAMING_MODEL_CHECK_H_
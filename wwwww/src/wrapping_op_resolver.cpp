@@ -0,0 +1,84 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#include "wrapping_op_resolver.h"
+
+namespace {
+
+// The kernel of `base` for `op` with `functions` in place of its own, or
+// false if `base` has none.
+bool Wrap(const tflite::MicroOpResolver* base, tflite::BuiltinOperator op,
+          const WrappingOpResolver::KernelFunctions& functions,
+          TfLiteRegistration* registration) {
+  const TfLiteRegistration* base_registration = base->FindOp(op);
+  if (base_registration == nullptr) {
+    return false;
+  }
+  *registration = *base_registration;
+  registration->init = functions.init;
+  registration->prepare = functions.prepare;
+  registration->invoke = functions.invoke;
+  return true;
+}
+
+}  // namespace
+
+WrappingOpResolver::WrappingOpResolver(
+    const tflite::MicroOpResolver* base,
+    const KernelFunctions& depthwise_conv,
+    const KernelFunctions& fully_connected)
+    : base_(base),
+      has_depthwise_conv_(false),
+      has_fully_connected_(false),
+      depthwise_conv_(),
+      fully_connected_() {
+  has_depthwise_conv_ =
+      Wrap(base, tflite::BuiltinOperator_DEPTHWISE_CONV_2D, depthwise_conv,
+           &depthwise_conv_);
+  has_fully_connected_ =
+      Wrap(base, tflite::BuiltinOperator_FULLY_CONNECTED, fully_connected,
+           &fully_connected_);
+}
+
+const TfLiteRegistration* WrappingOpResolver::FindOp(
+    tflite::BuiltinOperator op) const {
+  if (op == tflite::BuiltinOperator_DEPTHWISE_CONV_2D && has_depthwise_conv_) {
+    return &depthwise_conv_;
+  }
+  if (op == tflite::BuiltinOperator_FULLY_CONNECTED && has_fully_connected_) {
+    return &fully_connected_;
+  }
+  return base_->FindOp(op);
+}
+
+const TfLiteRegistration* WrappingOpResolver::FindOp(const char* op) const {
+  return base_->FindOp(op);
+}
+
+tflite::MicroOpResolver::BuiltinParseFunction
+WrappingOpResolver::GetOpDataParser(tflite::BuiltinOperator op) const {
+  return base_->GetOpDataParser(op);
+}
+
+TfLiteStatus CallBaseKernel(TfLiteStatus (*function)(TfLiteContext*,
+                                                      TfLiteNode*),
+                            TfLiteContext* context, TfLiteNode* node,
+                            void* base_data) {
+  void* data = node->user_data;
+  node->user_data = base_data;
+  const TfLiteStatus status = function(context, node);
+  node->user_data = data;
+  return status;
+}
@@ -0,0 +1,63 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_WRAPPING_OP_RESOLVER_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_WRAPPING_OP_RESOLVER_H_
+
+#include <cstddef>
+
+#include "tensorflow/lite/c/common.h"
+#include "tensorflow/lite/micro/micro_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+// Resolves ops like `base`, except that DepthwiseConv2D and FullyConnected
+// run on other kernels, which can hand any node they don't support back to
+// the kernel of `base` with CallBaseKernel(). The options are parsed, and the
+// kernels freed, like `base` does it. Ops `base` doesn't have stay missing.
+class WrappingOpResolver : public tflite::MicroOpResolver {
+ public:
+  // What replaces the init, prepare and invoke functions of a kernel.
+  struct KernelFunctions {
+    void* (*init)(TfLiteContext* context, const char* buffer, size_t length);
+    TfLiteStatus (*prepare)(TfLiteContext* context, TfLiteNode* node);
+    TfLiteStatus (*invoke)(TfLiteContext* context, TfLiteNode* node);
+  };
+
+  // `base` has to outlive this, and have every op of the model registered.
+  WrappingOpResolver(const tflite::MicroOpResolver* base,
+                     const KernelFunctions& depthwise_conv,
+                     const KernelFunctions& fully_connected);
+
+  const TfLiteRegistration* FindOp(tflite::BuiltinOperator op) const override;
+  const TfLiteRegistration* FindOp(const char* op) const override;
+  BuiltinParseFunction GetOpDataParser(
+      tflite::BuiltinOperator op) const override;
+
+ private:
+  const tflite::MicroOpResolver* base_;
+  bool has_depthwise_conv_;
+  bool has_fully_connected_;
+  TfLiteRegistration depthwise_conv_;
+  TfLiteRegistration fully_connected_;
+};
+
+// Runs `function` of a kernel of the base resolver with the node's user data
+// switched to `base_data`, what the base kernel's init returned.
+TfLiteStatus CallBaseKernel(TfLiteStatus (*function)(TfLiteContext*,
+                                                      TfLiteNode*),
+                            TfLiteContext* context, TfLiteNode* node,
+                            void* base_data);
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_WRAPPING_OP_RESOLVER_H_
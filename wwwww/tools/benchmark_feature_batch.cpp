@@ -0,0 +1,182 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that times the batched feature path FeatureProvider takes now,
+// one GenerateFeaturesBatch() call for all the slices that are due, against
+// the per-slice path it replaced, one GenerateFeatures() call per 30ms window,
+// for 1, 5 and 49 slices at a time. Both run over the same synthetic audio
+// with the batch's audio split in two like a span of the capture ring, and
+// have to produce the same features. It needs the microfrontend library and
+// kissfft from the same TensorFlow Lite Micro release the device uses:
+//
+//   MF=<tflite-micro>/tensorflow/lite/experimental/microfrontend/lib
+//   g++ -std=c++11 -O2 -I tools/host -I src -I <tflite-micro> -I <kissfft>
+//       tools/benchmark_feature_batch.cpp src/micro_features_generator.cpp
+//       src/fft_backend.cpp src/frontend_stages.cpp src/frontend_tables.cpp
+//       src/micro_model_settings.cpp $MF/*.c $MF/*.cc
+//       -o /tmp/benchmark_feature_batch
+//   /tmp/benchmark_feature_batch
+//
+// It exits with a nonzero status if the two paths disagree.
+
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "micro_features_generator.h"
+#include "micro_model_settings.h"
+#include "pipeline_config.h"
+#include "ring_buffer.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+namespace {
+
+constexpr int kWindowSamples = ModelPipelineConfig::kWindowSamples;
+constexpr int kStrideSamples = ModelPipelineConfig::kStrideSamples;
+constexpr int kHistorySamples = ModelPipelineConfig::kHistorySamples;
+// Enough audio for 40 full spectrograms, which every batch size divides.
+constexpr int kSliceCount = 40 * kFeatureSliceCount;
+constexpr int kAudioSamples = kHistorySamples + kSliceCount * kStrideSamples;
+constexpr int kPassCount = 20;
+constexpr int kBatchSizes[] = {1, 5, kFeatureSliceCount};
+constexpr float kPi = 3.14159265f;
+
+int16_t g_audio[kAudioSamples];
+int8_t g_per_slice_features[kSliceCount * kFeatureSliceSize];
+int8_t g_batched_features[kSliceCount * kFeatureSliceSize];
+MicroFrontendWorkspace g_per_slice_workspace;
+MicroFrontendWorkspace g_batched_workspace;
+
+// Same chirp over noise as fft_benchmark.cpp feeds the FFT backends.
+int16_t SyntheticSample(int index) {
+  const float t = static_cast<float>(index % kAudioSampleFrequency) /
+                  kAudioSampleFrequency;
+  const float phase = 2.0f * kPi * (100.0f * t + 0.5f * 7400.0f * t * t);
+  const float level =
+      0.01f * powf(100.0f, 0.5f + 0.5f * sinf(2.0f * kPi * 3.0f * t));
+  const uint32_t noise = static_cast<uint32_t>(index) * 1664525u + 1013904223u;
+  const float value = level * sinf(phase) +
+                      0.002f * (static_cast<int32_t>(noise >> 16) - 32768) /
+                          32768.0f;
+  return static_cast<int16_t>(value * 32767.0f);
+}
+
+// The old FeatureProvider loop: each slice gets its own 30ms window, the first
+// 10ms of which the frontend already holds from the one before. The batch
+// size makes no difference to it.
+TfLiteStatus RunPerSlice(tflite::ErrorReporter* error_reporter,
+                         MicroFrontend* frontend, int /* batch_size */) {
+  for (int slice = 0; slice < kSliceCount; ++slice) {
+    size_t num_samples_read;
+    TF_LITE_ENSURE_STATUS(frontend->GenerateFeatures(
+        error_reporter, g_audio + slice * kStrideSamples, kWindowSamples,
+        kFeatureSliceSize, g_per_slice_features + slice * kFeatureSliceSize,
+        &num_samples_read));
+  }
+  return kTfLiteOk;
+}
+
+// FeatureProvider now: `batch_size` slices at a time from one span of audio,
+// split in two partway through like a span that wraps around the capture
+// ring.
+TfLiteStatus RunBatched(tflite::ErrorReporter* error_reporter,
+                        MicroFrontend* frontend, int batch_size) {
+  for (int slice = 0; slice < kSliceCount; slice += batch_size) {
+    const uint32_t span_samples = kHistorySamples + batch_size * kStrideSamples;
+    const uint32_t split = span_samples / 3;
+    RingSpan<int16_t> audio;
+    audio.first = g_audio + slice * kStrideSamples;
+    audio.first_size = split;
+    audio.second = audio.first + split;
+    audio.second_size = span_samples - split;
+    RingSpan<int8_t> rows;
+    rows.first = g_batched_features + slice * kFeatureSliceSize;
+    rows.first_size = batch_size * kFeatureSliceSize;
+    rows.second = nullptr;
+    rows.second_size = 0;
+    int slices_generated = 0;
+    TF_LITE_ENSURE_STATUS(frontend->GenerateFeaturesBatch(
+        error_reporter, audio, batch_size, kFeatureSliceSize, rows,
+        &slices_generated));
+    if (slices_generated != batch_size) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Batch gave %d slices, want %d",
+                           slices_generated, batch_size);
+      return kTfLiteError;
+    }
+  }
+  return kTfLiteOk;
+}
+
+typedef TfLiteStatus (*PathFunction)(tflite::ErrorReporter*, MicroFrontend*,
+                                     int);
+
+// Runs `path` over all the audio kPassCount times, each time from a freshly
+// set up frontend, and returns the nanoseconds per slice of the fastest pass,
+// which is the one least disturbed by the rest of the host, or a negative
+// number on failure.
+double TimePath(tflite::ErrorReporter* error_reporter, PathFunction path,
+                MicroFrontendWorkspace* workspace, int batch_size) {
+  double fastest_ns = -1.0;
+  for (int pass = 0; pass < kPassCount; ++pass) {
+    MicroFrontend frontend;
+    if (frontend.InitializeForModel(error_reporter, workspace) != kTfLiteOk) {
+      return -1.0;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    if (path(error_reporter, &frontend, batch_size) != kTfLiteOk) {
+      return -1.0;
+    }
+    const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    if (fastest_ns < 0.0 || elapsed.count() < fastest_ns) {
+      fastest_ns = elapsed.count();
+    }
+  }
+  return fastest_ns / kSliceCount;
+}
+
+}  // namespace
+
+int main() {
+  tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+  for (int i = 0; i < kAudioSamples; ++i) {
+    g_audio[i] = SyntheticSample(i);
+  }
+
+  printf("%d slices of %d features, best of %d passes, ns per slice:\n",
+         kSliceCount, kFeatureSliceSize, kPassCount);
+  printf("  batch  per-slice    batched    saved\n");
+  for (const int batch_size : kBatchSizes) {
+    const double per_slice_ns = TimePath(error_reporter, RunPerSlice,
+                                         &g_per_slice_workspace, batch_size);
+    const double batched_ns = TimePath(error_reporter, RunBatched,
+                                       &g_batched_workspace, batch_size);
+    if (per_slice_ns < 0.0 || batched_ns < 0.0) {
+      return 1;
+    }
+    // Both buffers hold the last pass, which started from a fresh frontend.
+    if (memcmp(g_per_slice_features, g_batched_features,
+               sizeof(g_batched_features)) != 0) {
+      fprintf(stderr, "Batches of %d give different features\n", batch_size);
+      return 1;
+    }
+    printf("  %5d  %9.1f  %9.1f  %6.1f%%\n", batch_size, per_slice_ns,
+           batched_ns, 100.0 * (per_slice_ns - batched_ns) / per_slice_ns);
+  }
+  return 0;
+}
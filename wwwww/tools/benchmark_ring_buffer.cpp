@@ -0,0 +1,412 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that checks RingBuffer and BroadcastBuffer, times them the way the
+// pipeline uses them, and runs a writer task against readers that peek whole
+// windows in place, to make sure a reader that keeps up gets every element and
+// one that doesn't finds out what it lost.
+// The timings include ringbuf.c, the ring these classes replaced, as it was
+// used before: tools/baseline has it unchanged, and tools/host stands in for
+// the FreeRTOS semaphores it locks with, with pthreads. Both classes are
+// header-only, so it builds without TensorFlow Lite Micro:
+//
+//   gcc -O2 -I tools/host -I tools/baseline -c tools/baseline/ringbuf.c
+//       -o /tmp/ringbuf.o
+//   g++ -std=c++11 -O2 -pthread -I src -I tools/host -I tools/baseline
+//       tools/benchmark_ring_buffer.cpp /tmp/ringbuf.o
+//       -o /tmp/benchmark_ring_buffer
+//   /tmp/benchmark_ring_buffer
+//
+// It exits with a nonzero status if any check fails. Host timings are only
+// useful to compare the access patterns with each other, and the pthread
+// semaphores cost ringbuf.c less than FreeRTOS's do on the device.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+#include "broadcast_buffer.h"
+#include "micro_model_settings.h"
+#include "ring_buffer.h"
+#include "ringbuf.h"
+
+namespace {
+
+// Same sizes as kAudioCaptureBufferSamples and the frontend's windows.
+constexpr uint32_t kCaptureSamples = 32768;
+constexpr uint32_t kWindowSamples = ModelPipelineConfig::kWindowSamples;
+constexpr uint32_t kStrideSamples = ModelPipelineConfig::kStrideSamples;
+constexpr uint32_t kHistorySamples = ModelPipelineConfig::kHistorySamples;
+constexpr int kTimedStrides = 1000000;
+constexpr int kTimedElements = 20000000;
+// Size of the capture ring ringbuf.c was set up with, in bytes.
+constexpr uint32_t kRingbufBytes = 80000;
+
+int g_failures = 0;
+
+void Expect(bool condition, const char* what) {
+  if (!condition) {
+    fprintf(stderr, "FAILED: %s\n", what);
+    ++g_failures;
+  }
+}
+
+template <typename T>
+T At(const RingSpan<T>& span, uint32_t i) {
+  return i < span.first_size ? span.first[i] : span.second[i - span.first_size];
+}
+
+void CheckRingBuffer() {
+  static RingBuffer<int16_t, 16> ring;
+  int16_t in[32];
+  for (int i = 0; i < 32; ++i) {
+    in[i] = static_cast<int16_t>(i);
+  }
+  Expect(ring.Write(in, 10) == 10, "RingBuffer writes what fits");
+  RingBuffer<int16_t, 16>::Span span = ring.Peek(8);
+  Expect(span.size() == 8 && At(span, 0) == 0 && At(span, 7) == 7,
+         "RingBuffer peeks the oldest elements");
+  Expect(ring.Consume(8, 2) == 6, "RingBuffer keeps the last elements");
+  Expect(ring.Write(in + 10, 20) == 12, "RingBuffer never overwrites");
+  span = ring.Peek(16);
+  Expect(span.size() == 16 && span.second_size != 0,
+         "RingBuffer splits a wrapped span");
+  bool in_order = true;
+  for (uint32_t i = 0; i < span.size(); ++i) {
+    in_order = in_order && At(span, i) == static_cast<int16_t>(6 + i);
+  }
+  Expect(in_order, "RingBuffer keeps wrapped elements in order");
+  int16_t out[16];
+  Expect(ring.Read(out, 16) == 16 && out[15] == 21, "RingBuffer reads out");
+  Expect(ring.size() == 0 && ring.available() == 16, "RingBuffer drains");
+  Expect(ring.stats().peak_fill.value() == 16, "RingBuffer tracks its peak");
+
+  span = ring.Reserve(20);
+  Expect(span.size() == 16, "RingBuffer reserves what fits");
+  Expect(ring.size() == 0, "RingBuffer hides reserved elements");
+  ring.Commit(4);
+  Expect(ring.size() == 4, "RingBuffer publishes committed elements");
+  ring.Reset();
+  Expect(ring.size() == 0, "RingBuffer resets");
+}
+
+void CheckBroadcastBuffer() {
+  static BroadcastBuffer<int16_t, 16> buffer;
+  BroadcastBuffer<int16_t, 16>::Reader reader = buffer.Attach();
+  Expect(reader.attached(), "BroadcastBuffer attaches a reader");
+  int16_t in[40];
+  for (int i = 0; i < 40; ++i) {
+    in[i] = static_cast<int16_t>(i);
+  }
+  buffer.Write(in, 10);
+  BroadcastBuffer<int16_t, 16>::Span span = reader.Peek(8);
+  Expect(span.size() == 8 && At(span, 0) == 0,
+         "BroadcastBuffer peeks the oldest elements");
+  buffer.Write(in + 10, 6);
+  Expect(reader.Consume(8, 2) == 6, "BroadcastBuffer keeps the last elements");
+  Expect(reader.TakeLost() == 0, "BroadcastBuffer loses nothing in time");
+  // The peeked window starts at 6, so 4 of these overwrite it.
+  span = reader.Peek(8);
+  buffer.Write(in + 16, 10);
+  Expect(reader.Consume(8) == 4,
+         "BroadcastBuffer doesn't release overwritten elements");
+  Expect(reader.TakeLost() == 4,
+         "BroadcastBuffer reports a peeked window it overwrote");
+  buffer.Write(in, 30);
+  Expect(reader.TakeLost() == 56 - 16 - 14,
+         "BroadcastBuffer reports overwritten elements");
+  int attached = 1;
+  BroadcastBuffer<int16_t, 16>::Reader others[4];
+  for (int i = 0; i < 4; ++i) {
+    others[i] = buffer.Attach();
+    attached += others[i].attached() ? 1 : 0;
+  }
+  Expect(attached == BroadcastBuffer<int16_t, 16>::kMaxReaders,
+         "BroadcastBuffer limits the number of readers");
+  buffer.Detach(&reader);
+  Expect(!reader.attached() && buffer.Attach().attached(),
+         "BroadcastBuffer reuses a detached reader's slot");
+}
+
+double NsPerSample(std::chrono::steady_clock::time_point start,
+                   int64_t samples) {
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / samples;
+}
+
+// Writes a stride at a time and reads each window in place, the way the
+// capture task and the frontend share the audio. `sink` keeps the reads alive.
+template <typename Write, typename Window>
+double TimeStrides(Write write, Window window, int64_t* sink) {
+  int16_t stride[kStrideSamples];
+  for (uint32_t i = 0; i < kStrideSamples; ++i) {
+    stride[i] = static_cast<int16_t>(i);
+  }
+  const auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kTimedStrides; ++i) {
+    write(stride);
+    *sink += window();
+  }
+  return NsPerSample(start, int64_t{kTimedStrides} * kStrideSamples);
+}
+
+void TimeBuffers() {
+  int64_t sink = 0;
+  static RingBuffer<int16_t, kCaptureSamples> ring;
+  int16_t history[kHistorySamples] = {};
+  ring.Write(history, kHistorySamples);
+  const double ring_ns = TimeStrides(
+      [](const int16_t* stride) { ring.Write(stride, kStrideSamples); },
+      []() {
+        const RingBuffer<int16_t, kCaptureSamples>::Span span =
+            ring.Peek(kWindowSamples);
+        const int64_t sample = At(span, span.size() - 1);
+        ring.Consume(span.size(), kHistorySamples);
+        return sample;
+      },
+      &sink);
+
+  static BroadcastBuffer<int16_t, kCaptureSamples> broadcast;
+  static BroadcastBuffer<int16_t, kCaptureSamples>::Reader reader =
+      broadcast.Attach();
+  broadcast.Write(history, kHistorySamples);
+  const double broadcast_ns = TimeStrides(
+      [](const int16_t* stride) { broadcast.Write(stride, kStrideSamples); },
+      []() {
+        const BroadcastBuffer<int16_t, kCaptureSamples>::Span span =
+            reader.Peek(kWindowSamples);
+        const int64_t sample = At(span, span.size() - 1);
+        reader.Consume(span.size(), kHistorySamples);
+        return sample;
+      },
+      &sink);
+
+  // Copying every window out before reading it is the alternative to pinning.
+  static int16_t window_copy[kWindowSamples];
+  broadcast.Write(history, kHistorySamples);
+  const double copy_ns = TimeStrides(
+      [](const int16_t* stride) { broadcast.Write(stride, kStrideSamples); },
+      []() {
+        const BroadcastBuffer<int16_t, kCaptureSamples>::Span span =
+            reader.Peek(kWindowSamples);
+        memcpy(window_copy, span.first, span.first_size * sizeof(int16_t));
+        memcpy(window_copy + span.first_size, span.second,
+               span.second_size * sizeof(int16_t));
+        reader.Consume(span.size(), kHistorySamples);
+        return static_cast<int64_t>(window_copy[span.size() - 1]);
+      },
+      &sink);
+
+  // What the audio provider did with ringbuf.c: the history of the previous
+  // window is copied to the front, the new stride read in behind it, and the
+  // end of the window copied back out as the next history.
+  ringbuf_t* ringbuf = rb_init("benchmark", kRingbufBytes);
+  static int16_t window[kWindowSamples];
+  static int16_t ringbuf_history[kHistorySamples];
+  const double ringbuf_ns = TimeStrides(
+      [ringbuf](const int16_t* stride) {
+        rb_write(ringbuf, reinterpret_cast<const uint8_t*>(stride),
+                 kStrideSamples * sizeof(int16_t), pdMS_TO_TICKS(10));
+      },
+      [ringbuf]() {
+        memcpy(window, ringbuf_history, kHistorySamples * sizeof(int16_t));
+        rb_read(ringbuf, reinterpret_cast<uint8_t*>(window + kHistorySamples),
+                kStrideSamples * sizeof(int16_t), pdMS_TO_TICKS(10));
+        memcpy(ringbuf_history, window + kStrideSamples,
+               kHistorySamples * sizeof(int16_t));
+        return static_cast<int64_t>(window[kWindowSamples - 1]);
+      },
+      &sink);
+  rb_cleanup(ringbuf);
+
+  printf("%u-sample stride, %u-sample window, ns per sample written:\n",
+         kStrideSamples, kWindowSamples);
+  printf("  RingBuffer, window peeked in place:      %6.3f\n", ring_ns);
+  printf("  BroadcastBuffer, window peeked in place: %6.3f\n", broadcast_ns);
+  printf("  BroadcastBuffer, window copied out:      %6.3f\n", copy_ns);
+  printf("  ringbuf.c, window copied out:            %6.3f\n", ringbuf_ns);
+  printf("  (checksum %lld)\n", static_cast<long long>(sink));
+}
+
+// One element written and read at a time, where the per-call overhead of each
+// ring shows instead of the copies.
+void TimeSingleElements() {
+  int64_t sink = 0;
+  static RingBuffer<int16_t, kCaptureSamples> ring;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kTimedElements; ++i) {
+    const int16_t in = static_cast<int16_t>(i);
+    int16_t out = 0;
+    ring.Write(&in, 1);
+    ring.Read(&out, 1);
+    sink += out;
+  }
+  const double ring_ns = NsPerSample(start, kTimedElements);
+
+  ringbuf_t* ringbuf = rb_init("benchmark", kRingbufBytes);
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kTimedElements; ++i) {
+    const int16_t in = static_cast<int16_t>(i);
+    int16_t out = 0;
+    rb_write(ringbuf, reinterpret_cast<const uint8_t*>(&in), sizeof(in),
+             pdMS_TO_TICKS(10));
+    rb_read(ringbuf, reinterpret_cast<uint8_t*>(&out), sizeof(out),
+            pdMS_TO_TICKS(10));
+    sink += out;
+  }
+  const double ringbuf_ns = NsPerSample(start, kTimedElements);
+  rb_cleanup(ringbuf);
+
+  printf("One element at a time, ns per element written and read:\n");
+  printf("  RingBuffer: %6.3f\n", ring_ns);
+  printf("  ringbuf.c:  %6.3f\n", ringbuf_ns);
+  printf("  (checksum %lld)\n", static_cast<long long>(sink));
+}
+
+// A writer task against a reader that checks every window it peeks. The
+// writer puts a counting sequence in, so a window that got overwritten while
+// it was being read shows up as a break in the sequence, and that reader has
+// to find it in its lag counter.
+void CheckConcurrentReader(bool writer_paced, const char* name) {
+  static BroadcastBuffer<uint32_t, 1024> buffer;
+  BroadcastBuffer<uint32_t, 1024>::Reader reader = buffer.Attach();
+  std::atomic<bool> stop(false);
+  std::thread writer([&stop, writer_paced]() {
+    uint32_t next = 0;
+    uint32_t chunk[100];
+    while (!stop.load()) {
+      for (uint32_t i = 0; i < 100; ++i) {
+        chunk[i] = next + i;
+      }
+      buffer.Write(chunk, 100);
+      next += 100;
+      if (writer_paced) {
+        std::this_thread::sleep_for(std::chrono::microseconds(20));
+      }
+    }
+  });
+  int64_t torn = 0;
+  int64_t unreported = 0;
+  int64_t read = 0;
+  int64_t lost = 0;
+  for (int i = 0; i < 2000000; ++i) {
+    const BroadcastBuffer<uint32_t, 1024>::Span span = reader.Peek(700);
+    bool is_torn = false;
+    for (uint32_t j = 1; j < span.size(); ++j) {
+      if (At(span, j) != At(span, j - 1) + 1) {
+        is_torn = true;
+      }
+    }
+    read += reader.Consume(span.size(), span.size() / 2);
+    const uint32_t window_lost = reader.TakeLost();
+    lost += window_lost;
+    if (is_torn) {
+      ++torn;
+      if (window_lost == 0) {
+        ++unreported;
+      }
+    }
+  }
+  stop.store(true);
+  writer.join();
+  buffer.Detach(&reader);
+  printf("%s: %lld elements read, %lld lost, %lld windows torn, %lld of them "
+         "unreported\n",
+         name, static_cast<long long>(read), static_cast<long long>(lost),
+         static_cast<long long>(torn), static_cast<long long>(unreported));
+  Expect(unreported == 0, "BroadcastBuffer reports every torn window");
+  if (writer_paced) {
+    Expect(torn == 0, "BroadcastBuffer leaves a reader that keeps up alone");
+  }
+}
+
+// Two readers against one writer: one keeps up, the other holds on to a
+// window it peeked for longer than the ring lasts. The one that keeps up has
+// to get every element in order, and only the one that stalled loses any.
+void CheckIndependentReaders() {
+  constexpr uint32_t kElements = 4000000;
+  constexpr uint32_t kChunk = 100;
+  static BroadcastBuffer<uint32_t, 4096> buffer;
+  BroadcastBuffer<uint32_t, 4096>::Reader fast = buffer.Attach();
+  BroadcastBuffer<uint32_t, 4096>::Reader stalled = buffer.Attach();
+  std::atomic<bool> stop(false);
+  std::thread writer([]() {
+    uint32_t chunk[kChunk];
+    for (uint32_t next = 0; next < kElements; next += kChunk) {
+      for (uint32_t i = 0; i < kChunk; ++i) {
+        chunk[i] = next + i;
+      }
+      buffer.Write(chunk, kChunk);
+      std::this_thread::sleep_for(std::chrono::microseconds(5));
+    }
+  });
+  std::thread stalled_reader([&stop, &stalled]() {
+    while (!stop.load()) {
+      stalled.Peek(1000);
+      std::this_thread::sleep_for(std::chrono::milliseconds(20));
+      stalled.Consume(1000);
+    }
+  });
+  uint32_t expected = 0;
+  uint32_t out_of_order = 0;
+  uint32_t fast_lost = 0;
+  while (expected < kElements) {
+    const BroadcastBuffer<uint32_t, 4096>::Span span = fast.Peek(512);
+    for (uint32_t i = 0; i < span.size(); ++i) {
+      if (At(span, i) != expected + i) {
+        ++out_of_order;
+      }
+    }
+    expected += fast.Consume(span.size());
+    fast_lost += fast.TakeLost();
+  }
+  writer.join();
+  stop.store(true);
+  stalled_reader.join();
+  const uint32_t stalled_lost = stalled.TakeLost();
+  printf("Independent readers: %u elements written, the reader that keeps up "
+         "read %u and lost %u, the stalled one lost %u\n",
+         kElements, fast.stats().elements_read.value(), fast_lost,
+         stalled.stats().elements_lost.value());
+  Expect(out_of_order == 0 && fast_lost == 0 &&
+             fast.stats().elements_read.value() == kElements,
+         "BroadcastBuffer gives a reader that keeps up every element");
+  Expect(stalled_lost > 0 || stalled.stats().elements_lost.value() > 0,
+         "BroadcastBuffer counts a stalled reader's loss against it");
+  buffer.Detach(&fast);
+  buffer.Detach(&stalled);
+}
+
+}  // namespace
+
+int main() {
+  CheckRingBuffer();
+  CheckBroadcastBuffer();
+  TimeBuffers();
+  TimeSingleElements();
+  CheckConcurrentReader(true, "Paced writer");
+  CheckConcurrentReader(false, "Flooding writer");
+  CheckIndependentReaders();
+  if (g_failures != 0) {
+    fprintf(stderr, "%d checks failed\n", g_failures);
+    return 1;
+  }
+  printf("All checks passed\n");
+  return 0;
+}
@@ -0,0 +1,271 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that checks the kernels specialized_kernels.h compiles for the
+// shapes of g_model against the reference kernels the interpreter runs, and
+// times both. The weights, biases, offsets and requantization parameters are
+// random, a new set every few runs, and so are the inputs. Every other set
+// has its weights at the ends of the int8 range, and every fourth input is
+// too, so the accumulators reach their extremes and the outputs saturate.
+// Both kernels have to give the same outputs on every run. It only needs the
+// reference kernels, which are headers:
+//
+//   g++ -std=c++11 -O2 -I src -I <tflite-micro>
+//       -I <tflite-micro>/third_party/gemmlowp
+//       tools/benchmark_specialized_kernels.cpp
+//       -o /tmp/benchmark_specialized_kernels
+//   /tmp/benchmark_specialized_kernels [run count]
+//
+// Host timings only show how the two compare, the device figures come from a
+// build with -DMICRO_SPEECH_KERNEL_CHECK.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "specialized_kernels.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/depthwise_conv.h"
+#include "tensorflow/lite/kernels/internal/reference/integer_ops/fully_connected.h"
+#include "tensorflow/lite/kernels/internal/types.h"
+
+namespace {
+
+typedef ModelDepthwiseConv Conv;
+typedef ModelFullyConnected Fc;
+
+constexpr int kDefaultRunCount = 20000;
+// Runs before the parameters change.
+constexpr int kRunsPerParameterSet = 50;
+
+constexpr int kInputSize =
+    Conv::kInputHeight * Conv::kInputWidth * Conv::kInputChannels;
+constexpr int kFilterSize =
+    Conv::kFilterHeight * Conv::kFilterWidth * Conv::kOutputChannels;
+constexpr int kConvOutputSize =
+    Conv::kOutputHeight * Conv::kOutputWidth * Conv::kOutputChannels;
+static_assert(kConvOutputSize == Fc::kAccumDepth,
+              "The fully connected layer reads the whole convolution output");
+
+// The parameters of both layers, once for each kind of kernel.
+struct Layers {
+  tflite::DepthwiseParams conv_params;
+  int32_t conv_multipliers[Conv::kOutputChannels];
+  int32_t conv_shifts[Conv::kOutputChannels];
+  int8_t conv_filter[kFilterSize];
+  int32_t conv_bias[Conv::kOutputChannels];
+  Conv::Params conv_kernel_params;
+
+  tflite::FullyConnectedParams fc_params;
+  int8_t fc_weights[Fc::kOutputDepth * Fc::kAccumDepth];
+  int32_t fc_bias[Fc::kOutputDepth];
+  Fc::Params fc_kernel_params;
+};
+
+Layers g_layers;
+int8_t g_input[kInputSize];
+int8_t g_reference_conv_output[kConvOutputSize];
+int8_t g_conv_output[kConvOutputSize];
+int8_t g_reference_fc_output[Fc::kOutputDepth];
+int8_t g_fc_output[Fc::kOutputDepth];
+
+// A value anywhere in the int8 range, or at one of its ends if `saturating`.
+int8_t RandomInt8(std::mt19937* random, bool saturating) {
+  const int value = static_cast<int>((*random)() % 256) - 128;
+  if (saturating) {
+    return (value < 0) ? INT8_MIN : INT8_MAX;
+  }
+  return static_cast<int8_t>(value);
+}
+
+int32_t RandomInt(std::mt19937* random, int32_t min, int32_t max) {
+  return min + static_cast<int32_t>((*random)() %
+                                    static_cast<uint32_t>(max - min + 1));
+}
+
+// A requantization multiplier and shift like QuantizeMultiplier() makes for
+// real multipliers from about 1/4096 to 1.
+void RandomMultiplier(std::mt19937* random, int32_t* multiplier,
+                      int32_t* shift) {
+  *multiplier = RandomInt(random, 1 << 30, INT32_MAX);
+  *shift = RandomInt(random, -12, 0);
+}
+
+// New random parameters for both layers, with the weights at the ends of the
+// int8 range if `saturating`.
+void RandomizeLayers(std::mt19937* random, bool saturating, Layers* layers) {
+  tflite::DepthwiseParams* conv = &layers->conv_params;
+  *conv = tflite::DepthwiseParams();
+  conv->padding_type = tflite::PaddingType::kSame;
+  conv->padding_values.height = Conv::kPadTop;
+  conv->padding_values.width = Conv::kPadLeft;
+  conv->stride_height = Conv::kStrideHeight;
+  conv->stride_width = Conv::kStrideWidth;
+  conv->dilation_height_factor = 1;
+  conv->dilation_width_factor = 1;
+  conv->depth_multiplier = Conv::kDepthMultiplier;
+  conv->input_offset = -RandomInt(random, -128, 127);
+  conv->output_offset = RandomInt(random, -128, 127);
+  // Sometimes a ReLU, which narrows the output range.
+  conv->quantized_activation_min =
+      ((*random)() % 2 == 0) ? INT8_MIN : conv->output_offset;
+  conv->quantized_activation_max = INT8_MAX;
+  for (int i = 0; i < kFilterSize; ++i) {
+    layers->conv_filter[i] = RandomInt8(random, saturating);
+  }
+  for (int channel = 0; channel < Conv::kOutputChannels; ++channel) {
+    RandomMultiplier(random, &layers->conv_multipliers[channel],
+                     &layers->conv_shifts[channel]);
+    layers->conv_bias[channel] = RandomInt(random, -100000, 100000);
+  }
+
+  Conv::Params* conv_kernel = &layers->conv_kernel_params;
+  conv_kernel->input_offset = conv->input_offset;
+  conv_kernel->output_offset = conv->output_offset;
+  conv_kernel->activation_min = conv->quantized_activation_min;
+  conv_kernel->activation_max = conv->quantized_activation_max;
+  memcpy(conv_kernel->multipliers, layers->conv_multipliers,
+         sizeof(conv_kernel->multipliers));
+  memcpy(conv_kernel->shifts, layers->conv_shifts,
+         sizeof(conv_kernel->shifts));
+  Conv::Prepare(layers->conv_filter, layers->conv_bias, conv_kernel);
+
+  // Int8 models have symmetric fully connected weights, which is all the
+  // specialized kernel supports.
+  tflite::FullyConnectedParams* fc = &layers->fc_params;
+  *fc = tflite::FullyConnectedParams();
+  fc->input_offset = -conv->output_offset;
+  fc->weights_offset = 0;
+  fc->output_offset = RandomInt(random, -128, 127);
+  RandomMultiplier(random, &fc->output_multiplier, &fc->output_shift);
+  fc->quantized_activation_min = INT8_MIN;
+  fc->quantized_activation_max = INT8_MAX;
+  for (int i = 0; i < Fc::kOutputDepth * Fc::kAccumDepth; ++i) {
+    layers->fc_weights[i] = RandomInt8(random, saturating);
+  }
+  for (int out = 0; out < Fc::kOutputDepth; ++out) {
+    layers->fc_bias[out] = RandomInt(random, -100000, 100000);
+  }
+
+  Fc::Params* fc_kernel = &layers->fc_kernel_params;
+  fc_kernel->input_offset = fc->input_offset;
+  fc_kernel->output_offset = fc->output_offset;
+  fc_kernel->multiplier = fc->output_multiplier;
+  fc_kernel->shift = fc->output_shift;
+  fc_kernel->activation_min = fc->quantized_activation_min;
+  fc_kernel->activation_max = fc->quantized_activation_max;
+  Fc::Prepare(layers->fc_weights, layers->fc_bias, fc_kernel);
+}
+
+void RunReferenceConv(const Layers& layers, const int8_t* input,
+                      int8_t* output) {
+  const int32_t input_dims[4] = {1, Conv::kInputHeight, Conv::kInputWidth,
+                                 Conv::kInputChannels};
+  const int32_t filter_dims[4] = {1, Conv::kFilterHeight, Conv::kFilterWidth,
+                                  Conv::kOutputChannels};
+  const int32_t bias_dims[1] = {Conv::kOutputChannels};
+  const int32_t output_dims[4] = {1, Conv::kOutputHeight, Conv::kOutputWidth,
+                                  Conv::kOutputChannels};
+  tflite::reference_integer_ops::DepthwiseConvPerChannel(
+      layers.conv_params, layers.conv_multipliers, layers.conv_shifts,
+      tflite::RuntimeShape(4, input_dims), input,
+      tflite::RuntimeShape(4, filter_dims), layers.conv_filter,
+      tflite::RuntimeShape(1, bias_dims), layers.conv_bias,
+      tflite::RuntimeShape(4, output_dims), output);
+}
+
+void RunReferenceFc(const Layers& layers, const int8_t* input,
+                    int8_t* output) {
+  const int32_t input_dims[2] = {1, Fc::kAccumDepth};
+  const int32_t weights_dims[2] = {Fc::kOutputDepth, Fc::kAccumDepth};
+  const int32_t bias_dims[1] = {Fc::kOutputDepth};
+  const int32_t output_dims[2] = {1, Fc::kOutputDepth};
+  tflite::reference_integer_ops::FullyConnected(
+      layers.fc_params, tflite::RuntimeShape(2, input_dims), input,
+      tflite::RuntimeShape(2, weights_dims), layers.fc_weights,
+      tflite::RuntimeShape(1, bias_dims), layers.fc_bias,
+      tflite::RuntimeShape(2, output_dims), output);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int run_count = (argc > 1) ? atoi(argv[1]) : kDefaultRunCount;
+  if (run_count <= 0) {
+    fprintf(stderr, "Usage: %s [run count]\n", argv[0]);
+    return 1;
+  }
+
+  std::mt19937 random(3);
+  typedef std::chrono::steady_clock Clock;
+  Clock::duration reference_conv_time(0);
+  Clock::duration conv_time(0);
+  Clock::duration reference_fc_time(0);
+  Clock::duration fc_time(0);
+  int differing_runs = 0;
+  for (int run = 0; run < run_count; ++run) {
+    const int parameter_set = run / kRunsPerParameterSet;
+    if (run % kRunsPerParameterSet == 0) {
+      RandomizeLayers(&random, parameter_set % 2 == 1, &g_layers);
+    }
+    const bool saturating_input = (run % 4 == 3);
+    for (int i = 0; i < kInputSize; ++i) {
+      g_input[i] = RandomInt8(&random, saturating_input);
+    }
+
+    const Clock::time_point start = Clock::now();
+    RunReferenceConv(g_layers, g_input, g_reference_conv_output);
+    const Clock::time_point reference_conv_end = Clock::now();
+    Conv::Run(g_layers.conv_kernel_params, g_input, g_layers.conv_filter,
+              g_conv_output);
+    const Clock::time_point conv_end = Clock::now();
+    // Both fully connected kernels read the reference convolution output,
+    // so a difference in one layer doesn't show up in the other.
+    RunReferenceFc(g_layers, g_reference_conv_output, g_reference_fc_output);
+    const Clock::time_point reference_fc_end = Clock::now();
+    Fc::Run(g_layers.fc_kernel_params, g_reference_conv_output,
+            g_layers.fc_weights, g_fc_output);
+    const Clock::time_point fc_end = Clock::now();
+    reference_conv_time += reference_conv_end - start;
+    conv_time += conv_end - reference_conv_end;
+    reference_fc_time += reference_fc_end - conv_end;
+    fc_time += fc_end - reference_fc_end;
+
+    if (memcmp(g_conv_output, g_reference_conv_output, kConvOutputSize) !=
+            0 ||
+        memcmp(g_fc_output, g_reference_fc_output, Fc::kOutputDepth) != 0) {
+      if (differing_runs == 0) {
+        fprintf(stderr, "Run %d: the specialized kernels differ\n", run);
+      }
+      ++differing_runs;
+    }
+  }
+
+  typedef std::chrono::duration<double, std::micro> Microseconds;
+  const double reference_conv_us =
+      Microseconds(reference_conv_time).count() / run_count;
+  const double conv_us = Microseconds(conv_time).count() / run_count;
+  const double reference_fc_us =
+      Microseconds(reference_fc_time).count() / run_count;
+  const double fc_us = Microseconds(fc_time).count() / run_count;
+  printf("%d runs, %d differ\n", run_count, differing_runs);
+  printf("DepthwiseConv2D: reference %.2f us, specialized %.2f us (%.1fx)\n",
+         reference_conv_us, conv_us, reference_conv_us / conv_us);
+  printf("FullyConnected:  reference %.2f us, specialized %.2f us (%.1fx)\n",
+         reference_fc_us, fc_us, reference_fc_us / fc_us);
+  return (differing_runs == 0) ? 0 : 1;
+}
@@ -0,0 +1,175 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that times the two ways of keeping the spectrogram for one new
+// slice per inference: scrolling it a byte at a time and copying it into the
+// input tensor the way FeatureProvider used to, against the ring of slices
+// that FeatureProvider::CopyFeatureData() reads out with two memcpy calls, and
+// that copy on its own, which every inference pays now that the spectrogram
+// no longer lives in the input tensor. Next to the times it prints the bytes
+// each one writes, per inference and per second at the model's stride. It also
+// checks that both give the model the same input. It only needs the pipeline
+// settings:
+//
+//   g++ -std=c++11 -O2 -I src tools/benchmark_spectrogram.cpp
+//       -o /tmp/benchmark_spectrogram
+//   /tmp/benchmark_spectrogram
+//
+// At -O2 GCC turns the byte loops into memmove and memcpy calls on its own,
+// which hides most of the difference. Adding -fno-tree-loop-distribute-patterns
+// keeps them as the loops the old code was written as.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "micro_model_settings.h"
+
+namespace {
+
+constexpr int kInferenceCount = 200000;
+constexpr int kInferencesPerSecond = 1000 / kFeatureSliceStrideMs;
+// Bytes each layout writes per inference: the scroll moves every slice but the
+// oldest, both layouts write the new slice, and both copies move it all.
+constexpr int kScrollBytes = kFeatureElementCount - kFeatureSliceSize;
+constexpr int kSliceBytes = kFeatureSliceSize;
+constexpr int kCopyBytes = kFeatureElementCount;
+
+int8_t g_scrolled[kFeatureElementCount];
+int8_t g_ring[kFeatureElementCount];
+int8_t g_input[kFeatureElementCount];
+int8_t g_ring_input[kFeatureElementCount];
+
+// Keeps the compiler from dropping or merging the work on `data`.
+void Use(const int8_t* data) { asm volatile("" : : "r"(data) : "memory"); }
+
+// The old PopulateFeatureData: move every slice but the oldest up by one, byte
+// by byte, then write the new slice into the last row. Like the old member
+// code, it only sees the spectrogram through a pointer.
+__attribute__((noinline)) void ScrollIn(int8_t* feature_data,
+                                        const int8_t* slice) {
+  constexpr int kSlicesToKeep = kFeatureSliceCount - 1;
+  for (int dest_slice = 0; dest_slice < kSlicesToKeep; ++dest_slice) {
+    int8_t* dest_slice_data = feature_data + dest_slice * kFeatureSliceSize;
+    const int8_t* src_slice_data = dest_slice_data + kFeatureSliceSize;
+    for (int i = 0; i < kFeatureSliceSize; ++i) {
+      dest_slice_data[i] = src_slice_data[i];
+    }
+  }
+  memcpy(feature_data + kSlicesToKeep * kFeatureSliceSize, slice,
+         kFeatureSliceSize);
+}
+
+// The old loop() copy of the scrolled spectrogram into the input tensor.
+__attribute__((noinline)) void CopyScrolled(const int8_t* feature_data,
+                                            int8_t* output) {
+  for (int i = 0; i < kFeatureElementCount; ++i) {
+    output[i] = feature_data[i];
+  }
+}
+
+// FeatureProvider now: the new slice replaces the oldest row, and head moves
+// past it.
+__attribute__((noinline)) void RingIn(const int8_t* slice, int* head) {
+  memcpy(g_ring + *head * kFeatureSliceSize, slice, kFeatureSliceSize);
+  *head = (*head + 1) % kFeatureSliceCount;
+}
+
+// Same as FeatureProvider::CopyFeatureData().
+__attribute__((noinline)) void CopyRing(int head, int8_t* output) {
+  const int head_offset = head * kFeatureSliceSize;
+  memcpy(output, g_ring + head_offset, kFeatureElementCount - head_offset);
+  memcpy(output + (kFeatureElementCount - head_offset), g_ring, head_offset);
+}
+
+void MakeSlice(int index, int8_t* slice) {
+  for (int i = 0; i < kFeatureSliceSize; ++i) {
+    slice[i] = static_cast<int8_t>(index * 7 + i);
+  }
+}
+
+double NsPerInference(std::chrono::steady_clock::time_point start) {
+  const std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / kInferenceCount;
+}
+
+void PrintRow(const char* name, double ns, int bytes) {
+  printf("  %-28s %8.1f  %6d  %7d\n", name, ns, bytes,
+         bytes * kInferencesPerSecond);
+}
+
+}  // namespace
+
+int main() {
+  int8_t slice[kFeatureSliceSize];
+  int head = 0;
+
+  // Both layouts have to hand the model the same input after every slice.
+  for (int i = 0; i < 3 * kFeatureSliceCount; ++i) {
+    MakeSlice(i, slice);
+    ScrollIn(g_scrolled, slice);
+    CopyScrolled(g_scrolled, g_input);
+    RingIn(slice, &head);
+    CopyRing(head, g_ring_input);
+    if (memcmp(g_input, g_ring_input, kFeatureElementCount) != 0) {
+      fprintf(stderr, "Ring and scrolled inputs differ after slice %d\n", i);
+      return 1;
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kInferenceCount; ++i) {
+    ScrollIn(g_scrolled, slice);
+    Use(g_scrolled);
+  }
+  const double scroll_ns = NsPerInference(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kInferenceCount; ++i) {
+    ScrollIn(g_scrolled, slice);
+    CopyScrolled(g_scrolled, g_input);
+    Use(g_input);
+  }
+  const double scroll_copy_ns = NsPerInference(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kInferenceCount; ++i) {
+    RingIn(slice, &head);
+    CopyRing(head, g_input);
+    Use(g_input);
+  }
+  const double ring_ns = NsPerInference(start);
+
+  // What the ring costs per inference that the scroll in the input tensor
+  // didn't: the copy out of it.
+  start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kInferenceCount; ++i) {
+    CopyRing(i % kFeatureSliceCount, g_input);
+    Use(g_input);
+  }
+  const double copy_ns = NsPerInference(start);
+
+  printf("%dx%d spectrogram, one new slice per inference at the %dms stride:\n",
+         kFeatureSliceCount, kFeatureSliceSize, kFeatureSliceStrideMs);
+  printf("                                     ns   bytes  bytes/s\n");
+  PrintRow("byte-wise scroll", scroll_ns, kScrollBytes + kSliceBytes);
+  PrintRow("scroll plus byte-wise copy", scroll_copy_ns,
+           kScrollBytes + kSliceBytes + kCopyBytes);
+  PrintRow("ring plus two memcpy calls", ring_ns, kSliceBytes + kCopyBytes);
+  PrintRow("two memcpy calls alone", copy_ns, kCopyBytes);
+  return 0;
+}
@@ -0,0 +1,88 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that runs CompareCascadeInference() over far more windows than
+// the device check has time for: the recorded "yes" and "no" samples between
+// stretches of background noise that goes through the same frontend as the
+// device's audio. It reports what the cascade saves and its recall against
+// running the model on every window. It needs TensorFlow Lite Micro built for
+// the host, from the same release the device uses, including the
+// microfrontend library:
+//
+//   MF=<tflite-micro>/tensorflow/lite/experimental/microfrontend/lib
+//   g++ -std=c++11 -O2 -I tools/host -I src -I <tflite-micro>
+//       -I <flatbuffers>/include -I <kissfft> tools/check_cascade.cpp
+//       src/cascade_check.cpp src/speech_gate.cpp src/recognize_commands.cpp
+//       src/micro_features_generator.cpp src/fft_backend.cpp
+//       src/frontend_stages.cpp src/frontend_tables.cpp src/model.cpp
+//       src/micro_model_settings.cpp src/yes_micro_features_data.cpp
+//       src/no_micro_features_data.cpp $MF/*.c $MF/*.cc
+//       <tflite-micro>/libtensorflow-microlite.a -o /tmp/check_cascade
+//   /tmp/check_cascade [window count]
+//
+// tools/host stands in for the ESP-IDF headers the check uses. It exits with
+// a nonzero status if the cascade drops a command the model recognizes.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "cascade_check.h"
+#include "micro_model_settings.h"
+#include "model.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+// About a minute of audio, ten times around the stream.
+constexpr int kDefaultWindowCount = 3000;
+// Same size as main.cpp.
+constexpr int kTensorArenaSize = 10 * 1024;
+alignas(16) uint8_t tensor_arena[kTensorArenaSize];
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int window_count =
+      (argc > 1) ? atoi(argv[1]) : kDefaultWindowCount;
+  if (window_count <= 0) {
+    fprintf(stderr, "Usage: %s [window count]\n", argv[0]);
+    return 1;
+  }
+  tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+
+  tflite::MicroMutableOpResolver<4> op_resolver(error_reporter);
+  if (op_resolver.AddDepthwiseConv2D() != kTfLiteOk ||
+      op_resolver.AddFullyConnected() != kTfLiteOk ||
+      op_resolver.AddReshape() != kTfLiteOk ||
+      op_resolver.AddSoftmax() != kTfLiteOk) {
+    return 1;
+  }
+  const tflite::Model* model = tflite::GetModel(g_model);
+  tflite::MicroInterpreter interpreter(model, op_resolver, tensor_arena,
+                                       kTensorArenaSize, error_reporter);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    fprintf(stderr, "AllocateTensors() failed\n");
+    return 1;
+  }
+  if (CompareCascadeInference(error_reporter, &interpreter, window_count) !=
+      kTfLiteOk) {
+    return 1;
+  }
+  return 0;
+}
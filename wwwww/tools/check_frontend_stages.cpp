@@ -0,0 +1,381 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that checks the stages in frontend_stages.h against the
+// microfrontend library bit for bit, over a fuzzed set of square roots and
+// the spectra of a few thousand windows of synthetic audio, and times both.
+// It also has several threads race to build the log table, which must come
+// out the same as the library no matter who builds it. It needs the library
+// sources from the same TensorFlow Lite Micro release the device uses:
+//
+//   MF=<tflite-micro>/tensorflow/lite/experimental/microfrontend/lib
+//   g++ -std=c++11 -O2 -pthread -I src -I <tflite-micro>
+//       tools/check_frontend_stages.cpp src/frontend_stages.cpp
+//       src/frontend_tables.cpp $MF/filterbank.c $MF/noise_reduction.c
+//       $MF/pcan_gain_control.c $MF/log_scale.c $MF/log_lut.c
+//       -o /tmp/check_frontend_stages
+//   /tmp/check_frontend_stages
+//
+// It exits with a nonzero status if any stage differs from the library.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+
+#include "frontend_stages.h"
+#include "frontend_tables.h"
+#include "micro_model_settings.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/bits.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/filterbank.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/log_scale.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/noise_reduction.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/pcan_gain_control.h"
+#include "tensorflow/lite/experimental/microfrontend/lib/window.h"
+
+namespace {
+
+constexpr int kChannelCount = kFeatureSliceSize;
+constexpr int kSpectrumSize = kFrontendFftSize / 2 + 1;
+constexpr int kWindowCount = 2000;
+constexpr int kPassCount = 10;
+constexpr int kSqrtFuzzCount = 20000000;
+constexpr int kLogTableRacers = 4;
+constexpr double kPi = 3.14159265358979323846;
+
+typedef std::chrono::steady_clock Clock;
+
+// Stages compared, in pipeline order.
+enum Stage {
+  kFilterbankStage,
+  kSqrtStage,
+  kNoiseReductionStage,
+  kPcanStage,
+  kLogStage,
+  kStageCount,
+};
+const char* const kStageNames[kStageCount] = {"filterbank", "sqrt", "noise",
+                                              "pcan", "log"};
+
+double Ns(Clock::duration duration) {
+  return std::chrono::duration<double, std::nano>(duration).count();
+}
+
+// Same audio as fft_benchmark.cpp: a chirp from 100Hz to 7.5kHz every second,
+// with its level rising and falling over 40dB, on top of quiet noise.
+int16_t SyntheticSample(int index) {
+  const float t = static_cast<float>(index % kAudioSampleFrequency) /
+                  kAudioSampleFrequency;
+  const float phase = 2.0f * static_cast<float>(kPi) *
+                      (100.0f * t + 0.5f * 7400.0f * t * t);
+  const float level = 0.01f * powf(100.0f, 0.5f + 0.5f * sinf(2.0f *
+                                   static_cast<float>(kPi) * 3.0f * t));
+  const uint32_t noise = static_cast<uint32_t>(index) * 1664525u + 1013904223u;
+  const float value = level * sinf(phase) +
+                      0.002f * (static_cast<int32_t>(noise >> 16) - 32768) /
+                          32768.0f;
+  return static_cast<int16_t>(value * 32767.0f);
+}
+
+// The windowed, normalized spectrum of window `index`, the way the frontend
+// hands it to the filterbank, from a plain DFT scaled down by the FFT size.
+void MakeSpectrum(int index, complex_int16_t* spectrum, int* input_shift) {
+  static double cosines[kFrontendFftSize];
+  static double sines[kFrontendFftSize];
+  if (cosines[0] == 0.0) {
+    for (int i = 0; i < kFrontendFftSize; ++i) {
+      cosines[i] = cos(2.0 * kPi * i / kFrontendFftSize);
+      sines[i] = sin(2.0 * kPi * i / kFrontendFftSize);
+    }
+  }
+  int16_t window[kFrontendWindowSize];
+  int max_abs = 0;
+  for (int i = 0; i < kFrontendWindowSize; ++i) {
+    window[i] = static_cast<int16_t>(
+        (SyntheticSample(index * kFrontendWindowStep + i) *
+         g_frontend_window_coefficients[i]) >>
+        kFrontendWindowBits);
+    max_abs = std::max(max_abs, std::abs(static_cast<int>(window[i])));
+  }
+  *input_shift = 15 - MostSignificantBit32(max_abs);
+  for (int bin = 0; bin < kSpectrumSize; ++bin) {
+    double real = 0.0;
+    double imag = 0.0;
+    for (int i = 0; i < kFrontendWindowSize; ++i) {
+      const double sample =
+          static_cast<int16_t>(static_cast<uint16_t>(window[i])
+                               << *input_shift);
+      const int phase = (bin * i) % kFrontendFftSize;
+      real += sample * cosines[phase];
+      imag -= sample * sines[phase];
+    }
+    spectrum[bin].real =
+        static_cast<int16_t>(lround(real / kFrontendFftSize));
+    spectrum[bin].imag =
+        static_cast<int16_t>(lround(imag / kFrontendFftSize));
+  }
+}
+
+// Both sides of the comparison, each with its own copy of every state.
+struct StageStates {
+  uint64_t filterbank_work[kFrontendFilterbankChannelCount];
+  uint32_t noise_estimate[kChannelCount];
+  FilterbankState filterbank;
+  NoiseReductionState noise_reduction;
+  PcanGainControlState pcan;
+  LogScaleState log_scale;
+
+  StageStates() {
+    memset(filterbank_work, 0, sizeof(filterbank_work));
+    memset(noise_estimate, 0, sizeof(noise_estimate));
+    filterbank.num_channels = kChannelCount;
+    filterbank.start_index = kFrontendFilterbankStartIndex;
+    filterbank.end_index = kFrontendFilterbankEndIndex;
+    filterbank.channel_frequency_starts =
+        const_cast<int16_t*>(g_frontend_channel_frequency_starts);
+    filterbank.channel_weight_starts =
+        const_cast<int16_t*>(g_frontend_channel_weight_starts);
+    filterbank.channel_widths =
+        const_cast<int16_t*>(g_frontend_channel_widths);
+    filterbank.weights = const_cast<int16_t*>(g_frontend_filterbank_weights);
+    filterbank.unweights =
+        const_cast<int16_t*>(g_frontend_filterbank_unweights);
+    filterbank.work = filterbank_work;
+    noise_reduction.smoothing_bits = kNoiseReductionSmoothingBits;
+    noise_reduction.even_smoothing = kFrontendNoiseEvenSmoothing;
+    noise_reduction.odd_smoothing = kFrontendNoiseOddSmoothing;
+    noise_reduction.min_signal_remaining = kFrontendNoiseMinSignalRemaining;
+    noise_reduction.num_channels = kChannelCount;
+    noise_reduction.estimate = noise_estimate;
+    pcan.enable_pcan = kPcanGainControlEnable;
+    pcan.noise_estimate = noise_estimate;
+    pcan.num_channels = kChannelCount;
+    pcan.gain_lut = const_cast<int16_t*>(g_frontend_pcan_gain_lut);
+    pcan.snr_shift = kFrontendPcanSnrShift;
+    log_scale.enable_log = kLogScaleEnable;
+    log_scale.scale_shift = kLogScaleShift;
+  }
+};
+
+uint32_t LibrarySqrt(uint64_t value) {
+  uint64_t work[2] = {0, value};
+  FilterbankState state;
+  state.num_channels = 1;
+  state.work = work;
+  return FilterbankSqrt(&state, 0)[0];
+}
+
+uint32_t FastSqrt(uint64_t value) {
+  uint64_t work[2] = {0, value};
+  FilterbankState state;
+  state.num_channels = 1;
+  state.work = work;
+  return FastFilterbankSqrt(&state, 0)[0];
+}
+
+// Random values of every magnitude, values right around perfect squares where
+// the rounding flips, every value up to 2^26, and the ones around the 16-bit
+// root that Sqrt32() saturates at.
+long CheckSqrt() {
+  std::mt19937_64 random(1);
+  long mismatches = 0;
+  for (int i = 0; i < kSqrtFuzzCount; ++i) {
+    uint64_t value;
+    const uint64_t root = random() >> (32 + random() % 32);
+    switch (i % 4) {
+      case 0:
+        value = random() >> (random() % 64);
+        break;
+      case 1:
+        value = root * root + random() % 5 - 2;
+        break;
+      case 2:
+        value = root * root + root + random() % 3 - 1;
+        break;
+      default:
+        // The filterbank never produces more than 48 bits.
+        value = random() & ((uint64_t{1} << 48) - 1);
+        break;
+    }
+    mismatches += (FastSqrt(value) != LibrarySqrt(value)) ? 1 : 0;
+  }
+  for (uint64_t value = 0; value < (uint64_t{1} << 26); ++value) {
+    mismatches += (FastSqrt(value) != LibrarySqrt(value)) ? 1 : 0;
+  }
+  for (uint64_t root = 65530; root < 65540; ++root) {
+    for (int offset = -3; offset < 300000; offset += 997) {
+      const uint64_t value = root * root + offset;
+      mismatches += (FastSqrt(value) != LibrarySqrt(value)) ? 1 : 0;
+    }
+  }
+  return mismatches;
+}
+
+// Has several threads take the fast log path for the first time at once, so
+// they all wait on or build the table, and checks every result.
+long CheckLogTableRace() {
+  uint32_t input[kChannelCount * 32];
+  for (int i = 0; i < kChannelCount * 32; ++i) {
+    input[i] = static_cast<uint32_t>(i * 3);
+  }
+  LogScaleState state;
+  state.enable_log = 1;
+  state.scale_shift = kLogScaleShift;
+  uint32_t expected_input[kChannelCount * 32];
+  memcpy(expected_input, input, sizeof(input));
+  const uint16_t* expected =
+      LogScaleApply(&state, expected_input, kChannelCount * 32, 0);
+  long mismatches[kLogTableRacers] = {};
+  std::thread racers[kLogTableRacers];
+  for (int t = 0; t < kLogTableRacers; ++t) {
+    racers[t] = std::thread([&, t]() {
+      uint32_t signal[kChannelCount * 32];
+      memcpy(signal, input, sizeof(signal));
+      LogScaleState racer_state = state;
+      const uint16_t* output =
+          FastLogScaleApply(&racer_state, signal, kChannelCount * 32, 0);
+      mismatches[t] = memcmp(output, expected,
+                             kChannelCount * 32 * sizeof(uint16_t)) != 0;
+    });
+  }
+  long total = 0;
+  for (int t = 0; t < kLogTableRacers; ++t) {
+    racers[t].join();
+    total += mismatches[t];
+  }
+  return total;
+}
+
+}  // namespace
+
+int main() {
+  // Before anything else touches the log table.
+  const long race_mismatches = CheckLogTableRace();
+  printf("log table race: %ld mismatching threads\n", race_mismatches);
+  const long sqrt_mismatches = CheckSqrt();
+  printf("sqrt: %ld mismatching values\n", sqrt_mismatches);
+
+  static complex_int16_t spectra[kWindowCount][kSpectrumSize];
+  static int input_shifts[kWindowCount];
+  for (int w = 0; w < kWindowCount; ++w) {
+    MakeSpectrum(w, spectra[w], &input_shifts[w]);
+  }
+
+  // Same as MicroFrontend::ProcessSamples().
+  const int correction_bits =
+      MostSignificantBit32(kFrontendFftSize) - 1 - (kFilterbankBits / 2);
+  double library_ns[kStageCount] = {};
+  double fast_ns[kStageCount] = {};
+  long mismatches[kStageCount] = {};
+  long values = 0;
+  long table_hits = 0;
+  for (int pass = 0; pass < kPassCount; ++pass) {
+    // The noise estimates start over every pass, like a cold start.
+    StageStates library;
+    StageStates fast;
+    for (int w = 0; w < kWindowCount; ++w) {
+      static int32_t energy[kSpectrumSize];
+      Clock::time_point times[kStageCount + 1];
+      times[0] = Clock::now();
+      FilterbankConvertFftComplexToEnergy(&library.filterbank, spectra[w],
+                                          energy);
+      FilterbankAccumulateChannels(&library.filterbank, energy);
+      times[1] = Clock::now();
+      uint64_t library_work[kFrontendFilterbankChannelCount];
+      memcpy(library_work, library.filterbank_work, sizeof(library_work));
+      times[1] = Clock::now();
+      uint32_t* library_signal =
+          FilterbankSqrt(&library.filterbank, input_shifts[w]);
+      times[2] = Clock::now();
+      uint32_t library_sqrt[kChannelCount];
+      memcpy(library_sqrt, library_signal, sizeof(library_sqrt));
+      times[2] = Clock::now();
+      NoiseReductionApply(&library.noise_reduction, library_signal);
+      times[3] = Clock::now();
+      PcanGainControlApply(&library.pcan, library_signal);
+      times[4] = Clock::now();
+      uint32_t library_pcan[kChannelCount];
+      memcpy(library_pcan, library_signal, sizeof(library_pcan));
+      times[4] = Clock::now();
+      const uint16_t* library_output =
+          LogScaleApply(&library.log_scale, library_signal, kChannelCount,
+                        correction_bits);
+      times[5] = Clock::now();
+      for (int s = 0; s < kStageCount; ++s) {
+        library_ns[s] += Ns(times[s + 1] - times[s]);
+      }
+
+      times[0] = Clock::now();
+      FastFilterbankAccumulate(&fast.filterbank, spectra[w]);
+      times[1] = Clock::now();
+      mismatches[kFilterbankStage] +=
+          memcmp(library_work, fast.filterbank_work, sizeof(library_work)) !=
+          0;
+      times[1] = Clock::now();
+      uint32_t* fast_signal =
+          FastFilterbankSqrt(&fast.filterbank, input_shifts[w]);
+      times[2] = Clock::now();
+      mismatches[kSqrtStage] +=
+          memcmp(library_sqrt, fast_signal, sizeof(library_sqrt)) != 0;
+      times[2] = Clock::now();
+      FastNoiseReductionApply(&fast.noise_reduction, fast_signal);
+      times[3] = Clock::now();
+      FastPcanGainControlApply(&fast.pcan, fast_signal);
+      times[4] = Clock::now();
+      mismatches[kNoiseReductionStage] +=
+          memcmp(library.noise_estimate, fast.noise_estimate,
+                 sizeof(fast.noise_estimate)) != 0;
+      mismatches[kPcanStage] +=
+          memcmp(library_pcan, fast_signal, sizeof(library_pcan)) != 0;
+      for (int i = 0; pass == 0 && i < kChannelCount; ++i) {
+        ++values;
+        table_hits += (fast_signal[i] << correction_bits) < 2048;
+      }
+      times[4] = Clock::now();
+      const uint16_t* fast_output = FastLogScaleApply(
+          &fast.log_scale, fast_signal, kChannelCount, correction_bits);
+      times[5] = Clock::now();
+      for (int s = 0; s < kStageCount; ++s) {
+        fast_ns[s] += Ns(times[s + 1] - times[s]);
+      }
+      mismatches[kLogStage] +=
+          memcmp(library_output, fast_output,
+                 kChannelCount * sizeof(uint16_t)) != 0;
+    }
+  }
+
+  const int windows = kPassCount * kWindowCount;
+  double library_total = 0.0;
+  double fast_total = 0.0;
+  long total_mismatches = race_mismatches + sqrt_mismatches;
+  printf("%d windows, ns per window:\n", windows);
+  for (int s = 0; s < kStageCount; ++s) {
+    printf("  %-10s library %7.1f  fast %7.1f  mismatching windows %ld\n",
+           kStageNames[s], library_ns[s] / windows, fast_ns[s] / windows,
+           mismatches[s]);
+    library_total += library_ns[s];
+    fast_total += fast_ns[s];
+    total_mismatches += mismatches[s];
+  }
+  printf("  total      library %7.1f  fast %7.1f\n", library_total / windows,
+         fast_total / windows);
+  printf("log table hits: %.1f%%\n", 100.0 * table_hits / values);
+  return total_mismatches == 0 ? 0 : 1;
+}
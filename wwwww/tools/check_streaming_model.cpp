@@ -0,0 +1,146 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that checks StreamingModel against the interpreter running the
+// whole window, with far more windows than the device check has time for:
+// CompareStreamingInference() over the recorded samples, then a stream of
+// random slices that moves by random amounts, including restarts. Both have
+// to match the interpreter's logits and scores exactly on every window. It
+// needs TensorFlow Lite Micro built for the host, from the same release the
+// device uses:
+//
+//   g++ -std=c++11 -O2 -I tools/host -I src -I <tflite-micro>
+//       -I <flatbuffers>/include tools/check_streaming_model.cpp
+//       src/streaming_model.cpp src/streaming_model_check.cpp src/model.cpp
+//       src/yes_micro_features_data.cpp src/no_micro_features_data.cpp
+//       <tflite-micro>/libtensorflow-microlite.a -o /tmp/check_streaming_model
+//   /tmp/check_streaming_model [window count]
+//
+// tools/host stands in for the Xtensa cycle counter, so the "cycles" it
+// reports are nanoseconds.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+#include "micro_model_settings.h"
+#include "model.h"
+#include "streaming_model.h"
+#include "streaming_model_check.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+
+namespace {
+
+constexpr int kDefaultWindowCount = 20000;
+// Same sizes as main.cpp.
+constexpr int kTensorArenaSize = 10 * 1024;
+constexpr int kStreamingScratchSize = 10 * 1024;
+alignas(16) uint8_t tensor_arena[kTensorArenaSize];
+int8_t streaming_scratch[kStreamingScratchSize];
+
+// Feeds windows of random slices, moving the stream by one to a few slices,
+// or by more than a whole window now and then, and returns how many windows
+// differ from the interpreter.
+int CompareRandomStream(tflite::ErrorReporter* error_reporter,
+                        const tflite::Model* model,
+                        tflite::MicroInterpreter* interpreter,
+                        StreamingModel* streaming_model, int window_count) {
+  const tflite::SubGraph* subgraph = model->subgraphs()->Get(0);
+  const tflite::Operator* last_op =
+      subgraph->operators()->Get(subgraph->operators()->size() - 1);
+  const TfLiteTensor* interpreter_logits =
+      interpreter->tensor(last_op->inputs()->Get(0));
+  const TfLiteTensor* interpreter_scores = interpreter->output(0);
+  int8_t* input = interpreter->input(0)->data.int8;
+
+  std::mt19937 random(1);
+  std::uniform_int_distribution<int> feature(-128, 127);
+  std::uniform_int_distribution<int> step(0, 99);
+  int differing_windows = 0;
+  for (int i = 0; i < window_count; ++i) {
+    const int roll = step(random);
+    int new_slices = 1;
+    if (i == 0 || roll < 2) {
+      new_slices = kFeatureSliceCount + roll;
+    } else if (roll < 12) {
+      new_slices = 2 + roll % 4;
+    }
+    const int kept_slices =
+        new_slices < kFeatureSliceCount ? kFeatureSliceCount - new_slices : 0;
+    memmove(input, input + (kFeatureSliceCount - kept_slices) *
+                               kFeatureSliceSize,
+            kept_slices * kFeatureSliceSize);
+    for (int j = kept_slices * kFeatureSliceSize; j < kFeatureElementCount;
+         ++j) {
+      input[j] = static_cast<int8_t>(feature(random));
+    }
+    if (streaming_model->Invoke(input, new_slices) != kTfLiteOk ||
+        interpreter->Invoke() != kTfLiteOk) {
+      TF_LITE_REPORT_ERROR(error_reporter, "Invoke() failed");
+      return window_count;
+    }
+    if (memcmp(streaming_model->logits(), interpreter_logits->data.int8,
+               kCategoryCount) != 0 ||
+        memcmp(streaming_model->output()->data.int8,
+               interpreter_scores->data.int8, kCategoryCount) != 0) {
+      ++differing_windows;
+    }
+  }
+  return differing_windows;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int window_count =
+      (argc > 1) ? atoi(argv[1]) : kDefaultWindowCount;
+  tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+
+  tflite::MicroMutableOpResolver<4> op_resolver(error_reporter);
+  if (op_resolver.AddDepthwiseConv2D() != kTfLiteOk ||
+      op_resolver.AddFullyConnected() != kTfLiteOk ||
+      op_resolver.AddReshape() != kTfLiteOk ||
+      op_resolver.AddSoftmax() != kTfLiteOk) {
+    return 1;
+  }
+  const tflite::Model* model = tflite::GetModel(g_model);
+  tflite::MicroInterpreter interpreter(model, op_resolver, tensor_arena,
+                                       kTensorArenaSize, error_reporter);
+  if (interpreter.AllocateTensors() != kTfLiteOk) {
+    fprintf(stderr, "AllocateTensors() failed\n");
+    return 1;
+  }
+  StreamingModel streaming_model(streaming_scratch, kStreamingScratchSize,
+                                 nullptr);
+  if (streaming_model.Initialize(error_reporter, model) != kTfLiteOk) {
+    return 1;
+  }
+
+  if (CompareStreamingInference(error_reporter, model, &interpreter,
+                                &streaming_model,
+                                window_count) != kTfLiteOk) {
+    return 1;
+  }
+  const int differing_windows = CompareRandomStream(
+      error_reporter, model, &interpreter, &streaming_model, window_count);
+  printf("Random stream: %d of %d windows differ\n", differing_windows,
+         window_count);
+  return differing_windows == 0 ? 0 : 1;
+}
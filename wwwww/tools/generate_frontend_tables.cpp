@@ -0,0 +1,385 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that precomputes the feature frontend's constant tables for the
+// settings in src/micro_model_settings.h, so the device doesn't have to build
+// them from floats at startup. Writes frontend_tables.h and frontend_tables.cpp
+// into the given directory:
+//
+//   g++ -std=c++11 -I src tools/generate_frontend_tables.cpp -o /tmp/gen
+//   /tmp/gen src
+//
+// The math follows FrontendPopulateState() and the *_util.c files of the
+// microfrontend library step by step, down to which parts are done in float
+// and which in double, so the tables match what the library computes. Rerun
+// this whenever the frontend settings change.
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "micro_model_settings.h"
+
+namespace {
+
+// Constants from the microfrontend library.
+constexpr int kFrontendWindowBits = 12;
+constexpr int kFilterbankBits = 12;
+constexpr int kFilterbankIndexAlignment = 4;
+constexpr int kFilterbankChannelBlockSize = 4;
+constexpr int kNoiseReductionBits = 14;
+constexpr int kPcanSnrBits = 12;
+constexpr int kWideDynamicFunctionBits = 32;
+constexpr int kWideDynamicFunctionLUTSize = 4 * kWideDynamicFunctionBits - 3;
+
+struct Tables {
+  int window_size;
+  int window_step;
+  std::vector<int16_t> window_coefficients;
+  int fft_size;
+  int filterbank_start_index;
+  int filterbank_end_index;
+  std::vector<int16_t> channel_frequency_starts;
+  std::vector<int16_t> channel_weight_starts;
+  std::vector<int16_t> channel_widths;
+  std::vector<int16_t> weights;
+  std::vector<int16_t> unweights;
+  uint16_t even_smoothing;
+  uint16_t odd_smoothing;
+  uint16_t min_signal_remaining;
+  int32_t snr_shift;
+  std::vector<int16_t> gain_lut;
+};
+
+int MostSignificantBit32(uint32_t n) {
+  int bit = 0;
+  while (n > 0) {
+    ++bit;
+    n >>= 1;
+  }
+  return bit;
+}
+
+// WindowPopulateState().
+void GenerateWindow(Tables* tables) {
+  tables->window_size = ModelPipelineConfig::kWindowSamples;
+  tables->window_step = ModelPipelineConfig::kStrideSamples;
+  const float arg = M_PI * 2.0 / (static_cast<float>(tables->window_size));
+  for (int i = 0; i < tables->window_size; ++i) {
+    const float float_value = 0.5 - (0.5 * cos(arg * (i + 0.5)));
+    tables->window_coefficients.push_back(
+        floor(float_value * (1 << kFrontendWindowBits) + 0.5));
+  }
+}
+
+float FreqToMel(float freq) { return 1127.0 * log1p(freq / 700.0); }
+
+// FilterbankPopulateState().
+bool GenerateFilterbank(Tables* tables) {
+  const int num_channels_plus_1 = kFeatureSliceSize + 1;
+  const int spectrum_size = tables->fft_size / 2 + 1;
+  const int index_alignment = kFilterbankIndexAlignment / sizeof(int16_t);
+
+  std::vector<float> center_mel_freqs(num_channels_plus_1);
+  const float mel_low = FreqToMel(kFilterbankLowerBandLimit);
+  const float mel_hi = FreqToMel(kFilterbankUpperBandLimit);
+  const float mel_span = mel_hi - mel_low;
+  const float mel_spacing = mel_span / static_cast<float>(num_channels_plus_1);
+  for (int i = 0; i < num_channels_plus_1; ++i) {
+    center_mel_freqs[i] = mel_low + (mel_spacing * (i + 1));
+  }
+
+  // Always exclude DC.
+  const float hz_per_sbin =
+      0.5 * kAudioSampleFrequency / (static_cast<float>(spectrum_size) - 1);
+  tables->filterbank_start_index =
+      1.5 + kFilterbankLowerBandLimit / hz_per_sbin;
+  tables->filterbank_end_index = 0;
+
+  tables->channel_frequency_starts.resize(num_channels_plus_1);
+  tables->channel_weight_starts.resize(num_channels_plus_1);
+  tables->channel_widths.resize(num_channels_plus_1);
+  std::vector<int16_t> actual_channel_starts(num_channels_plus_1);
+  std::vector<int16_t> actual_channel_widths(num_channels_plus_1);
+
+  int chan_freq_index_start = tables->filterbank_start_index;
+  int weight_index_start = 0;
+  bool needs_zeros = false;
+  for (int chan = 0; chan < num_channels_plus_1; ++chan) {
+    int freq_index = chan_freq_index_start;
+    while (FreqToMel(freq_index * hz_per_sbin) <= center_mel_freqs[chan]) {
+      ++freq_index;
+    }
+    const int width = freq_index - chan_freq_index_start;
+    actual_channel_starts[chan] = chan_freq_index_start;
+    actual_channel_widths[chan] = width;
+    if (width == 0) {
+      // Channels without any frequencies all point at one block of zero
+      // weights at the start of the arrays.
+      tables->channel_frequency_starts[chan] = 0;
+      tables->channel_weight_starts[chan] = 0;
+      tables->channel_widths[chan] = kFilterbankChannelBlockSize;
+      if (!needs_zeros) {
+        needs_zeros = true;
+        for (int j = 0; j < chan; ++j) {
+          tables->channel_weight_starts[j] += kFilterbankChannelBlockSize;
+        }
+        weight_index_start += kFilterbankChannelBlockSize;
+      }
+    } else {
+      const int aligned_start =
+          (chan_freq_index_start / index_alignment) * index_alignment;
+      const int aligned_width = chan_freq_index_start - aligned_start + width;
+      const int padded_width =
+          (((aligned_width - 1) / kFilterbankChannelBlockSize) + 1) *
+          kFilterbankChannelBlockSize;
+      tables->channel_frequency_starts[chan] = aligned_start;
+      tables->channel_weight_starts[chan] = weight_index_start;
+      tables->channel_widths[chan] = padded_width;
+      weight_index_start += padded_width;
+    }
+    chan_freq_index_start = freq_index;
+  }
+
+  tables->weights.assign(weight_index_start, 0);
+  tables->unweights.assign(weight_index_start, 0);
+  for (int chan = 0; chan < num_channels_plus_1; ++chan) {
+    int frequency = actual_channel_starts[chan];
+    const int num_frequencies = actual_channel_widths[chan];
+    const int frequency_offset =
+        frequency - tables->channel_frequency_starts[chan];
+    const int weight_start = tables->channel_weight_starts[chan];
+    const float denom_val = (chan == 0) ? mel_low : center_mel_freqs[chan - 1];
+    for (int j = 0; j < num_frequencies; ++j, ++frequency) {
+      const float weight =
+          (center_mel_freqs[chan] - FreqToMel(frequency * hz_per_sbin)) /
+          (center_mel_freqs[chan] - denom_val);
+      const int weight_index = weight_start + frequency_offset + j;
+      tables->weights[weight_index] =
+          floor(weight * (1 << kFilterbankBits) + 0.5);
+      tables->unweights[weight_index] =
+          floor((1.0 - weight) * (1 << kFilterbankBits) + 0.5);
+    }
+    if (frequency > tables->filterbank_end_index) {
+      tables->filterbank_end_index = frequency;
+    }
+  }
+  if (tables->filterbank_end_index >= spectrum_size) {
+    fprintf(stderr, "Filterbank end_index is above spectrum size.\n");
+    return false;
+  }
+  return true;
+}
+
+// NoiseReductionPopulateState().
+void GenerateNoiseReduction(Tables* tables) {
+  tables->even_smoothing =
+      kNoiseReductionEvenSmoothing * (1 << kNoiseReductionBits);
+  tables->odd_smoothing =
+      kNoiseReductionOddSmoothing * (1 << kNoiseReductionBits);
+  tables->min_signal_remaining =
+      kNoiseReductionMinSignalRemaining * (1 << kNoiseReductionBits);
+}
+
+int16_t PcanGainLookupFunction(int32_t input_bits, uint32_t x) {
+  const float x_as_float =
+      static_cast<float>(x) / (static_cast<uint32_t>(1) << input_bits);
+  const float gain_as_float =
+      (static_cast<uint32_t>(1) << kPcanGainControlGainBits) *
+      powf(x_as_float + kPcanGainControlOffset, -kPcanGainControlStrength);
+  if (gain_as_float > INT16_MAX) {
+    return INT16_MAX;
+  }
+  return static_cast<int16_t>(gain_as_float + 0.5f);
+}
+
+// PcanGainControlPopulateState().
+void GeneratePcanGainControl(Tables* tables) {
+  const int32_t input_correction_bits =
+      MostSignificantBit32(tables->fft_size) - 1 - (kFilterbankBits / 2);
+  tables->snr_shift =
+      kPcanGainControlGainBits - input_correction_bits - kPcanSnrBits;
+  const int32_t input_bits =
+      kNoiseReductionSmoothingBits - input_correction_bits;
+  // The library leaves the unused fourth entry of every interval
+  // uninitialized, here it's zero.
+  tables->gain_lut.assign(kWideDynamicFunctionLUTSize, 0);
+  tables->gain_lut[0] = PcanGainLookupFunction(input_bits, 0);
+  tables->gain_lut[1] = PcanGainLookupFunction(input_bits, 1);
+  for (int interval = 2; interval <= kWideDynamicFunctionBits; ++interval) {
+    const uint32_t x0 = static_cast<uint32_t>(1) << (interval - 1);
+    const uint32_t x1 = x0 + (x0 >> 1);
+    const uint32_t x2 =
+        (interval == kWideDynamicFunctionBits) ? x0 + (x0 - 1) : 2 * x0;
+    const int16_t y0 = PcanGainLookupFunction(input_bits, x0);
+    const int16_t y1 = PcanGainLookupFunction(input_bits, x1);
+    const int16_t y2 = PcanGainLookupFunction(input_bits, x2);
+    const int32_t diff1 = static_cast<int32_t>(y1) - y0;
+    const int32_t diff2 = static_cast<int32_t>(y2) - y0;
+    const int32_t a1 = 4 * diff1 - diff2;
+    const int32_t a2 = diff2 - a1;
+    tables->gain_lut[4 * interval - 6] = y0;
+    tables->gain_lut[4 * interval - 6 + 1] = static_cast<int16_t>(a1);
+    tables->gain_lut[4 * interval - 6 + 2] = static_cast<int16_t>(a2);
+  }
+}
+
+void WriteArray(FILE* file, const char* name, const std::vector<int16_t>& data,
+                const char* size_name) {
+  fprintf(file, "const int16_t %s[%s] = {", name, size_name);
+  for (size_t i = 0; i < data.size(); ++i) {
+    fprintf(file, "%s%d,", (i % 10 == 0) ? "\n    " : " ", data[i]);
+  }
+  fprintf(file, "\n};\n\n");
+}
+
+const char kLicense[] =
+    "/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.\n"
+    "\n"
+    "Licensed under the Apache License, Version 2.0 (the \"License\");\n"
+    "you may not use this file except in compliance with the License.\n"
+    "You may obtain a copy of the License at\n"
+    "\n"
+    "    http://www.apache.org/licenses/LICENSE-2.0\n"
+    "\n"
+    "Unless required by applicable law or agreed to in writing, software\n"
+    "distributed under the License is distributed on an \"AS IS\" BASIS,\n"
+    "WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or "
+    "implied.\n"
+    "See the License for the specific language governing permissions and\n"
+    "limitations under the License.\n"
+    "=============================================================="
+    "================*/\n\n";
+
+bool WriteHeader(const std::string& path, const Tables& tables) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  fputs(kLicense, file);
+  fputs(
+      "// Generated by tools/generate_frontend_tables.cpp from the settings "
+      "in\n// micro_model_settings.h. Don't edit, rerun the tool instead.\n\n"
+      "#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_TABLES_H_\n"
+      "#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_TABLES_H_\n"
+      "\n#include <cstdint>\n\n",
+      file);
+  fprintf(file, "constexpr int kFrontendWindowSize = %d;\n",
+          tables.window_size);
+  fprintf(file, "constexpr int kFrontendWindowStep = %d;\n",
+          tables.window_step);
+  fprintf(file, "constexpr int kFrontendFftSize = %d;\n", tables.fft_size);
+  fprintf(file, "constexpr int kFrontendFilterbankStartIndex = %d;\n",
+          tables.filterbank_start_index);
+  fprintf(file, "constexpr int kFrontendFilterbankEndIndex = %d;\n",
+          tables.filterbank_end_index);
+  fprintf(file, "constexpr int kFrontendFilterbankChannelCount = %d;\n",
+          static_cast<int>(tables.channel_widths.size()));
+  fprintf(file, "constexpr int kFrontendFilterbankWeightCount = %d;\n",
+          static_cast<int>(tables.weights.size()));
+  fprintf(file, "constexpr uint16_t kFrontendNoiseEvenSmoothing = %d;\n",
+          tables.even_smoothing);
+  fprintf(file, "constexpr uint16_t kFrontendNoiseOddSmoothing = %d;\n",
+          tables.odd_smoothing);
+  fprintf(file, "constexpr uint16_t kFrontendNoiseMinSignalRemaining = %d;\n",
+          tables.min_signal_remaining);
+  fprintf(file, "constexpr int32_t kFrontendPcanSnrShift = %d;\n",
+          tables.snr_shift);
+  fprintf(file, "constexpr int kFrontendPcanGainLutSize = %d;\n\n",
+          static_cast<int>(tables.gain_lut.size()));
+  fputs(
+      "// The filterbank arrays have one more channel than there are "
+      "features, the\n// extra one only bounds the last feature's "
+      "frequencies.\n",
+      file);
+  const char* const arrays[][2] = {
+      {"g_frontend_window_coefficients", "kFrontendWindowSize"},
+      {"g_frontend_channel_frequency_starts",
+       "kFrontendFilterbankChannelCount"},
+      {"g_frontend_channel_weight_starts", "kFrontendFilterbankChannelCount"},
+      {"g_frontend_channel_widths", "kFrontendFilterbankChannelCount"},
+      {"g_frontend_filterbank_weights", "kFrontendFilterbankWeightCount"},
+      {"g_frontend_filterbank_unweights", "kFrontendFilterbankWeightCount"},
+      {"g_frontend_pcan_gain_lut", "kFrontendPcanGainLutSize"},
+  };
+  for (const auto& array : arrays) {
+    fprintf(file, "extern const int16_t %s[%s];\n", array[0], array[1]);
+  }
+  fputs(
+      "\n"
+      "#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_FRONTEND_TABLES_"
+      "H_\n",
+      file);
+  return fclose(file) == 0;
+}
+
+bool WriteSource(const std::string& path, const Tables& tables) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  fputs(kLicense, file);
+  fputs(
+      "// Generated by tools/generate_frontend_tables.cpp from the settings "
+      "in\n// micro_model_settings.h. Don't edit, rerun the tool instead.\n\n"
+      "#include \"frontend_tables.h\"\n\n",
+      file);
+  WriteArray(file, "g_frontend_window_coefficients",
+             tables.window_coefficients, "kFrontendWindowSize");
+  WriteArray(file, "g_frontend_channel_frequency_starts",
+             tables.channel_frequency_starts,
+             "kFrontendFilterbankChannelCount");
+  WriteArray(file, "g_frontend_channel_weight_starts",
+             tables.channel_weight_starts, "kFrontendFilterbankChannelCount");
+  WriteArray(file, "g_frontend_channel_widths", tables.channel_widths,
+             "kFrontendFilterbankChannelCount");
+  WriteArray(file, "g_frontend_filterbank_weights", tables.weights,
+             "kFrontendFilterbankWeightCount");
+  WriteArray(file, "g_frontend_filterbank_unweights", tables.unweights,
+             "kFrontendFilterbankWeightCount");
+  WriteArray(file, "g_frontend_pcan_gain_lut", tables.gain_lut,
+             "kFrontendPcanGainLutSize");
+  return fclose(file) == 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <output directory>\n", argv[0]);
+    return 1;
+  }
+  Tables tables;
+  GenerateWindow(&tables);
+  tables.fft_size = 1;
+  while (tables.fft_size < tables.window_size) {
+    tables.fft_size <<= 1;
+  }
+  if (!GenerateFilterbank(&tables)) {
+    return 1;
+  }
+  GenerateNoiseReduction(&tables);
+  GeneratePcanGainControl(&tables);
+
+  const std::string directory = argv[1];
+  if (!WriteHeader(directory + "/frontend_tables.h", tables) ||
+      !WriteSource(directory + "/frontend_tables.cpp", tables)) {
+    fprintf(stderr, "Couldn't write the tables to %s\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}
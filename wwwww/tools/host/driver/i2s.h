@@ -0,0 +1,120 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host stand-in for the ESP-IDF I2S driver, so the capture task can run from
+// the tools. i2s_read() paces itself like the microphone does at the sample
+// rate it was set up with, and fills the samples with a 440Hz tone, left
+// justified in 32 bits like the INMP441 delivers it.
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_DRIVER_I2S_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_DRIVER_I2S_H_
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+#include "esp_err.h"
+#include "freertos/FreeRTOS.h"
+
+typedef enum { I2S_NUM_0 } i2s_port_t;
+typedef int i2s_mode_t;
+enum {
+  I2S_MODE_MASTER = 1,
+  I2S_MODE_RX = 4,
+  I2S_BITS_PER_SAMPLE_32BIT = 32,
+  I2S_CHANNEL_FMT_ONLY_LEFT = 4,
+  I2S_COMM_FORMAT_STAND_I2S = 1,
+  ESP_INTR_FLAG_LEVEL1 = 2,
+  I2S_PIN_NO_CHANGE = -1
+};
+
+typedef struct {
+  i2s_mode_t mode;
+  int sample_rate;
+  int bits_per_sample;
+  int channel_format;
+  int communication_format;
+  int intr_alloc_flags;
+  int dma_buf_count;
+  int dma_buf_len;
+  bool use_apll;
+  bool tx_desc_auto_clear;
+  int fixed_mclk;
+} i2s_config_t;
+
+typedef struct {
+  int bck_io_num;
+  int ws_io_num;
+  int data_out_num;
+  int data_in_num;
+} i2s_pin_config_t;
+
+// When the next sample is due, and what it is.
+struct HostI2s {
+  int sample_rate = 16000;
+  std::chrono::steady_clock::time_point next_sample_time =
+      std::chrono::steady_clock::now();
+  uint64_t next_sample = 0;
+};
+
+inline HostI2s& HostI2sState() {
+  static HostI2s state;
+  return state;
+}
+
+inline esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t* config,
+                                    int queue_size, void* queue) {
+  (void)port;
+  (void)queue_size;
+  (void)queue;
+  HostI2sState().sample_rate = config->sample_rate;
+  HostI2sState().next_sample_time = std::chrono::steady_clock::now();
+  return ESP_OK;
+}
+
+inline esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t* pins) {
+  (void)port;
+  (void)pins;
+  return ESP_OK;
+}
+
+inline esp_err_t i2s_zero_dma_buffer(i2s_port_t port) {
+  (void)port;
+  return ESP_OK;
+}
+
+// Returns once the last of the samples asked for would have been captured.
+inline esp_err_t i2s_read(i2s_port_t port, void* data, size_t size,
+                          size_t* bytes_read, TickType_t ticks_to_wait) {
+  (void)port;
+  (void)ticks_to_wait;
+  HostI2s& i2s = HostI2sState();
+  int32_t* samples = static_cast<int32_t*>(data);
+  const size_t count = size / sizeof(int32_t);
+  for (size_t i = 0; i < count; ++i, ++i2s.next_sample) {
+    const double t = static_cast<double>(i2s.next_sample) / i2s.sample_rate;
+    samples[i] = static_cast<int32_t>(
+        0.1 * 2147483647.0 * std::sin(2.0 * 3.14159265358979 * 440.0 * t));
+  }
+  i2s.next_sample_time += std::chrono::microseconds(
+      static_cast<int64_t>(count) * 1000000 / i2s.sample_rate);
+  std::this_thread::sleep_until(i2s.next_sample_time);
+  *bytes_read = count * sizeof(int32_t);
+  return ESP_OK;
+}
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_DRIVER_I2S_H_
@@ -0,0 +1,33 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host stand-in for the ESP-IDF log macros, so code that logs can run from
+// the tools. Everything up to ESP_LOGI goes to stdout, the debug levels are
+// dropped.
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_ESP_LOG_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_ESP_LOG_H_
+
+#include <stdio.h>
+
+#define ESP_HOST_LOG(level, tag, format, ...) \
+  printf(level " (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGE(tag, format, ...) ESP_HOST_LOG("E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_HOST_LOG("W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_HOST_LOG("I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ((void)(tag))
+#define ESP_LOGV(tag, format, ...) ((void)(tag))
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_ESP_LOG_H_
@@ -0,0 +1,100 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host stand-in for FreeRTOS semaphores and mutexes, built on pthreads. Both
+// are binary: giving one that's already available does nothing, and anyone
+// may give a mutex, which is all ringbuf.c relies on.
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_FREERTOS_SEMPHR_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_FREERTOS_SEMPHR_H_
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct HostSemaphore {
+  pthread_mutex_t mutex;
+  pthread_cond_t available;
+  int count;
+} HostSemaphore;
+typedef HostSemaphore* SemaphoreHandle_t;
+typedef SemaphoreHandle_t xSemaphoreHandle;
+
+static inline SemaphoreHandle_t HostSemaphoreCreate(int count) {
+  HostSemaphore* semaphore = (HostSemaphore*)malloc(sizeof(HostSemaphore));
+  if (semaphore != NULL) {
+    pthread_mutex_init(&semaphore->mutex, NULL);
+    pthread_cond_init(&semaphore->available, NULL);
+    semaphore->count = count;
+  }
+  return semaphore;
+}
+
+// Like on FreeRTOS, the old-style binary semaphore starts out given and the
+// new one doesn't.
+#define vSemaphoreCreateBinary(semaphore) \
+  ((semaphore) = HostSemaphoreCreate(1))
+#define xSemaphoreCreateBinary() HostSemaphoreCreate(0)
+#define xSemaphoreCreateMutex() HostSemaphoreCreate(1)
+
+static inline void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+  pthread_cond_destroy(&semaphore->available);
+  pthread_mutex_destroy(&semaphore->mutex);
+  free(semaphore);
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore,
+                                        TickType_t ticks_to_wait) {
+  struct timespec deadline;
+  if (ticks_to_wait != portMAX_DELAY) {
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += ticks_to_wait / 1000;
+    deadline.tv_nsec += (long)(ticks_to_wait % 1000) * 1000000;
+    if (deadline.tv_nsec >= 1000000000) {
+      deadline.tv_nsec -= 1000000000;
+      ++deadline.tv_sec;
+    }
+  }
+  pthread_mutex_lock(&semaphore->mutex);
+  int timed_out = 0;
+  while (semaphore->count == 0 && !timed_out) {
+    if (ticks_to_wait == portMAX_DELAY) {
+      pthread_cond_wait(&semaphore->available, &semaphore->mutex);
+    } else {
+      timed_out = pthread_cond_timedwait(&semaphore->available,
+                                         &semaphore->mutex,
+                                         &deadline) == ETIMEDOUT;
+    }
+  }
+  const BaseType_t taken = semaphore->count > 0 ? pdTRUE : pdFALSE;
+  if (taken) {
+    semaphore->count = 0;
+  }
+  pthread_mutex_unlock(&semaphore->mutex);
+  return taken;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+  pthread_mutex_lock(&semaphore->mutex);
+  semaphore->count = 1;
+  pthread_cond_signal(&semaphore->available);
+  pthread_mutex_unlock(&semaphore->mutex);
+  return pdTRUE;
+}
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_FREERTOS_SEMPHR_H_
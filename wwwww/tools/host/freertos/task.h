@@ -0,0 +1,129 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host stand-in for the FreeRTOS task API, so code that runs tasks and wakes
+// them with direct-to-task notifications can run from the tools. Tasks are
+// detached threads and a tick is a millisecond. From C only the types are
+// there.
+
+#ifndef TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_FREERTOS_TASK_H_
+#define TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_FREERTOS_TASK_H_
+
+#include "freertos/FreeRTOS.h"
+
+typedef struct HostTask* TaskHandle_t;
+typedef void (*TaskFunction_t)(void*);
+
+#ifdef __cplusplus
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Notification value of a task, and what it waits on.
+struct HostTask {
+  std::mutex mutex;
+  std::condition_variable notified;
+  uint32_t value = 0;
+};
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle() {
+  static thread_local HostTask task;
+  return &task;
+}
+
+inline TickType_t xTaskGetTickCount() {
+  static const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  return static_cast<TickType_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+}
+
+inline void vTaskDelay(TickType_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task) {
+  std::lock_guard<std::mutex> lock(task->mutex);
+  ++task->value;
+  task->notified.notify_one();
+  return pdPASS;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit,
+                                 TickType_t ticks_to_wait) {
+  HostTask* task = xTaskGetCurrentTaskHandle();
+  std::unique_lock<std::mutex> lock(task->mutex);
+  auto has_value = [task]() { return task->value != 0; };
+  if (ticks_to_wait == portMAX_DELAY) {
+    task->notified.wait(lock, has_value);
+  } else {
+    task->notified.wait_for(lock, std::chrono::milliseconds(ticks_to_wait),
+                            has_value);
+  }
+  const uint32_t value = task->value;
+  if (value != 0) {
+    task->value = clear_on_exit ? 0 : value - 1;
+  }
+  return value;
+}
+
+// The priority, stack size and core are ignored, the host schedules the
+// threads as it likes.
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function,
+                                          const char* name, uint32_t stack,
+                                          void* arg, UBaseType_t priority,
+                                          TaskHandle_t* handle,
+                                          BaseType_t core) {
+  (void)name;
+  (void)stack;
+  (void)priority;
+  (void)core;
+  std::mutex started_mutex;
+  std::condition_variable started;
+  TaskHandle_t task = nullptr;
+  std::thread([&, function, arg]() {
+    {
+      std::lock_guard<std::mutex> lock(started_mutex);
+      task = xTaskGetCurrentTaskHandle();
+      started.notify_one();
+    }
+    function(arg);
+  }).detach();
+  std::unique_lock<std::mutex> lock(started_mutex);
+  started.wait(lock, [&task]() { return task != nullptr; });
+  if (handle != nullptr) {
+    *handle = task;
+  }
+  return pdPASS;
+}
+
+inline BaseType_t xTaskCreate(TaskFunction_t function, const char* name,
+                              uint32_t stack, void* arg, UBaseType_t priority,
+                              TaskHandle_t* handle) {
+  return xTaskCreatePinnedToCore(function, name, stack, arg, priority, handle,
+                                 0);
+}
+
+// A thread can't be stopped from outside, tasks on the host just run until
+// the tool exits.
+inline void vTaskDelete(TaskHandle_t task) { (void)task; }
+
+#endif  // __cplusplus
+
+#endif  // TENSORFLOW_LITE_MICRO_EXAMPLES_MICRO_SPEECH_TOOLS_HOST_FREERTOS_TASK_H_
@@ -0,0 +1,85 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that runs the audio provider the way the feature task does, a
+// stride at a time, against a stand-in microphone, and prints the capture
+// stats, including how often the task was woken and how long after the write
+// it waited for. tools/host stands in for FreeRTOS tasks and notifications
+// and for the I2S driver, so the latencies are the host scheduler's, not the
+// device's; the wakeup counts carry over. It only needs the TensorFlow Lite
+// Micro headers:
+//
+//   g++ -std=c++11 -O2 -pthread -I tools/host -I src -I <tflite-micro>
+//       tools/measure_audio_wakeups.cpp src/audio_provider.cpp
+//       -o /tmp/measure_audio_wakeups
+//   /tmp/measure_audio_wakeups [seconds]
+//
+// It exits with a nonzero status if the feature task lost audio.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "audio_provider.h"
+#include "micro_model_settings.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+
+namespace {
+
+constexpr int kDefaultSeconds = 10;
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  const int seconds = (argc > 1) ? atoi(argv[1]) : kDefaultSeconds;
+  if (seconds <= 0) {
+    fprintf(stderr, "Usage: %s [seconds]\n", argv[0]);
+    return 1;
+  }
+  tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+
+  // Starts the capture task, and the stats with it.
+  AudioCaptureBuffer::Span span;
+  if (GetAudioStrides(error_reporter, 1, &span) != kTfLiteOk) {
+    return 1;
+  }
+  LogAudioCaptureStats();
+  const int32_t start_time = LatestAudioTimestamp();
+  int32_t previous_time = start_time;
+  int32_t lost_samples = TakeLostAudioSamples();
+  while (previous_time - start_time < seconds * 1000) {
+    // Like FeaturePipeline::Run(), sleep until the next stride and take
+    // whatever strides are new.
+    WaitForAudioTimestamp(
+        ((previous_time / kFeatureSliceStrideMs) + 1) * kFeatureSliceStrideMs,
+        kFeatureSliceStrideMs * 5);
+    const int32_t current_time = LatestAudioTimestamp();
+    const int new_strides = current_time / kFeatureSliceStrideMs -
+                            previous_time / kFeatureSliceStrideMs;
+    if (new_strides > 0 &&
+        GetAudioStrides(error_reporter, new_strides, &span) != kTfLiteOk) {
+      return 1;
+    }
+    previous_time = current_time;
+    lost_samples += TakeLostAudioSamples();
+  }
+  LogAudioCaptureStats();
+  if (lost_samples != 0) {
+    fprintf(stderr, "The feature task lost %d samples\n",
+            static_cast<int>(lost_samples));
+    return 1;
+  }
+  return 0;
+}
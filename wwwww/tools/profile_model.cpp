@@ -0,0 +1,183 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that runs the model through the interpreter with an OpProfiler
+// attached, prints the per-op timings as CSV, and writes the timeline as a
+// Chrome trace. It needs TensorFlow Lite Micro built for the host, from the
+// same release the device uses:
+//
+//   g++ -std=c++11 -O2 -I src -I <tflite-micro> -I <flatbuffers>/include
+//       tools/profile_model.cpp src/op_profiler.cpp src/model.cpp
+//       src/specialized_kernels.cpp src/wrapping_op_resolver.cpp
+//       src/model_loader.cpp src/streaming_model.cpp
+//       src/yes_micro_features_data.cpp src/no_micro_features_data.cpp
+//       <tflite-micro>/libtensorflow-microlite.a -o /tmp/profile_model
+//   /tmp/profile_model /tmp/micro_speech_trace.json
+//
+// Adding "specialized" after the trace file runs DepthwiseConv2D and
+// FullyConnected on the kernels from specialized_kernels.h instead of the
+// reference ones. Adding "streaming" runs the model through StreamingModel
+// instead of the interpreter, always on the reference kernels, one new slice
+// per invocation like -DMICRO_SPEECH_STREAMING does, with the same op names
+// and indices. Adding the path of a .tflite file runs that model instead of
+// the built-in one, mapped in place the way the device maps its model
+// partition, and checked the same way.
+//
+// Host timings only show where the time goes relative to the other ops, the
+// device figures come from a build with -DMICRO_SPEECH_OP_PROFILE.
+
+#include <cstdio>
+#include <cstring>
+
+#include "micro_model_settings.h"
+#include "model.h"
+#include "model_loader.h"
+#include "no_micro_features_data.h"
+#include "op_profiler.h"
+#include "specialized_kernels.h"
+#include "streaming_model.h"
+#include "tensorflow/lite/micro/micro_error_reporter.h"
+#include "tensorflow/lite/micro/micro_interpreter.h"
+#include "tensorflow/lite/micro/micro_mutable_op_resolver.h"
+#include "tensorflow/lite/schema/schema_generated.h"
+#include "yes_micro_features_data.h"
+
+namespace {
+
+// Generous, the device build is where the arena size matters.
+constexpr int kTensorArenaSize = 16 * 1024;
+uint8_t tensor_arena[kTensorArenaSize];
+// Same size as main.cpp.
+constexpr int kStreamingScratchSize = 10 * 1024;
+int8_t streaming_scratch[kStreamingScratchSize];
+int8_t features[kFeatureElementCount];
+
+// Static, it's too big for the stack.
+OpProfiler profiler;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 4) {
+    fprintf(stderr,
+            "Usage: %s <trace.json> [specialized|streaming] [model.tflite]\n",
+            argv[0]);
+    return 1;
+  }
+  bool use_specialized = false;
+  bool use_streaming = false;
+  const char* model_path = nullptr;
+  for (int i = 2; i < argc; ++i) {
+    if (strcmp(argv[i], "specialized") == 0) {
+      use_specialized = true;
+    } else if (strcmp(argv[i], "streaming") == 0) {
+      use_streaming = true;
+    } else {
+      model_path = argv[i];
+    }
+  }
+
+  tflite::MicroErrorReporter micro_error_reporter;
+  tflite::ErrorReporter* error_reporter = &micro_error_reporter;
+
+  tflite::MicroMutableOpResolver<4> op_resolver(error_reporter);
+  if (op_resolver.AddDepthwiseConv2D() != kTfLiteOk ||
+      op_resolver.AddFullyConnected() != kTfLiteOk ||
+      op_resolver.AddReshape() != kTfLiteOk ||
+      op_resolver.AddSoftmax() != kTfLiteOk) {
+    return 1;
+  }
+  SpecializedOpResolver specialized_op_resolver(&op_resolver);
+  const tflite::MicroOpResolver* resolver = &op_resolver;
+  if (use_specialized) {
+    resolver = &specialized_op_resolver;
+  }
+
+  const tflite::Model* model = nullptr;
+  if (model_path != nullptr) {
+    model = MapModelFile(error_reporter, model_path, *resolver, tensor_arena,
+                         kTensorArenaSize);
+    if (model == nullptr) {
+      return 1;
+    }
+  } else {
+    model = tflite::GetModel(g_model);
+    if (model->version() != TFLITE_SCHEMA_VERSION) {
+      fprintf(stderr, "Model is schema version %d, not %d\n",
+              static_cast<int>(model->version()), TFLITE_SCHEMA_VERSION);
+      return 1;
+    }
+  }
+  if (use_streaming) {
+    StreamingModel streaming_model(streaming_scratch, kStreamingScratchSize,
+                                   &profiler);
+    if (streaming_model.Initialize(error_reporter, model) != kTfLiteOk) {
+      return 1;
+    }
+    // Scroll through the two recorded samples one after the other, one slice
+    // per invocation, so the windows move like they do on the device.
+    for (int i = 0; i < OpProfiler::kMaxSamples; ++i) {
+      const int slice = i % (2 * kFeatureSliceCount);
+      const signed char* sample = (slice < kFeatureSliceCount)
+                                      ? g_yes_micro_f2e59fea_nohash_1_data
+                                      : g_no_micro_f9643d42_nohash_4_data;
+      memmove(features, features + kFeatureSliceSize,
+              kFeatureElementCount - kFeatureSliceSize);
+      memcpy(features + kFeatureElementCount - kFeatureSliceSize,
+             sample + (slice % kFeatureSliceCount) * kFeatureSliceSize,
+             kFeatureSliceSize);
+      const int new_slices = (i == 0) ? kFeatureSliceCount : 1;
+      if (streaming_model.Invoke(features, new_slices) != kTfLiteOk) {
+        fprintf(stderr, "Streaming Invoke failed\n");
+        return 1;
+      }
+    }
+  } else {
+    tflite::MicroInterpreter interpreter(model, *resolver, tensor_arena,
+                                         kTensorArenaSize, error_reporter,
+                                         &profiler);
+    if (interpreter.AllocateTensors() != kTfLiteOk) {
+      fprintf(stderr, "AllocateTensors() failed\n");
+      return 1;
+    }
+
+    // Alternate between the two recorded samples, so the softmax sees
+    // different winners.
+    TfLiteTensor* input = interpreter.input(0);
+    for (int i = 0; i < OpProfiler::kMaxSamples; ++i) {
+      const signed char* sample = (i % 2 == 0)
+                                      ? g_yes_micro_f2e59fea_nohash_1_data
+                                      : g_no_micro_f9643d42_nohash_4_data;
+      memcpy(input->data.int8, sample, kFeatureElementCount);
+      if (interpreter.Invoke() != kTfLiteOk) {
+        fprintf(stderr, "Invoke failed\n");
+        return 1;
+      }
+    }
+  }
+
+  profiler.ReportCsv(error_reporter);
+  FILE* trace = fopen(argv[1], "w");
+  if (trace == nullptr) {
+    fprintf(stderr, "Couldn't open %s\n", argv[1]);
+    return 1;
+  }
+  const bool written = profiler.WriteChromeTrace(trace);
+  if (fclose(trace) != 0 || !written) {
+    fprintf(stderr, "Couldn't write %s\n", argv[1]);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+/* Copyright 2021 The TensorFlow Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+==============================================================================*/
+
+// Host tool that drives InferenceGovernor through the situations it was
+// written for, a window every stride: silence, speech, a load spike that
+// stretches the model's time past a stride, and windows that arrive late.
+// It prints what the governor did in each phase, and fails if it didn't
+// behave as intended. The governor doesn't need TensorFlow Lite Micro:
+//
+//   g++ -std=c++11 -O2 -I tools/host -I src tools/simulate_governor.cpp
+//       src/inference_governor.cpp -o /tmp/simulate_governor
+//   /tmp/simulate_governor
+
+#include <cstdint>
+#include <cstdio>
+
+#include "inference_governor.h"
+#include "micro_model_settings.h"
+
+namespace {
+
+// Softmax outputs, silence first like kSilenceIndex.
+const int8_t kQuietScores[kCategoryCount] = {100, -100, -128, -128};
+const int8_t kSpeechScores[kCategoryCount] = {-100, -50, 90, -128};
+
+// What happens in one stretch of the simulation.
+struct Phase {
+  const char* name;
+  int windows;
+  const int8_t* scores;
+  uint32_t invoke_us;
+  // How far the audio clock is ahead of each window.
+  int32_t lag_ms;
+};
+
+// What the governor did over one phase.
+struct PhaseResult {
+  int inferences;
+  int longest_late_run;
+  uint32_t final_interval;
+};
+
+int32_t g_time_ms = 0;
+
+PhaseResult RunPhase(InferenceGovernor* governor, const Phase& phase) {
+  PhaseResult result = {0, 0, 0};
+  int late_run = 0;
+  for (int i = 0; i < phase.windows; ++i) {
+    g_time_ms += kFeatureSliceStrideMs;
+    const int late_before = governor->telemetry().late_skips.value();
+    if (governor->ShouldInfer(g_time_ms, 1, /*feature_us=*/5000,
+                              g_time_ms + phase.lag_ms)) {
+      governor->RecordInference(phase.invoke_us, /*respond_us=*/500,
+                                phase.scores);
+      ++result.inferences;
+    }
+    if (static_cast<int>(governor->telemetry().late_skips.value()) !=
+        late_before) {
+      ++late_run;
+      if (late_run > result.longest_late_run) {
+        result.longest_late_run = late_run;
+      }
+    } else {
+      late_run = 0;
+    }
+    governor->LogTelemetry(g_time_ms);
+  }
+  result.final_interval = governor->telemetry().interval_slices.value();
+  printf("%-12s %4d windows, %4d inferences, every %u slices at the end\n",
+         phase.name, phase.windows, result.inferences, result.final_interval);
+  return result;
+}
+
+int g_failures = 0;
+
+void Expect(bool condition, const char* what) {
+  if (!condition) {
+    printf("FAILED: %s\n", what);
+    ++g_failures;
+  }
+}
+
+}  // namespace
+
+int main() {
+  // Features on the other core, like the pipelined build.
+  InferenceGovernor governor(/*overlapped_features=*/true);
+
+  const Phase quiet = {"silence", 500, kQuietScores, 3000, 2};
+  PhaseResult result = RunPhase(&governor, quiet);
+  Expect(result.final_interval ==
+             static_cast<uint32_t>(InferenceGovernor::kMaxIntervalSlices),
+         "backs off to kMaxIntervalSlices in silence");
+
+  const Phase speech = {"speech", 50, kSpeechScores, 3000, 2};
+  result = RunPhase(&governor, speech);
+  Expect(result.final_interval == 1, "runs every slice during speech");
+  Expect(result.inferences >= speech.windows -
+                                  InferenceGovernor::kMaxIntervalSlices,
+         "catches speech within one quiet interval");
+
+  // 45ms of model time doesn't fit into one 20ms stride.
+  const Phase spike = {"load spike", 50, kSpeechScores, 45000, 2};
+  result = RunPhase(&governor, spike);
+  Expect(result.final_interval >= 3, "stretches the interval under load");
+  Expect(result.inferences <= spike.windows / 2,
+         "doesn't pile up inferences under load");
+
+  const Phase recovered = {"recovered", 50, kSpeechScores, 3000, 2};
+  result = RunPhase(&governor, recovered);
+  Expect(result.final_interval == 1, "returns to every slice after the spike");
+
+  const Phase late = {"late", 30, kSpeechScores, 3000,
+                      3 * kFeatureSliceStrideMs};
+  result = RunPhase(&governor, late);
+  Expect(result.longest_late_run == 2,
+         "skips at most two late windows in a row");
+  Expect(result.inferences >= late.windows / 3,
+         "still runs on late windows now and then");
+
+  const GovernorTelemetry& telemetry = governor.telemetry();
+  printf("Totals: %u windows, %u inferred, %u idle, %u overloaded, %u late, "
+         "%u missed deadlines\n",
+         static_cast<unsigned>(telemetry.windows.value()),
+         static_cast<unsigned>(telemetry.inferences.value()),
+         static_cast<unsigned>(telemetry.idle_skips.value()),
+         static_cast<unsigned>(telemetry.load_skips.value()),
+         static_cast<unsigned>(telemetry.late_skips.value()),
+         static_cast<unsigned>(telemetry.deadline_misses.value()));
+  return g_failures == 0 ? 0 : 1;
+}